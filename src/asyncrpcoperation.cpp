@@ -27,7 +27,7 @@ std::map<OperationStatus, std::string> OperationStatusMap = {
 /**
  * Every operation instance should have a globally unique id
  */
-AsyncRPCOperation::AsyncRPCOperation() : error_code_(0), error_message_() {
+AsyncRPCOperation::AsyncRPCOperation() : error_code_(0), error_message_(), cancel_requested_(false), priority_(0) {
     // Set a unique reference for each operation
     boost::uuids::uuid uuid = uuidgen();
     id_ = "opid-" + boost::uuids::to_string(uuid);
@@ -37,6 +37,7 @@ AsyncRPCOperation::AsyncRPCOperation() : error_code_(0), error_message_() {
 
 AsyncRPCOperation::AsyncRPCOperation(const AsyncRPCOperation& o) :
         id_(o.id_), creation_time_(o.creation_time_), state_(o.state_.load()),
+        cancel_requested_(o.cancel_requested_.load()), priority_(o.priority_.load()),
         start_time_(o.start_time_), end_time_(o.end_time_),
         error_code_(o.error_code_), error_message_(o.error_message_),
         result_(o.result_)
@@ -47,6 +48,8 @@ AsyncRPCOperation& AsyncRPCOperation::operator=( const AsyncRPCOperation& other
     this->id_ = other.id_;
     this->creation_time_ = other.creation_time_;
     this->state_.store(other.state_.load());
+    this->cancel_requested_.store(other.cancel_requested_.load());
+    this->priority_.store(other.priority_.load());
     this->start_time_ = other.start_time_;
     this->end_time_ = other.end_time_;
     this->error_code_ = other.error_code_;
@@ -63,6 +66,7 @@ AsyncRPCOperation::~AsyncRPCOperation() {
  * Override this cancel() method if you can interrupt main() when executing.
  */
 void AsyncRPCOperation::cancel() {
+    cancel_requested_.store(true);
     if (isReady()) {
         set_state(OperationStatus::CANCELLED);
     }
@@ -46,8 +46,11 @@ public:
     // You must implement this method in your subclass.
     virtual void main();
 
+    // Cancels the operation if it has not started yet. An executing
+    // operation is only asked to stop: main() should check
+    // isCancelRequested() between steps it can abandon, such as proofs.
     // Override this method if you can interrupt execution of main() in your subclass.
-    void cancel();
+    virtual void cancel();
     
     // Getters and setters
 
@@ -63,6 +66,16 @@ public:
         return creation_time_;
     }
 
+    // Operations with a higher priority are run, and given cores for their
+    // proofs, before those with a lower one. Set before queueing.
+    int getPriority() const {
+        return priority_.load();
+    }
+
+    void setPriority(int priority) {
+        priority_.store(priority);
+    }
+
     // Override this method to add data to the default status object.
     virtual UniValue getStatus() const;
 
@@ -86,6 +99,10 @@ public:
         return OperationStatus::CANCELLED == getState();
     }
 
+    bool isCancelRequested() const {
+        return cancel_requested_.load();
+    }
+
     bool isExecuting() const {
         return OperationStatus::EXECUTING == getState();
     }
@@ -115,6 +132,8 @@ protected:
     int error_code_;
     std::string error_message_;
     std::atomic<OperationStatus> state_;
+    std::atomic<bool> cancel_requested_;
+    std::atomic<int> priority_;
     std::chrono::time_point<std::chrono::system_clock> start_time_, end_time_;  
 
     void start_execution_clock();
@@ -4,6 +4,9 @@
 
 #include <asyncrpcqueue.h>
 
+#include <algorithm>
+#include <assert.h>
+
 static std::atomic<size_t> workerCounter(0);
 
 /**
@@ -15,7 +18,8 @@ shared_ptr<AsyncRPCQueue> AsyncRPCQueue::sharedInstance() {
     return q;
 }
 
-AsyncRPCQueue::AsyncRPCQueue() : closed_(false), finish_(false) {
+AsyncRPCQueue::AsyncRPCQueue() : closed_(false), finish_(false), sequence_(0),
+    proof_cores_(std::max(1u, std::thread::hardware_concurrency())), proof_cores_in_use_(0) {
 }
 
 AsyncRPCQueue::~AsyncRPCQueue() {
@@ -43,15 +47,13 @@ void AsyncRPCQueue::run(size_t workerId) {
 
             // Exit if the queue is closing.
             if (isClosed()) {
-                while (!operation_id_queue_.empty()) {
-                    operation_id_queue_.pop();
-                }
+                operation_id_queue_.clear();
                 break;
             }
 
-            // Get operation id
-            key = operation_id_queue_.front();
-            operation_id_queue_.pop();
+            // Get the id of the operation with the highest priority
+            key = operation_id_queue_.begin()->id;
+            operation_id_queue_.erase(operation_id_queue_.begin());
 
             // Search operation map
             AsyncRPCOperationMap::const_iterator iter = operation_map_.find(key);
@@ -91,7 +93,7 @@ void AsyncRPCQueue::addOperation(const std::shared_ptr<AsyncRPCOperation> &ptrOp
 
     AsyncRPCOperationId id = ptrOperation->getId();
     operation_map_.emplace(id, ptrOperation);
-    operation_id_queue_.push(id);
+    operation_id_queue_.insert(AsyncRPCTicket{ptrOperation->getPriority(), sequence_++, id});
     this->condition_.notify_one();
 }
 
@@ -161,6 +163,7 @@ void AsyncRPCQueue::cancelAllOperations() {
         key.second->cancel();
     }
     this->condition_.notify_all();
+    this->proof_condition_.notify_all();
 }
 
 /**
@@ -223,6 +226,7 @@ void AsyncRPCQueue::wait_for_worker_threads() {
     {
         std::lock_guard<std::mutex> guard(lock_);
         this->condition_.notify_all();
+        this->proof_condition_.notify_all();
     }
         
     for (std::thread & t : this->workers_) {
@@ -231,3 +235,75 @@ void AsyncRPCQueue::wait_for_worker_threads() {
         }
     }
 }
+
+/**
+ * Set the number of cores shared by the proofs of all workers.
+ */
+void AsyncRPCQueue::setProofCores(size_t cores) {
+    std::lock_guard<std::mutex> guard(lock_);
+    proof_cores_ = std::max<size_t>(1, cores);
+    this->proof_condition_.notify_all();
+}
+
+/**
+ * Return the number of cores shared by the proofs of all workers.
+ */
+size_t AsyncRPCQueue::getProofCores() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return proof_cores_;
+}
+
+/**
+ * Return the number of cores used by the proofs running now.
+ */
+size_t AsyncRPCQueue::getProofCoresInUse() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return proof_cores_in_use_;
+}
+
+/**
+ * Return the number of operations waiting for cores to prove with.
+ */
+size_t AsyncRPCQueue::getNumberOfProofWaiters() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return proof_waiters_.size();
+}
+
+/**
+ * Wait for the operation's turn to prove, and return the number of cores it
+ * may use, or 0 if it was cancelled or the queue closed while waiting.
+ */
+size_t AsyncRPCQueue::acquireProofCores(const AsyncRPCOperation& operation) {
+    std::unique_lock<std::mutex> guard(lock_);
+
+    const AsyncRPCTicket ticket{operation.getPriority(), sequence_++, operation.getId()};
+    proof_waiters_.insert(ticket);
+
+    size_t cores = 0;
+    while (!isClosed() && !operation.isCancelRequested()) {
+        // An equal share per worker, as any of them may be proving
+        const size_t share = std::max<size_t>(1, proof_cores_ / std::max<size_t>(1, workers_.size()));
+        if (proof_waiters_.begin()->sequence == ticket.sequence && proof_cores_in_use_ + share <= proof_cores_) {
+            cores = share;
+            proof_cores_in_use_ += cores;
+            break;
+        }
+        // Operations are cancelled without telling the queue, so check back
+        this->proof_condition_.wait_for(guard, std::chrono::milliseconds(100));
+    }
+
+    proof_waiters_.erase(ticket);
+    // The next waiter may be able to start too
+    this->proof_condition_.notify_all();
+    return cores;
+}
+
+/**
+ * Return the cores of a finished proof to the budget.
+ */
+void AsyncRPCQueue::releaseProofCores(size_t cores) {
+    std::lock_guard<std::mutex> guard(lock_);
+    assert(proof_cores_in_use_ >= cores);
+    proof_cores_in_use_ -= cores;
+    this->proof_condition_.notify_all();
+}
@@ -12,6 +12,7 @@
 #include <string>
 #include <chrono>
 #include <queue>
+#include <set>
 #include <unordered_map>
 #include <vector>
 #include <future>
@@ -22,6 +23,23 @@
 
 typedef std::unordered_map<AsyncRPCOperationId, std::shared_ptr<AsyncRPCOperation> > AsyncRPCOperationMap; 
 
+/**
+ * An operation waiting in the queue, or for cores to prove with. Higher
+ * priorities come first, then earlier arrivals.
+ */
+struct AsyncRPCTicket {
+    int priority;
+    uint64_t sequence;
+    AsyncRPCOperationId id;
+
+    bool operator<(const AsyncRPCTicket& other) const {
+        if (priority != other.priority) {
+            return priority > other.priority;
+        }
+        return sequence < other.sequence;
+    }
+};
+
 
 class AsyncRPCQueue {
 public:
@@ -51,6 +69,21 @@ public:
     void addOperation(const std::shared_ptr<AsyncRPCOperation> &ptrOperation);
     std::vector<AsyncRPCOperationId> getAllOperationIds() const;
 
+    // Proofs run by the workers share a budget of cores, which defaults to
+    // the number of hardware threads. Each proof gets an equal share of it
+    // per worker, so that proofs running side by side do not oversubscribe
+    // the CPU with their OpenMP threads.
+    void setProofCores(size_t cores);
+    size_t getProofCores() const;
+    size_t getProofCoresInUse() const;
+    size_t getNumberOfProofWaiters() const;
+
+    // Blocks until the operation can have its share of the cores, handing
+    // them out by priority. Returns 0 if the operation is cancelled or the
+    // queue closes first. Use AsyncRPCProofCores rather than calling these.
+    size_t acquireProofCores(const AsyncRPCOperation& operation);
+    void releaseProofCores(size_t cores);
+
 private:
     // addWorker() will spawn a new thread on run())
     void run(size_t workerId);
@@ -62,8 +95,51 @@ private:
     std::atomic<bool> closed_;
     std::atomic<bool> finish_;
     AsyncRPCOperationMap operation_map_;
-    std::queue <AsyncRPCOperationId> operation_id_queue_;
+    std::set<AsyncRPCTicket> operation_id_queue_;
     std::vector<std::thread> workers_;
+    uint64_t sequence_;
+
+    std::condition_variable proof_condition_;
+    std::set<AsyncRPCTicket> proof_waiters_;
+    size_t proof_cores_;
+    size_t proof_cores_in_use_;
+};
+
+/**
+ * The cores an operation may use for a proof, returned to the queue when
+ * this goes out of scope:
+ *
+ *     AsyncRPCProofCores cores(*AsyncRPCQueue::sharedInstance(), *this);
+ *     if (!cores) {
+ *         // cancelled while waiting
+ *     }
+ *     params.proveBatch(witnesses, cores.size(), ...);
+ */
+class AsyncRPCProofCores {
+public:
+    AsyncRPCProofCores(AsyncRPCQueue& queue, const AsyncRPCOperation& operation)
+        : queue_(queue), cores_(queue.acquireProofCores(operation)) { }
+
+    ~AsyncRPCProofCores() {
+        if (cores_ > 0) {
+            queue_.releaseProofCores(cores_);
+        }
+    }
+
+    AsyncRPCProofCores(AsyncRPCProofCores const&) = delete;
+    AsyncRPCProofCores& operator=(AsyncRPCProofCores const&) = delete;
+
+    size_t size() const {
+        return cores_;
+    }
+
+    explicit operator bool() const {
+        return cores_ > 0;
+    }
+
+private:
+    AsyncRPCQueue& queue_;
+    const size_t cores_;
 };
 
 #endif // BITCOIN_ASYNCRPCQUEUE_H
@@ -4,6 +4,7 @@
 
 #include <bench/bench.h>
 
+#include <crypto/blake2b.h>
 #include <crypto/sha256.h>
 #include <key.h>
 #include <random.h>
@@ -67,6 +68,7 @@ int main(int argc, char** argv)
     const fs::path bench_datadir{SetDataDir()};
 
     SHA256AutoDetect();
+    Blake2bAutoDetect();
     RandomInit();
     ECC_Start();
     SetupEnvironment();
@@ -5,8 +5,10 @@
 #include <bench/bench.h>
 #include <coins.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <wallet/crypter.h>
 
+#include <unordered_map>
 #include <vector>
 
 // FIXME: Dedup with SetupDummyInputs in test/transaction_tests.cpp.
@@ -85,3 +87,52 @@ static void CCoinsCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCoinsCaching, 170 * 1000);
+
+// The coins cache of a block, or a batch of blocks before a flush: add the
+// outputs, look them up again, and write them out, erasing as BatchWrite
+// does. Compares CCoinsMap with the std::unordered_map it replaced.
+template <typename Map>
+static void CoinsMapBlock(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 5000; i++) {
+        const uint256 txid = rng.rand256();
+        for (uint32_t n = 0; n < 4; n++) {
+            outpoints.emplace_back(txid, n);
+        }
+    }
+
+    while (state.KeepRunning()) {
+        Map map;
+        for (const COutPoint& outpoint : outpoints) {
+            CCoinsCacheEntry& entry = map.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple()).first->second;
+            entry.coin.out.nValue = outpoint.n;
+            entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+        }
+        CAmount total = 0;
+        for (const COutPoint& outpoint : outpoints) {
+            total += map.find(outpoint)->second.coin.out.nValue;
+        }
+        assert(total == 5000 * 6);
+        size_t dirty = 0;
+        for (auto it = map.begin(); it != map.end(); ) {
+            dirty += it->second.flags & CCoinsCacheEntry::DIRTY;
+            it = map.erase(it);
+        }
+        assert(dirty == outpoints.size());
+    }
+}
+
+static void CoinsMapBlockUnordered(benchmark::State& state)
+{
+    CoinsMapBlock<std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>>(state);
+}
+
+static void CoinsMapBlockPooled(benchmark::State& state)
+{
+    CoinsMapBlock<CCoinsMap>(state);
+}
+
+BENCHMARK(CoinsMapBlockUnordered, 100);
+BENCHMARK(CoinsMapBlockPooled, 100);
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <bench/bench.h>
+#include <crypto/sha256.h>
 #include <util.h>
 #include <validation.h>
 #include <checkqueue.h>
@@ -17,6 +18,7 @@ static const size_t BATCHES = 101;
 static const size_t BATCH_SIZE = 30;
 static const int PREVECTOR_SIZE = 28;
 static const unsigned int QUEUE_BATCH_SIZE = 128;
+static const int HASH_JOB_ROUNDS = 100;
 
 // This Benchmark tests the CheckQueue with a slightly realistic workload,
 // where checks all contain a prevector that is indirect 50% of the time
@@ -60,3 +62,57 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.join_all();
 }
 BENCHMARK(CCheckQueueSpeedPrevectorJob, 1400);
+
+// This Benchmark tests how the CheckQueue scales with the number of cores,
+// the master included, with checks that each take tens of microseconds like
+// a signature check, added a transaction at a time as in ConnectBlock.
+static void CCheckQueueScaling(benchmark::State& state, int nCores)
+{
+    struct HashJob {
+        uint256 hash;
+        HashJob(){
+        }
+        explicit HashJob(FastRandomContext& insecure_rand) : hash(insecure_rand.rand256()){
+        }
+        bool operator()()
+        {
+            for (int i = 0; i < HASH_JOB_ROUNDS; ++i)
+                CSHA256().Write(hash.begin(), hash.size()).Finalize(hash.begin());
+            return true;
+        }
+        void swap(HashJob& x){std::swap(hash, x.hash);};
+    };
+    CCheckQueue<HashJob> queue {QUEUE_BATCH_SIZE};
+    boost::thread_group tg;
+    for (auto x = 1; x < nCores; ++x) {
+       tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        FastRandomContext insecure_rand(true);
+        CCheckQueueControl<HashJob> control(&queue);
+        for (size_t x = 0; x < BATCHES * BATCH_SIZE / 2; ++x) {
+            std::vector<HashJob> vChecks;
+            vChecks.reserve(2);
+            vChecks.emplace_back(insecure_rand);
+            vChecks.emplace_back(insecure_rand);
+            control.Add(vChecks);
+        }
+        control.Wait();
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+#define CHECKQUEUE_SCALING(cores, iters)                                  \
+    static void CCheckQueueScaling ## cores(benchmark::State& state) {   \
+        CCheckQueueScaling(state, cores);                                 \
+    }                                                                     \
+    BENCHMARK(CCheckQueueScaling ## cores, iters);
+
+CHECKQUEUE_SCALING(1, 7)
+CHECKQUEUE_SCALING(2, 14)
+CHECKQUEUE_SCALING(4, 28)
+CHECKQUEUE_SCALING(8, 56)
+CHECKQUEUE_SCALING(16, 110)
+CHECKQUEUE_SCALING(32, 220)
+CHECKQUEUE_SCALING(64, 440)
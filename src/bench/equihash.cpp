@@ -0,0 +1,59 @@
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chainparams.h>
+#include <crypto/equihash.h>
+#include <pow.h>
+
+#include <vector>
+
+static void EquihashValidate(benchmark::State& state)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    const CBlockHeader header = chainParams->GenesisBlock().GetBlockHeader();
+    while (state.KeepRunning()) {
+        bool valid = CheckEquihashSolution(&header, *chainParams);
+        assert(valid);
+    }
+}
+
+/** The hashes of an Equihash<200,9> solution's 512 indices, after a 140 byte header prefix. */
+static void EquihashHashes(benchmark::State& state, bool batched)
+{
+    eh_HashState base_state;
+    Eh200_9.InitialiseState(base_state);
+    std::vector<unsigned char> prefix(140, 0);
+    base_state.Update(prefix.data(), prefix.size());
+
+    std::vector<eh_index> indices(512);
+    for (size_t i = 0; i < indices.size(); i++) {
+        indices[i] = i * 4099;
+    }
+    std::vector<unsigned char> hashes(indices.size() * Eh200_9.HashOutput);
+    while (state.KeepRunning()) {
+        if (batched) {
+            GenerateHashes(base_state, indices.data(), indices.size(), hashes.data(), Eh200_9.HashOutput);
+        } else {
+            for (size_t i = 0; i < indices.size(); i++) {
+                GenerateHash(base_state, indices[i], hashes.data() + i * Eh200_9.HashOutput, Eh200_9.HashOutput);
+            }
+        }
+    }
+}
+
+static void EquihashGenerateHash_512(benchmark::State& state)
+{
+    EquihashHashes(state, false);
+}
+
+static void EquihashGenerateHashes_512(benchmark::State& state)
+{
+    EquihashHashes(state, true);
+}
+
+BENCHMARK(EquihashValidate, 3000);
+BENCHMARK(EquihashGenerateHash_512, 2900);
+BENCHMARK(EquihashGenerateHashes_512, 13000);
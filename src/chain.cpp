@@ -5,6 +5,9 @@
 
 #include <chain.h>
 
+#include <txdb.h>
+#include <validation.h>
+
 /**
  * CChain implementation
  */
@@ -118,6 +121,32 @@ void CBlockIndex::BuildSkip()
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
+std::vector<unsigned char> CBlockIndex::GetBlockSolution() const
+{
+    if (!fSolutionTrimmed)
+        return nSolution;
+
+    CDiskBlockIndex diskindex;
+    if (!pblocktree || !pblocktree->ReadDiskBlockIndex(GetBlockHash(), diskindex))
+        throw std::runtime_error(std::string(__func__) + ": failed to read index entry of block " + GetBlockHash().ToString());
+    return diskindex.nSolution;
+}
+
+CBlockHeader CBlockIndex::GetBlockHeader() const
+{
+    CBlockHeader block;
+    block.nVersion       = nVersion;
+    if (pprev)
+        block.hashPrevBlock = pprev->GetBlockHash();
+    block.hashMerkleRoot = hashMerkleRoot;
+    block.hashReserved   = hashReserved;
+    block.nTime          = nTime;
+    block.nBits          = nBits;
+    block.nNonce         = nNonce;
+    block.nSolution      = GetBlockSolution();
+    return block;
+}
+
 arith_uint256 GetBlockProof(const CBlockIndex& block)
 {
     arith_uint256 bnTarget;
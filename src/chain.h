@@ -219,8 +219,13 @@ public:
     uint32_t nTime;
     uint32_t nBits;
     uint256 nNonce;
+    //! Equihash solution, dropped from memory by TrimSolution() once the
+    //! header is in the block tree DB. Use GetBlockSolution() to access it.
     std::vector<unsigned char> nSolution;
 
+    //! (memory only) Whether nSolution has to be read from the block tree DB
+    bool fSolutionTrimmed;
+
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
     int32_t nSequenceId;
 
@@ -252,6 +257,7 @@ public:
         nBits          = 0;
         nNonce         = uint256();
         nSolution.clear();
+        fSolutionTrimmed = false;
     }
 
     CBlockIndex()
@@ -290,21 +296,22 @@ public:
         return ret;
     }
 
-    CBlockHeader GetBlockHeader() const
+    //! Return the Equihash solution, reading it from the block tree DB if it
+    //! has been trimmed. Throws std::runtime_error if the DB read fails.
+    //! Callers must hold cs_main, which TrimSolution() is called under.
+    std::vector<unsigned char> GetBlockSolution() const;
+
+    //! Drop the Equihash solution from memory. Only call this once the
+    //! entry has been written to the block tree DB.
+    void TrimSolution()
     {
-        CBlockHeader block;
-        block.nVersion       = nVersion;
-        if (pprev)
-            block.hashPrevBlock = pprev->GetBlockHash();
-        block.hashMerkleRoot = hashMerkleRoot;
-        block.hashReserved   = hashReserved;
-        block.nTime          = nTime;
-        block.nBits          = nBits;
-        block.nNonce         = nNonce;
-        block.nSolution      = nSolution;
-        return block;
+        std::vector<unsigned char>().swap(nSolution);
+        fSolutionTrimmed = true;
     }
 
+    //! Requires cs_main, see GetBlockSolution()
+    CBlockHeader GetBlockHeader() const;
+
     uint256 GetBlockHash() const
     {
         return *phashBlock;
@@ -394,6 +401,10 @@ public:
 
     explicit CDiskBlockIndex(const CBlockIndex* pindex) : CBlockIndex(*pindex) {
         hashPrev = (pprev ? pprev->GetBlockHash() : uint256());
+        if (fSolutionTrimmed) {
+            nSolution = pindex->GetBlockSolution();
+            fSolutionTrimmed = false;
+        }
     }
 
     ADD_SERIALIZE_METHODS;
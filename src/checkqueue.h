@@ -8,6 +8,9 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -25,12 +28,35 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every worker has a queue of its own, which the master spreads the checks
+  * over. A worker takes batches from the back of its queue, and once it is
+  * empty, steals from the front of the others' queues. The queues are only
+  * contended when stealing, and the shared lock is only taken to sleep and
+  * to wake sleeping threads.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! The number of queues, the master's included. Workers beyond them share queues.
+    static const int MAX_QUEUES = 64;
+
+    struct WorkerQueue {
+        //! Mutex to protect the checks
+        boost::mutex mutex;
+
+        //! The queued checks, taken from the back by their worker and from the front by others.
+        std::deque<T> checks;
+
+        //! The number of checks, to pass over empty queues without locking them.
+        std::atomic<unsigned int> nSize{0};
+    };
+
+    //! The queues; the master's is the first.
+    std::unique_ptr<WorkerQueue[]> queues;
+
+    //! Mutex to sleep and wake up on
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,87 +65,121 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! The number of worker threads, not including the master.
+    std::atomic<int> nWorkers;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
-
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! The number of worker threads asleep, or about to be.
+    std::atomic<int> nIdle;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
+
+    //! Number of verifications that are in a queue, or being added to one.
+    std::atomic<unsigned int> nQueued;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! The worker queue that the next checks added go to.
+    unsigned int nNextQueue;
+
+    int QueueCount() const
+    {
+        const int nQueues = nWorkers + 1;
+        return nQueues < MAX_QUEUES ? nQueues : MAX_QUEUES;
+    }
+
+    /**
+     * Move a batch of checks from the back of a queue (its own worker) or
+     * from its front (anyone else) into vChecks. Take up to half of the
+     * checks, so that the batches shrink as the work runs out and the
+     * workers finish approximately simultaneously.
+     */
+    unsigned int Take(WorkerQueue& queue, std::vector<T>& vChecks, bool fOwn)
+    {
+        if (queue.nSize.load(std::memory_order_relaxed) == 0)
+            return 0;
+        boost::unique_lock<boost::mutex> lock(queue.mutex);
+        const unsigned int nNow = std::min<size_t>(nBatchSize, (queue.checks.size() + 1) / 2);
+        if (nNow == 0)
+            return 0;
+        vChecks.resize(nNow);
+        for (unsigned int i = 0; i < nNow; i++) {
+            // Swap the checks out of the queue instead of copying them.
+            if (fOwn) {
+                vChecks[i].swap(queue.checks.back());
+                queue.checks.pop_back();
+            } else {
+                vChecks[i].swap(queue.checks.front());
+                queue.checks.pop_front();
+            }
+        }
+        queue.nSize.store(queue.checks.size(), std::memory_order_relaxed);
+        nQueued -= nNow;
+        return nNow;
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+        // The master has the first queue, and the workers the others in turn
+        const int nQueue = fMaster ? 0 : 1 + nWorkers++ % (MAX_QUEUES - 1);
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
+            unsigned int nNow = Take(queues[nQueue], vChecks, true);
+            if (nNow == 0) {
+                // Steal from the others, starting with the next queue
+                const int nQueues = QueueCount();
+                for (int i = 1; i < nQueues && nNow == 0; i++) {
+                    const int nVictim = (nQueue + i) % nQueues;
+                    if (nVictim != nQueue)
+                        nNow = Take(queues[nVictim], vChecks, false);
                 }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if (fMaster && nTodo == 0) {
-                        nTotal--;
+            }
+            if (nNow == 0) {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                if (fMaster) {
+                    while (nTodo != 0 && nQueued == 0)
+                        condMaster.wait(lock);
+                    if (nTodo == 0) {
                         bool fRet = fAllOk;
                         // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
+                        fAllOk = true;
                         // return the current status
                         return fRet;
                     }
+                } else {
+                    // Add reads nIdle after counting its checks in
+                    // nQueued, so either it wakes us up or we see them.
                     nIdle++;
-                    cond.wait(lock); // wait
+                    while (nQueued == 0)
+                        condWorker.wait(lock);
                     nIdle--;
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                continue;
             }
+            // Check whether we need to do work at all
+            bool fOk = fAllOk;
             // execute work
             for (T& check : vChecks)
                 if (fOk)
                     fOk = check();
             vChecks.clear();
+            if (!fOk)
+                fAllOk = false;
+            if (nTodo.fetch_sub(nNow) == nNow) {
+                // We processed the last element; inform the master it can exit and return the result
+                boost::unique_lock<boost::mutex> lock(mutex);
+                condMaster.notify_one();
+            }
         } while (true);
     }
 
@@ -128,7 +188,7 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn) : queues(new WorkerQueue[MAX_QUEUES]), nWorkers(0), nIdle(0), fAllOk(true), nQueued(0), nTodo(0), nBatchSize(nBatchSizeIn), nNextQueue(0) {}
 
     //! Worker thread
     void Thread()
@@ -145,16 +205,31 @@ public:
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty())
+            return;
+        // Spread the checks over the workers' queues, one share each,
+        // carrying on from the queue the previous checks went to. Without
+        // workers yet, they go to the master's queue.
+        const int nQueues = QueueCount();
+        const size_t nShare = nQueues > 1 ? (vChecks.size() + nQueues - 2) / (nQueues - 1) : vChecks.size();
         nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
+        nQueued += vChecks.size();
+        for (size_t nDone = 0; nDone < vChecks.size(); ) {
+            WorkerQueue& queue = queues[nQueues > 1 ? 1 + nNextQueue++ % (nQueues - 1) : 0];
+            boost::unique_lock<boost::mutex> lock(queue.mutex);
+            for (size_t nEnd = std::min(vChecks.size(), nDone + nShare); nDone < nEnd; nDone++) {
+                queue.checks.push_back(T());
+                vChecks[nDone].swap(queue.checks.back());
+            }
+            queue.nSize.store(queue.checks.size(), std::memory_order_relaxed);
+        }
+        if (nIdle != 0) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (vChecks.size() == 1)
+                condWorker.notify_one();
+            else
+                condWorker.notify_all();
+        }
     }
 
     ~CCheckQueue()
@@ -7,6 +7,8 @@
 #include <consensus/consensus.h>
 #include <random.h>
 
+#include <algorithm>
+
 bool CCoinsView::GetAnchorAt(const uint256 &rt, ZCIncrementalMerkleTree &tree) const { return false; }
 bool CCoinsView::GetNullifier(const uint256 &nullifier) const { return false; }
 bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return false; }
@@ -48,16 +50,24 @@ SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<ui
 SaltedUint256Hasher::SaltedUint256Hasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0), nTrimCursor(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
 }
 
+size_t CCoinsViewCache::ShrunkDynamicMemoryUsage() const {
+    return memusage::ShrunkDynamicUsage(cacheCoins) + cachedCoinsUsage;
+}
+
 CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const {
     CCoinsMap::iterator it = cacheCoins.find(outpoint);
-    if (it != cacheCoins.end())
+    if (it != cacheCoins.end()) {
+        it->second.used = true;
+        counters.nHits++;
         return it;
+    }
+    counters.nMisses++;
     Coin tmp;
     if (!base->GetCoin(outpoint, tmp))
         return cacheCoins.end();
@@ -76,6 +86,11 @@ bool CCoinsViewCache::GetAnchorAt(const uint256 &rt, ZCIncrementalMerkleTree &tr
     if (it != cacheAnchors.end()) {
         if (it->second.entered) {
             tree = it->second.tree;
+            // Mark it as the most recently used
+            auto lru = std::find(vAnchorsLRU.begin(), vAnchorsLRU.end(), rt);
+            if (lru != vAnchorsLRU.end()) {
+                std::rotate(lru, lru + 1, vAnchorsLRU.end());
+            }
             return true;
         } else {
             return false;
@@ -86,12 +101,32 @@ bool CCoinsViewCache::GetAnchorAt(const uint256 &rt, ZCIncrementalMerkleTree &tr
         return false;
     }
 
+    CacheAnchor(rt, tree);
+    return true;
+}
+
+void CCoinsViewCache::CacheAnchor(const uint256 &rt, const ZCIncrementalMerkleTree &tree) const {
     CAnchorsMap::iterator ret = cacheAnchors.insert(std::make_pair(rt, CAnchorsCacheEntry())).first;
     ret->second.entered = true;
     ret->second.tree = tree;
-    cachedCoinsUsage += ret->second.tree.DynamicMemoryUsage();
+    cachedCoinsUsage += ret->second.DynamicMemoryUsage();
 
-    return true;
+    vAnchorsLRU.push_back(rt);
+    TrimAnchors();
+}
+
+void CCoinsViewCache::TrimAnchors() const {
+    // Drop the least recently used clean trees, unless they have been
+    // modified since they were read, in which case they are kept until the
+    // next flush
+    while (vAnchorsLRU.size() > MAX_CACHED_ANCHORS) {
+        CAnchorsMap::iterator itOld = cacheAnchors.find(vAnchorsLRU.front());
+        if (itOld != cacheAnchors.end() && !(itOld->second.flags & CAnchorsCacheEntry::DIRTY)) {
+            cachedCoinsUsage -= itOld->second.DynamicMemoryUsage();
+            cacheAnchors.erase(itOld);
+        }
+        vAnchorsLRU.erase(vAnchorsLRU.begin());
+    }
 }
 
 bool CCoinsViewCache::GetNullifier(const uint256 &nullifier) const {
@@ -108,7 +143,7 @@ bool CCoinsViewCache::GetNullifier(const uint256 &nullifier) const {
     return tmp;
 }
 
-void CCoinsViewCache::PushAnchor(const ZCIncrementalMerkleTree &tree) {
+void CCoinsViewCache::PushAnchor(const ZCIncrementalMerkleTree &tree, const std::vector<uint256> &commitments) {
     uint256 newrt = tree.root();
 
     auto currentRoot = GetBestAnchor();
@@ -122,14 +157,18 @@ void CCoinsViewCache::PushAnchor(const ZCIncrementalMerkleTree &tree) {
         auto insertRet = cacheAnchors.insert(std::make_pair(newrt, CAnchorsCacheEntry()));
         CAnchorsMap::iterator ret = insertRet.first;
 
+        if (!insertRet.second) {
+            // The entry already existed
+            cachedCoinsUsage -= ret->second.DynamicMemoryUsage();
+        }
+
         ret->second.entered = true;
         ret->second.tree = tree;
+        ret->second.prevRoot = currentRoot;
+        ret->second.commitments = commitments;
         ret->second.flags = CAnchorsCacheEntry::DIRTY;
 
-        if (insertRet.second) {
-            // An insert took place
-            cachedCoinsUsage += ret->second.tree.DynamicMemoryUsage();
-        }
+        cachedCoinsUsage += ret->second.DynamicMemoryUsage();
 
         hashAnchor = newrt;
     }
@@ -244,6 +283,26 @@ bool CCoinsViewCache::HaveCoinInCache(const COutPoint &outpoint) const {
     return (it != cacheCoins.end() && !it->second.coin.IsSpent());
 }
 
+void CCoinsViewCache::AddPrefetchedCoin(const COutPoint &outpoint, Coin&& coin) {
+    assert(!coin.IsSpent());
+    if (cacheCoins.count(outpoint))
+        return;
+    CCoinsMap::iterator it = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin))).first;
+    cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+}
+
+void CCoinsViewCache::AddPrefetchedNullifier(const uint256 &nullifier, bool spent) {
+    CNullifiersCacheEntry entry;
+    entry.entered = spent;
+    cacheNullifiers.insert(std::make_pair(nullifier, entry));
+}
+
+void CCoinsViewCache::AddPrefetchedAnchor(const uint256 &rt, const ZCIncrementalMerkleTree &tree) {
+    if (cacheAnchors.count(rt))
+        return;
+    CacheAnchor(rt, tree);
+}
+
 uint256 CCoinsViewCache::GetBestBlock() const {
     if (hashBlock.IsNull())
         hashBlock = base->GetBestBlock();
@@ -329,15 +388,26 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins,
                 CAnchorsCacheEntry& entry = cacheAnchors[child_it->first];
                 entry.entered = child_it->second.entered;
                 entry.tree = child_it->second.tree;
+                entry.prevRoot = child_it->second.prevRoot;
+                entry.commitments = std::move(child_it->second.commitments);
                 entry.flags = CAnchorsCacheEntry::DIRTY;
 
-                cachedCoinsUsage += entry.tree.DynamicMemoryUsage();
+                cachedCoinsUsage += entry.DynamicMemoryUsage();
             } else {
                 if (parent_it->second.entered != child_it->second.entered) {
                     // The parent may have removed the entry.
                     parent_it->second.entered = child_it->second.entered;
                     parent_it->second.flags |= CAnchorsCacheEntry::DIRTY;
                 }
+                if (child_it->second.entered && parent_it->second.prevRoot != child_it->second.prevRoot) {
+                    // The child may have pushed the tree again on top of
+                    // another anchor.
+                    cachedCoinsUsage -= parent_it->second.DynamicMemoryUsage();
+                    parent_it->second.prevRoot = child_it->second.prevRoot;
+                    parent_it->second.commitments = std::move(child_it->second.commitments);
+                    parent_it->second.flags |= CAnchorsCacheEntry::DIRTY;
+                    cachedCoinsUsage += parent_it->second.DynamicMemoryUsage();
+                }
             }
         }
 
@@ -374,11 +444,117 @@ bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock, hashAnchor, cacheAnchors, cacheNullifiers);
     cacheCoins.clear();
     cacheAnchors.clear();
+    vAnchorsLRU.clear();
     cacheNullifiers.clear();
     cachedCoinsUsage = 0;
+    nTrimCursor = 0;
+    counters.nFlushes++;
     return fOk;
 }
 
+bool CCoinsViewCache::Sync() {
+    CCoinsMap mapCoins;
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); ) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY)) {
+            ++it;
+            continue;
+        }
+        CCoinsCacheEntry& entry = mapCoins.emplace(std::piecewise_construct, std::forward_as_tuple(it->first), std::forward_as_tuple()).first->second;
+        entry.flags = it->second.flags;
+        if (it->second.coin.IsSpent()) {
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            it = cacheCoins.erase(it);
+        } else {
+            // The base has the coin now, so it is neither dirty nor fresh
+            entry.coin = it->second.coin;
+            it->second.flags = 0;
+            ++it;
+        }
+    }
+
+    CAnchorsMap mapAnchors;
+    for (CAnchorsMap::iterator it = cacheAnchors.begin(); it != cacheAnchors.end(); ) {
+        if (!(it->second.flags & CAnchorsCacheEntry::DIRTY)) {
+            ++it;
+            continue;
+        }
+        mapAnchors.insert(*it);
+        auto lru = std::find(vAnchorsLRU.begin(), vAnchorsLRU.end(), it->first);
+        if (!it->second.entered) {
+            if (lru != vAnchorsLRU.end())
+                vAnchorsLRU.erase(lru);
+            cachedCoinsUsage -= it->second.DynamicMemoryUsage();
+            it = cacheAnchors.erase(it);
+        } else {
+            // Clean trees are bounded by the LRU like those read from the base
+            it->second.flags = 0;
+            if (lru == vAnchorsLRU.end())
+                vAnchorsLRU.push_back(it->first);
+            ++it;
+        }
+    }
+    // Keep the best anchor, which the next block builds on
+    auto best = std::find(vAnchorsLRU.begin(), vAnchorsLRU.end(), hashAnchor);
+    if (best != vAnchorsLRU.end())
+        std::rotate(best, best + 1, vAnchorsLRU.end());
+    TrimAnchors();
+
+    CNullifiersMap mapNullifiers;
+    for (CNullifiersMap::iterator it = cacheNullifiers.begin(); it != cacheNullifiers.end(); ++it) {
+        if (it->second.flags & CNullifiersCacheEntry::DIRTY) {
+            mapNullifiers.insert(*it);
+            it->second.flags = 0;
+        }
+    }
+
+    counters.nSyncs++;
+    return base->BatchWrite(mapCoins, hashBlock, hashAnchor, mapAnchors, mapNullifiers);
+}
+
+void CCoinsViewCache::Trim(size_t nTargetUsage) {
+    for (CNullifiersMap::iterator it = cacheNullifiers.begin(); it != cacheNullifiers.end(); ) {
+        if (it->second.flags & CNullifiersCacheEntry::DIRTY) {
+            ++it;
+        } else {
+            it = cacheNullifiers.erase(it);
+        }
+    }
+
+    // Sweep the table like a clock hand from where the last pass stopped,
+    // giving coins that were looked up meanwhile a second chance. Two turns
+    // are enough to clear every mark. The map keeps the memory of evicted
+    // coins until it is shrunk below, so aim at its usage after that.
+    CCoinsMap::iterator it = cacheCoins.from_bucket(nTrimCursor);
+    for (size_t nSteps = 2 * cacheCoins.size(); nSteps > 0 && ShrunkDynamicMemoryUsage() > nTargetUsage; nSteps--) {
+        if (it == cacheCoins.end()) {
+            it = cacheCoins.begin();
+            if (it == cacheCoins.end())
+                break;
+        }
+        if (it->second.flags != 0) {
+            ++it;
+        } else if (it->second.used) {
+            it->second.used = false;
+            ++it;
+        } else {
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            it = cacheCoins.erase(it);
+            counters.nEvicted++;
+        }
+    }
+    if (ShrunkDynamicMemoryUsage() == DynamicMemoryUsage()) {
+        nTrimCursor = it == cacheCoins.end() ? 0 : cacheCoins.bucket_of(it);
+        return;
+    }
+
+    // Shrinking moves every coin, so find the cursor again by its key
+    const bool fAtEnd = it == cacheCoins.end();
+    const COutPoint cursor = fAtEnd ? COutPoint() : it->first;
+    cacheCoins.shrink_to_fit();
+    it = fAtEnd ? cacheCoins.end() : cacheCoins.find(cursor);
+    nTrimCursor = it == cacheCoins.end() ? 0 : cacheCoins.bucket_of(it);
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
@@ -427,10 +603,7 @@ bool CCoinsViewCache::HaveJoinSplitRequirements(const CTransaction& tx) const
             return false;
         }
 
-        for(const uint256& commitment : joinsplit.commitments)
-        {
-            tree.append(commitment);
-        }
+        tree.append_batch(std::vector<libzcash::SHA256Compress>(joinsplit.commitments.begin(), joinsplit.commitments.end()));
 
         intermediates.insert(std::make_pair(tree.root(), tree));
     }
@@ -11,6 +11,7 @@
 #include <core_memusage.h>
 #include <hash.h>
 #include <memusage.h>
+#include <pooledmap.h>
 #include <serialize.h>
 #include <uint256.h>
 
@@ -118,6 +119,7 @@ struct CCoinsCacheEntry
 {
     Coin coin; // The actual cached data.
     unsigned char flags;
+    bool used; // Looked up since CCoinsViewCache::Trim last went past it.
 
     enum Flags {
         DIRTY = (1 << 0), // This cache entry is potentially different from the version in the parent view.
@@ -129,14 +131,16 @@ struct CCoinsCacheEntry
          */
     };
 
-    CCoinsCacheEntry() : flags(0) {}
-    explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
+    CCoinsCacheEntry() : flags(0), used(true) {}
+    explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0), used(true) {}
 };
 
 struct CAnchorsCacheEntry
 {
     bool entered; // This will be false if the anchor is removed from the cache
     ZCIncrementalMerkleTree tree; // The tree itself
+    uint256 prevRoot; // The anchor this tree was derived from, if known
+    std::vector<uint256> commitments; // The commitments appended to prevRoot's tree to get this one
     unsigned char flags;
 
     enum Flags {
@@ -144,6 +148,10 @@ struct CAnchorsCacheEntry
     };
 
 CAnchorsCacheEntry() : entered(false), flags(0) {}
+
+    size_t DynamicMemoryUsage() const {
+        return tree.DynamicMemoryUsage() + memusage::DynamicUsage(commitments);
+    }
 };
 
 struct CNullifiersCacheEntry
@@ -158,7 +166,7 @@ struct CNullifiersCacheEntry
 CNullifiersCacheEntry() : entered(false), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+typedef pooled_hash_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
 typedef std::unordered_map<uint256, CAnchorsCacheEntry, SaltedUint256Hasher> CAnchorsMap;
 typedef std::unordered_map<uint256, CNullifiersCacheEntry, SaltedUint256Hasher> CNullifiersMap;
 
@@ -258,6 +266,19 @@ public:
 };
 
 
+/** Maximum number of clean anchor trees a CCoinsViewCache keeps in memory */
+static const size_t MAX_CACHED_ANCHORS = 64;
+
+/** How a CCoinsViewCache has been used, for the getcoinscacheinfo RPC */
+struct CCoinsCacheCounters
+{
+    uint64_t nHits = 0;     //!< Coin lookups found in the cache
+    uint64_t nMisses = 0;   //!< Coin lookups passed on to the base view
+    uint64_t nEvicted = 0;  //!< Coins evicted by Trim
+    uint64_t nSyncs = 0;    //!< Calls to Sync
+    uint64_t nFlushes = 0;  //!< Calls to Flush
+};
+
 /** CCoinsView that adds a memory cache for transactions to another CCoinsView */
 class CCoinsViewCache : public CCoinsViewBacked
 {
@@ -272,9 +293,17 @@ protected:
     mutable CAnchorsMap cacheAnchors;
     mutable CNullifiersMap cacheNullifiers;
 
+    /* Clean anchors read from the base view, least recently used first. */
+    mutable std::vector<uint256> vAnchorsLRU;
+
     /* Cached dynamic memory usage for the inner Coin objects. */
     mutable size_t cachedCoinsUsage;
 
+    /* The bucket of cacheCoins at which Trim carries on. */
+    size_t nTrimCursor;
+
+    mutable CCoinsCacheCounters counters;
+
 public:
     CCoinsViewCache(CCoinsView *baseIn);
 
@@ -301,8 +330,10 @@ public:
     }
 
     // Adds the tree to mapAnchors and sets the current commitment
-    // root to this root.
-    void PushAnchor(const ZCIncrementalMerkleTree &tree);
+    // root to this root. If given, commitments are those appended to
+    // the current best anchor's tree to get this one, which lets the
+    // database store the tree as a delta.
+    void PushAnchor(const ZCIncrementalMerkleTree &tree, const std::vector<uint256> &commitments = std::vector<uint256>());
 
     // Removes the current commitment root from mapAnchors and sets
     // the new current root.
@@ -318,6 +349,16 @@ public:
      */
     bool HaveCoinInCache(const COutPoint &outpoint) const;
 
+    /**
+     * Add a coin, nullifier or anchor that was read from the backing view
+     * without going through this cache, e.g. ahead of connecting a block.
+     * Entries this cache already has are left alone. The caller must make
+     * sure the backing view has not changed since it was read.
+     */
+    void AddPrefetchedCoin(const COutPoint &outpoint, Coin&& coin);
+    void AddPrefetchedNullifier(const uint256 &nullifier, bool spent);
+    void AddPrefetchedAnchor(const uint256 &rt, const ZCIncrementalMerkleTree &tree);
+
     /**
      * Return a reference to Coin in the cache, or a pruned one if not found. This is
      * more efficient than GetCoin.
@@ -350,12 +391,31 @@ public:
      */
     bool Flush();
 
+    /**
+     * Push the modifications applied to this cache to its base, like Flush,
+     * but keep the entries, now unmodified, so that the cache stays warm.
+     * Spent coins and removed anchors are dropped.
+     * If false is returned, the state of this cache (and its backing view) will be undefined.
+     */
+    bool Sync();
+
+    /**
+     * Evict unmodified entries until the cache uses at most nTargetUsage
+     * bytes, or only modified entries are left. Nullifiers go first, then
+     * coins that were not looked up since the previous pass went past them,
+     * an approximation of least recently used. The memory of the evicted
+     * coins is released.
+     */
+    void Trim(size_t nTargetUsage);
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is
      * not modified.
      */
     void Uncache(const COutPoint &outpoint);
 
+    const CCoinsCacheCounters& GetCounters() const { return counters; }
+
     //! Calculate the size of the cache (in number of transaction outputs)
     unsigned int GetCacheSize() const;
 
@@ -381,6 +441,10 @@ public:
 
 private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
+    void CacheAnchor(const uint256 &rt, const ZCIncrementalMerkleTree &tree) const;
+    void TrimAnchors() const;
+    //! DynamicMemoryUsage once cacheCoins has released the memory of erased coins
+    size_t ShrunkDynamicMemoryUsage() const;
 };
 
 //! Utility function to add all of a transaction's outputs to a cache.
@@ -1,42 +1,207 @@
-bool CheckTransactionJoinsplits(const CTransaction& tx, CValidationState &state)
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <consensus/joinsplit.h>
+
+#include <consensus/validation.h>
+#include <hash.h>
+#include <init.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/interpreter.h>
+#include <script/sigcache.h>
+#include <util.h>
+
+#include <zcash/Proof.hpp>
+
+#include <cuckoocache.h>
+
+#include <algorithm>
+
+#include <boost/thread.hpp>
+
+#include <sodium.h>
+
+static_assert(crypto_sign_PUBLICKEYBYTES == 32, "joinSplitPubKey must be an Ed25519 public key");
+
+namespace {
+/**
+ * Valid JoinSplit proof cache, to avoid verifying a zk-SNARK twice for every
+ * shielded transaction (once when accepted into memory pool, and again when
+ * accepted into the block chain)
+ */
+class CJoinSplitCache
 {
-    if (tx.vjoinsplit.size() > 0) {
-        // Empty output script.
-        CScript scriptCode;
-        uint256 dataToBeSigned;
-        int hashtype = SIGHASH_ALL;
-        if(flags & SCRIPT_VERIFY_FORKID)
-            hashtype |= SIGHASH_FORKID;
-
-        try {
-            dataToBeSigned = SignatureHash(scriptCode, tx, NOT_AN_INPUT,
-                                           hashtype, (flags & SCRIPT_VERIFY_FORKID) ? FORKID_IN_USE : FORKID_NONE);
-        } catch (std::logic_error ex) {
-            return state.DoS(100, error("CheckTransaction(): error computing signature hash"),
-                             REJECT_INVALID, "error-computing-signature-hash");
-        }
+private:
+    //! Entries are SHA256d(nonce || joinSplitPubKey || public inputs || proof)
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_joinsplitcache;
 
-        BOOST_STATIC_ASSERT(crypto_sign_PUBLICKEYBYTES == 32);
+public:
+    CJoinSplitCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
 
-        // We rely on libsodium to check that the signature is canonical.
-        // https://github.com/jedisct1/libsodium/commit/62911edb7ff2275cccd74bf1c8aefcc4d76924e0
-        if (crypto_sign_verify_detached(&tx.joinSplitSig[0],
-                                        dataToBeSigned.begin(), 32,
-                                        tx.joinSplitPubKey.begin()
-                ) != 0) {
+    void
+    ComputeEntry(uint256& entry, const CTransaction& tx, unsigned int nJoinSplit)
+    {
+        // Everything the proof's primary input is computed from, and the
+        // proof itself
+        const JSDescription& js = tx.vjoinsplit[nJoinSplit];
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << nonce << tx.joinSplitPubKey << js.vpub_old << js.vpub_new << js.anchor
+           << js.nullifiers << js.commitments << js.randomSeed << js.macs << js.proof;
+        entry = ss.GetHash();
+    }
 
-            return state.DoS(100, error("CheckTransaction(): invalid joinsplit signature"),
-                             REJECT_INVALID, "bad-txns-invalid-joinsplit-signature");
+    bool
+    Get(const uint256& entry, const bool erase)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_joinsplitcache);
+        return setValid.contains(entry, erase);
+    }
+
+    void Set(uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_joinsplitcache);
+        setValid.insert(entry);
+    }
+    uint32_t setup_bytes(size_t n)
+    {
+        return setValid.setup_bytes(n);
+    }
+};
+
+static CJoinSplitCache joinSplitCache;
+} // namespace
+
+// To be called once in AppInitMain/BasicTestingSetup to initialize the
+// joinSplitCache.
+void InitJoinSplitCache()
+{
+    // nMaxCacheSize is unsigned. If -maxjoinsplitcachesize is set to zero,
+    // setup_bytes creates the minimum possible cache (2 elements).
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxjoinsplitcachesize", DEFAULT_MAX_JOINSPLIT_CACHE_SIZE)), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = joinSplitCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for JoinSplit proof cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+/** Verify the Ed25519 joinSplitSig of tx over its SIGHASH_ALL signature hash. */
+static bool CheckJoinSplitSignature(const CTransaction& tx, unsigned int flags)
+{
+    // Empty output script.
+    CScript scriptCode;
+    int hashtype = SIGHASH_ALL;
+    if (flags & SCRIPT_VERIFY_FORKID)
+        hashtype |= SIGHASH_FORKID;
+
+    uint256 dataToBeSigned;
+    try {
+        dataToBeSigned = SignatureHash(scriptCode, tx, NOT_AN_INPUT, hashtype,
+                                       (flags & SCRIPT_VERIFY_FORKID) ? FORKID_IN_USE : FORKID_NONE,
+                                       0, SigVersion::BASE);
+    } catch (const std::logic_error&) {
+        return false;
+    }
+
+    // We rely on libsodium to check that the signature is canonical.
+    // https://github.com/jedisct1/libsodium/commit/62911edb7ff2275cccd74bf1c8aefcc4d76924e0
+    return crypto_sign_verify_detached(&tx.joinSplitSig[0],
+                                       dataToBeSigned.begin(), 32,
+                                       tx.joinSplitPubKey.begin()) == 0;
+}
+
+bool CJoinSplitCheck::operator()() {
+    if (IsSignatureCheck()) {
+        return CheckJoinSplitSignature(*vJoinSplits[0].first, nFlags);
+    }
+
+    // Every closure gets its own verification context, as they are run
+    // concurrently from the check queue workers.
+    auto verifier = vJoinSplits.size() > 1 ? libzcash::ProofVerifier::Batch() : libzcash::ProofVerifier::Strict();
+    for (const auto& js : vJoinSplits) {
+        const CTransaction& tx = *js.first;
+        if (!tx.vjoinsplit[js.second].Verify(*pzcashParams, verifier, tx.joinSplitPubKey))
+            return false;
+    }
+    if (!verifier.verify_batch())
+        return false;
+
+    if (cacheStore) {
+        for (const auto& js : vJoinSplits) {
+            uint256 entry;
+            joinSplitCache.ComputeEntry(entry, *js.first, js.second);
+            joinSplitCache.Set(entry);
+        }
+    }
+    return true;
+}
+
+void CJoinSplitCheck::Batch(std::vector<CJoinSplitCheck>& vChecks, size_t nBatches)
+{
+    std::vector<CJoinSplitCheck> vBatched;
+    std::vector<std::pair<const CTransaction*, unsigned int>> vProofs;
+    bool cacheStore = false;
+    for (CJoinSplitCheck& check : vChecks) {
+        if (check.IsSignatureCheck()) {
+            vBatched.emplace_back();
+            vBatched.back().swap(check);
+        } else {
+            vProofs.insert(vProofs.end(), check.vJoinSplits.begin(), check.vJoinSplits.end());
+            cacheStore |= check.cacheStore;
+        }
+    }
+
+    nBatches = std::max<size_t>(1, std::min(nBatches, vProofs.size()));
+    for (size_t i = 0; i < nBatches; i++) {
+        CJoinSplitCheck batch;
+        batch.cacheStore = cacheStore;
+        for (size_t j = i; j < vProofs.size(); j += nBatches) {
+            batch.vJoinSplits.push_back(vProofs[j]);
+        }
+        if (!batch.vJoinSplits.empty()) {
+            vBatched.emplace_back();
+            vBatched.back().swap(batch);
         }
+    }
+    vChecks.swap(vBatched);
+}
+
+bool CheckTransactionJoinsplits(const CTransaction& tx, CValidationState &state, unsigned int flags, bool cacheStore, std::vector<CJoinSplitCheck> *pvChecks)
+{
+    if (tx.vjoinsplit.empty())
+        return true;
 
-        // Ensure that zk-SNARKs verify
-        auto verifier = libzcash::ProofVerifier::Strict();
-        for(const JSDescription &joinsplit : tx.vjoinsplit) {
-            if (!joinsplit.Verify(pzcashParams.get(), verifier, tx.joinSplitPubKey)) {
-                return state.DoS(100, error("CheckTransaction(): joinsplit does not verify"),
-                                 REJECT_INVALID, "bad-txns-joinsplit-verification-failed");
-            }
+    std::vector<CJoinSplitCheck> vChecks;
+    std::vector<CJoinSplitCheck>& vOut = pvChecks ? *pvChecks : vChecks;
+    vOut.reserve(vOut.size() + tx.vjoinsplit.size() + 1);
+    vOut.emplace_back(tx, CJoinSplitCheck::SIGNATURE, flags, cacheStore);
+    for (unsigned int i = 0; i < tx.vjoinsplit.size(); i++) {
+        uint256 entry;
+        joinSplitCache.ComputeEntry(entry, tx, i);
+        if (joinSplitCache.Get(entry, !cacheStore))
+            continue;
+        vOut.emplace_back(tx, i, flags, cacheStore);
+    }
+    if (pvChecks)
+        return true;
+
+    // Verify all of this transaction's zk-SNARKs as one batch
+    CJoinSplitCheck::Batch(vChecks, 1);
+    for (CJoinSplitCheck& check : vChecks) {
+        if (check())
+            continue;
+        if (check.IsSignatureCheck()) {
+            return state.DoS(100, error("CheckTransactionJoinsplits(): invalid joinsplit signature"),
+                             REJECT_INVALID, "bad-txns-invalid-joinsplit-signature");
         }
+        return state.DoS(100, error("CheckTransactionJoinsplits(): joinsplit does not verify"),
+                         REJECT_INVALID, "bad-txns-joinsplit-verification-failed");
     }
     return true;
 }
@@ -5,6 +5,70 @@
 #ifndef BITCOIN_CONSENSUS_JOINSPLIT_H
 #define BITCOIN_CONSENSUS_JOINSPLIT_H
 
-bool CheckTransactionJoinsplits(const CTransaction& tx, CValidationState &state);
+#include <climits>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+class CTransaction;
+class CValidationState;
+
+// JoinSplit proof cache size, in MiB
+static const unsigned int DEFAULT_MAX_JOINSPLIT_CACHE_SIZE = 8;
+
+/**
+ * Closure representing JoinSplit verifications: either the transaction's
+ * joinSplitSig, or the zk-SNARK proofs of one or more JSDescriptions, which
+ * are then batch verified.
+ * Note that this stores references to the transactions being verified.
+ */
+class CJoinSplitCheck
+{
+private:
+    //! (transaction, index into its vjoinsplit or SIGNATURE) pairs to verify
+    std::vector<std::pair<const CTransaction*, unsigned int>> vJoinSplits;
+    unsigned int nFlags;
+    bool cacheStore;
+
+public:
+    //! Sentinel JoinSplit index selecting the joinSplitSig check
+    static const unsigned int SIGNATURE = UINT_MAX;
+
+    CJoinSplitCheck(): nFlags(0), cacheStore(false) {}
+    CJoinSplitCheck(const CTransaction& txToIn, unsigned int nJoinSplitIn, unsigned int nFlagsIn, bool cacheIn) :
+        vJoinSplits(1, std::make_pair(&txToIn, nJoinSplitIn)), nFlags(nFlagsIn), cacheStore(cacheIn) { }
+
+    bool operator()();
+
+    void swap(CJoinSplitCheck &check) {
+        vJoinSplits.swap(check.vJoinSplits);
+        std::swap(nFlags, check.nFlags);
+        std::swap(cacheStore, check.cacheStore);
+    }
+
+    bool IsSignatureCheck() const { return vJoinSplits.size() == 1 && vJoinSplits[0].second == SIGNATURE; }
+
+    /**
+     * Merge the proof checks in vChecks into at most nBatches closures of
+     * similar size, each verifying its proofs as a single batch. Signature
+     * checks are left untouched.
+     */
+    static void Batch(std::vector<CJoinSplitCheck>& vChecks, size_t nBatches);
+};
+
+/** Initializes the JoinSplit proof cache */
+void InitJoinSplitCache();
+
+/**
+ * Check the joinSplitSig and every JoinSplit proof of tx.
+ * If pvChecks is not nullptr, the checks are appended to it instead of being
+ * run, so that the caller can hand them to a CCheckQueue.
+ *
+ * Proofs found in the JoinSplit proof cache are not checked again. Setting
+ * cacheStore adds the proofs that verify to the cache, otherwise the proofs
+ * found in it are removed, as when connecting a block they are unlikely to
+ * be needed again.
+ */
+bool CheckTransactionJoinsplits(const CTransaction& tx, CValidationState &state, unsigned int flags, bool cacheStore, std::vector<CJoinSplitCheck> *pvChecks = nullptr);
 
 #endif // BITCOIN_CONSENSUS_JOINSPLIT_H
@@ -0,0 +1,324 @@
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/blake2b.h>
+#include <crypto/common.h>
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#if defined(USE_ASM)
+#include <cpuid.h>
+#endif
+#endif
+
+namespace blake2b_sse41
+{
+void Compress_2way(uint64_t* out, const uint64_t* h, uint64_t t, const uint64_t* m);
+}
+
+namespace blake2b_avx2
+{
+void Compress_4way(uint64_t* out, const uint64_t* h, uint64_t t, const uint64_t* m);
+}
+
+// Internal implementation code.
+namespace
+{
+/// Internal BLAKE2b implementation.
+namespace blake2b
+{
+const uint64_t IV[8] = {
+    0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull, 0xa54ff53a5f1d36f1ull,
+    0x510e527fade682d1ull, 0x9b05688c2b3e6c1full, 0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull,
+};
+
+const unsigned char SIGMA[12][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+};
+
+uint64_t inline Rotr(uint64_t x, int n) { return (x >> n) | (x << (64 - n)); }
+
+/** The BLAKE2b mixing function. */
+void inline G(uint64_t& a, uint64_t& b, uint64_t& c, uint64_t& d, uint64_t x, uint64_t y)
+{
+    a = a + b + x;
+    d = Rotr(d ^ a, 32);
+    c = c + d;
+    b = Rotr(b ^ c, 24);
+    a = a + b + y;
+    d = Rotr(d ^ a, 16);
+    c = c + d;
+    b = Rotr(b ^ c, 63);
+}
+
+/** Compress the 16 message words m into the chaining value h. */
+void Compress(uint64_t* h, const uint64_t* m, uint64_t t, bool last)
+{
+    uint64_t v[16];
+    for (int i = 0; i < 8; i++) {
+        v[i] = h[i];
+        v[i + 8] = IV[i];
+    }
+    v[12] ^= t;
+    if (last) v[14] = ~v[14];
+
+    for (int r = 0; r < 12; r++) {
+        const unsigned char* s = SIGMA[r];
+        G(v[0], v[4], v[8], v[12], m[s[0]], m[s[1]]);
+        G(v[1], v[5], v[9], v[13], m[s[2]], m[s[3]]);
+        G(v[2], v[6], v[10], v[14], m[s[4]], m[s[5]]);
+        G(v[3], v[7], v[11], v[15], m[s[6]], m[s[7]]);
+        G(v[0], v[5], v[10], v[15], m[s[8]], m[s[9]]);
+        G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+        G(v[2], v[7], v[8], v[13], m[s[12]], m[s[13]]);
+        G(v[3], v[4], v[9], v[14], m[s[14]], m[s[15]]);
+    }
+
+    for (int i = 0; i < 8; i++) {
+        h[i] ^= v[i] ^ v[i + 8];
+    }
+}
+
+/** Final compression of a single lane. */
+void Compress_1way(uint64_t* out, const uint64_t* h, uint64_t t, const uint64_t* m)
+{
+    std::copy(h, h + 8, out);
+    Compress(out, m, t, true);
+}
+
+/** Write the first outlen bytes of each of n chaining values to out. */
+void WriteLanes(const uint64_t* lanes_h, size_t n, unsigned char* out, size_t outlen)
+{
+    for (size_t l = 0; l < n; l++) {
+        unsigned char hash[64];
+        for (int i = 0; i < 8; i++) {
+            WriteLE64(hash + 8 * i, lanes_h[8 * l + i]);
+        }
+        memcpy(out + l * outlen, hash, outlen);
+    }
+}
+
+} // namespace blake2b
+
+typedef void (*CompressLanesFn)(uint64_t*, const uint64_t*, uint64_t, const uint64_t*);
+
+CompressLanesFn CompressLanes = blake2b::Compress_1way;
+size_t nLanes = 1;
+
+bool SelfTest() {
+    // BLAKE2b-512("abc"), from RFC 7693 Appendix A
+    static const unsigned char result_abc[64] = {
+        0xba, 0x80, 0xa5, 0x3f, 0x98, 0x1c, 0x4d, 0x0d, 0x6a, 0x27, 0x97, 0xb6, 0x9f, 0x12, 0xf6, 0xe9,
+        0x4c, 0x21, 0x2f, 0x14, 0x68, 0x5a, 0xc4, 0xb7, 0x4b, 0x12, 0xbb, 0x6f, 0xdb, 0xff, 0xa2, 0xd1,
+        0x7d, 0x87, 0xc5, 0x39, 0x2a, 0xab, 0x79, 0x2d, 0xc2, 0x52, 0xd5, 0xde, 0x45, 0x33, 0xcc, 0x95,
+        0x18, 0xd3, 0x8a, 0xa8, 0xdb, 0xf1, 0x92, 0x5a, 0xb9, 0x23, 0x86, 0xed, 0xd4, 0x00, 0x99, 0x23,
+    };
+
+    uint64_t h[8];
+    const unsigned char personal[16] = {};
+    Blake2bInitPersonal(h, 64, personal);
+    unsigned char block[128] = {};
+
+    // "abc" is the word 0x00636261 at offset 0, the fourth byte being padding.
+    uint32_t words[7] = {0x00636261};
+    unsigned char out[7 * 64];
+    Blake2bFinalizeLanes(h, 3, block, 0, words, 1, out, 64);
+    if (!std::equal(out, out + 64, result_abc)) return false;
+
+    // Check every lane of the multi-lane implementation against the single
+    // lane one, using a word that straddles two message words.
+    for (int i = 0; i < 7; i++) {
+        words[i] = 0x01234567 * (i + 1);
+    }
+    Blake2bFinalizeLanes(h, 15, block, 11, words, 7, out, 64);
+    for (int i = 0; i < 7; i++) {
+        unsigned char lane[64];
+        Blake2bFinalizeLanes(h, 15, block, 11, words + i, 1, lane, 64);
+        if (!std::equal(lane, lane + 64, out + 64 * i)) return false;
+    }
+
+    // Likewise for unrelated final blocks.
+    unsigned char blocks[7 * 128];
+    for (int i = 0; i < 7 * 128; i++) {
+        blocks[i] = i * 37 + 11;
+    }
+    Blake2bFinalizeBlocks(h, 128, blocks, 7, out, 64);
+    for (int i = 0; i < 7; i++) {
+        unsigned char lane[64];
+        Blake2bFinalizeBlocks(h, 128, blocks + 128 * i, 1, lane, 64);
+        if (!std::equal(lane, lane + 64, out + 64 * i)) return false;
+    }
+
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+// We can't use cpuid.h's __get_cpuid as it does not support subleafs.
+void inline cpuid(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+#ifdef __GNUC__
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+#else
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "0"(leaf), "2"(subleaf));
+#endif
+}
+
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+void Blake2bCompress(uint64_t h[8], const unsigned char block[128], uint64_t t, bool last)
+{
+    uint64_t m[16];
+    for (int i = 0; i < 16; i++) {
+        m[i] = ReadLE64(block + 8 * i);
+    }
+    blake2b::Compress(h, m, t, last);
+}
+
+void Blake2bFinalizeLanes(const uint64_t h[8], uint64_t t, const unsigned char block[128], size_t pos,
+                          const uint32_t* words, size_t count, unsigned char* out, size_t outlen)
+{
+    assert(pos + 4 <= 128 && outlen <= 64);
+
+    unsigned char buf[128];
+    memcpy(buf, block, sizeof(buf));
+    uint64_t m[16];
+    for (int i = 0; i < 16; i++) {
+        m[i] = ReadLE64(buf + 8 * i);
+    }
+    // The message words holding the per-lane word; these are equal unless it
+    // is not aligned.
+    const size_t w0 = pos / 8, w1 = (pos + 3) / 8;
+
+    uint64_t lanes_m[4 * 16];
+    uint64_t lanes_h[4 * 8];
+    while (count > 0) {
+        size_t n = 1;
+        CompressLanesFn compress = blake2b::Compress_1way;
+        if (count >= nLanes) {
+            n = nLanes;
+            compress = CompressLanes;
+        }
+        for (size_t l = 0; l < n; l++) {
+            WriteLE32(buf + pos, words[l]);
+            std::copy(m, m + 16, lanes_m + 16 * l);
+            lanes_m[16 * l + w0] = ReadLE64(buf + 8 * w0);
+            lanes_m[16 * l + w1] = ReadLE64(buf + 8 * w1);
+        }
+        compress(lanes_h, h, t, lanes_m);
+        blake2b::WriteLanes(lanes_h, n, out, outlen);
+        out += n * outlen;
+        words += n;
+        count -= n;
+    }
+}
+
+void Blake2bInitPersonal(uint64_t h[8], size_t outlen, const unsigned char personal[16])
+{
+    assert(outlen > 0 && outlen <= 64);
+
+    std::copy(blake2b::IV, blake2b::IV + 8, h);
+    h[0] ^= 0x01010000 ^ outlen; // no key, fanout 1, depth 1
+    h[6] ^= ReadLE64(personal);
+    h[7] ^= ReadLE64(personal + 8);
+}
+
+void Blake2bFinalizeBlocks(const uint64_t h[8], uint64_t t, const unsigned char* blocks,
+                           size_t count, unsigned char* out, size_t outlen)
+{
+    assert(outlen <= 64);
+
+    uint64_t lanes_m[4 * 16];
+    uint64_t lanes_h[4 * 8];
+    while (count > 0) {
+        size_t n = 1;
+        CompressLanesFn compress = blake2b::Compress_1way;
+        if (count >= nLanes) {
+            n = nLanes;
+            compress = CompressLanes;
+        }
+        for (size_t l = 0; l < n; l++) {
+            for (int i = 0; i < 16; i++) {
+                lanes_m[16 * l + i] = ReadLE64(blocks + 8 * i);
+            }
+            blocks += 128;
+        }
+        compress(lanes_h, h, t, lanes_m);
+        blake2b::WriteLanes(lanes_h, n, out, outlen);
+        out += n * outlen;
+        count -= n;
+    }
+}
+
+std::string Blake2bAutoDetect()
+{
+    std::string ret = "standard";
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    bool have_sse4 = false;
+    bool have_xsave = false;
+    bool have_avx = false;
+    bool have_avx2 = false;
+    bool enabled_avx = false;
+
+    (void)AVXEnabled;
+    (void)have_sse4;
+    (void)have_avx;
+    (void)have_xsave;
+    (void)have_avx2;
+    (void)enabled_avx;
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    have_sse4 = (ecx >> 19) & 1;
+    have_xsave = (ecx >> 27) & 1;
+    have_avx = (ecx >> 28) & 1;
+    if (have_xsave && have_avx) {
+        enabled_avx = AVXEnabled();
+    }
+    if (have_sse4) {
+        cpuid(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+    }
+
+#if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_sse4) {
+        CompressLanes = blake2b_sse41::Compress_2way;
+        nLanes = 2;
+        ret = "sse41(2way)";
+    }
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && have_avx && enabled_avx) {
+        CompressLanes = blake2b_avx2::Compress_4way;
+        nLanes = 4;
+        ret = "avx2(4way)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
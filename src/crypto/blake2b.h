@@ -0,0 +1,52 @@
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_BLAKE2B_H
+#define BITCOIN_CRYPTO_BLAKE2B_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+/** Perform one BLAKE2b compression of a 128-byte block into the chaining
+ *  value h, t being the message length up to and including this block. */
+void Blake2bCompress(uint64_t h[8], const unsigned char block[128], uint64_t t, bool last);
+
+/** Set h to the initial chaining value of an unkeyed, unsalted BLAKE2b hash
+ *  with an outlen-byte digest and a 16-byte personalization. */
+void Blake2bInitPersonal(uint64_t h[8], size_t outlen, const unsigned char personal[16]);
+
+/** Compute multiple BLAKE2b hashes that only differ in a 32-bit word of their
+ *  final block, as when Equihash hashes its indices onto a common prefix.
+ *  h:       chaining value before the final block
+ *  t:       total message length in bytes
+ *  block:   the final block, zero padded
+ *  pos:     offset of the 32-bit little-endian word in block
+ *  words:   the word to use for each hash
+ *  count:   the number of hashes to compute
+ *  out:     pointer to a count*outlen byte output buffer
+ *  outlen:  the number of bytes to output per hash, at most 64
+ */
+void Blake2bFinalizeLanes(const uint64_t h[8], uint64_t t, const unsigned char block[128], size_t pos,
+                          const uint32_t* words, size_t count, unsigned char* out, size_t outlen);
+
+/** Compute multiple BLAKE2b hashes whose final blocks are unrelated but share
+ *  the chaining value before them, as for many single-block messages hashed
+ *  with the same parameters.
+ *  h:       chaining value before the final block
+ *  t:       total message length in bytes
+ *  blocks:  count final blocks of 128 bytes each, zero padded
+ *  count:   the number of hashes to compute
+ *  out:     pointer to a count*outlen byte output buffer
+ *  outlen:  the number of bytes to output per hash, at most 64
+ */
+void Blake2bFinalizeBlocks(const uint64_t h[8], uint64_t t, const unsigned char* blocks,
+                           size_t count, unsigned char* out, size_t outlen);
+
+/** Autodetect the best available multi-lane BLAKE2b implementation.
+ *  Returns the name of the implementation.
+ */
+std::string Blake2bAutoDetect();
+
+#endif // BITCOIN_CRYPTO_BLAKE2B_H
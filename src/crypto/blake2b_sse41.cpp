@@ -0,0 +1,99 @@
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_SSE41
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace blake2b_sse41 {
+namespace {
+
+const uint64_t IV[8] = {
+    0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull, 0xa54ff53a5f1d36f1ull,
+    0x510e527fade682d1ull, 0x9b05688c2b3e6c1full, 0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull,
+};
+
+const unsigned char SIGMA[12][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+};
+
+__m128i inline K(uint64_t x) { return _mm_set1_epi64x(x); }
+
+__m128i inline Add(__m128i x, __m128i y) { return _mm_add_epi64(x, y); }
+__m128i inline Add(__m128i x, __m128i y, __m128i z) { return Add(Add(x, y), z); }
+__m128i inline Xor(__m128i x, __m128i y) { return _mm_xor_si128(x, y); }
+__m128i inline Xor(__m128i x, __m128i y, __m128i z) { return Xor(Xor(x, y), z); }
+
+// Rotations by multiples of 8 bits are byte shuffles within each 64-bit lane.
+__m128i inline Rotr32(__m128i x) { return _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)); }
+__m128i inline Rotr24(__m128i x) { return _mm_shuffle_epi8(x, _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10)); }
+__m128i inline Rotr16(__m128i x) { return _mm_shuffle_epi8(x, _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9)); }
+__m128i inline Rotr63(__m128i x) { return Xor(_mm_srli_epi64(x, 63), Add(x, x)); }
+
+/** The BLAKE2b mixing function. */
+void inline __attribute__((always_inline)) G(__m128i& a, __m128i& b, __m128i& c, __m128i& d, __m128i x, __m128i y)
+{
+    a = Add(a, b, x);
+    d = Rotr32(Xor(d, a));
+    c = Add(c, d);
+    b = Rotr24(Xor(b, c));
+    a = Add(a, b, y);
+    d = Rotr16(Xor(d, a));
+    c = Add(c, d);
+    b = Rotr63(Xor(b, c));
+}
+
+}
+
+void Compress_2way(uint64_t* out, const uint64_t* h, uint64_t t, const uint64_t* m)
+{
+    __m128i w[16];
+    for (int i = 0; i < 16; i++) {
+        w[i] = _mm_set_epi64x(m[16 + i], m[i]);
+    }
+
+    __m128i v0 = K(h[0]), v1 = K(h[1]), v2 = K(h[2]), v3 = K(h[3]);
+    __m128i v4 = K(h[4]), v5 = K(h[5]), v6 = K(h[6]), v7 = K(h[7]);
+    __m128i v8 = K(IV[0]), v9 = K(IV[1]), v10 = K(IV[2]), v11 = K(IV[3]);
+    __m128i v12 = K(IV[4] ^ t), v13 = K(IV[5]), v14 = K(~IV[6]), v15 = K(IV[7]);
+
+    for (int r = 0; r < 12; r++) {
+        const unsigned char* s = SIGMA[r];
+        G(v0, v4, v8, v12, w[s[0]], w[s[1]]);
+        G(v1, v5, v9, v13, w[s[2]], w[s[3]]);
+        G(v2, v6, v10, v14, w[s[4]], w[s[5]]);
+        G(v3, v7, v11, v15, w[s[6]], w[s[7]]);
+        G(v0, v5, v10, v15, w[s[8]], w[s[9]]);
+        G(v1, v6, v11, v12, w[s[10]], w[s[11]]);
+        G(v2, v7, v8, v13, w[s[12]], w[s[13]]);
+        G(v3, v4, v9, v14, w[s[14]], w[s[15]]);
+    }
+
+    const __m128i res[8] = {
+        Xor(K(h[0]), v0, v8), Xor(K(h[1]), v1, v9), Xor(K(h[2]), v2, v10), Xor(K(h[3]), v3, v11),
+        Xor(K(h[4]), v4, v12), Xor(K(h[5]), v5, v13), Xor(K(h[6]), v6, v14), Xor(K(h[7]), v7, v15),
+    };
+    for (int i = 0; i < 8; i++) {
+        uint64_t lanes[2];
+        _mm_storeu_si128((__m128i*)lanes, res[i]);
+        out[i] = lanes[0];
+        out[8 + i] = lanes[1];
+    }
+}
+
+}
+
+#endif
@@ -17,6 +17,8 @@
 #endif
 
 #include "compat/endian.h"
+#include "crypto/common.h"
+#include "crypto/blake2b.h"
 #include "crypto/equihash.h"
 #include "util.h"
 
@@ -33,26 +35,72 @@ int Equihash<N,K>::InitialiseState(eh_HashState& base_state)
 {
     uint32_t le_N = htole32(N);
     uint32_t le_K = htole32(K);
-    unsigned char personalization[crypto_generichash_blake2b_PERSONALBYTES] = {};
+    unsigned char personalization[16] = {};
     memcpy(personalization, "ZcashPoW", 8);
     memcpy(personalization+8,  &le_N, 4);
     memcpy(personalization+12, &le_K, 4);
-    return crypto_generichash_blake2b_init_salt_personal(&base_state,
-                                                         NULL, 0, // No key.
-                                                         (512/N)*N/8,
-                                                         NULL,    // No salt.
-                                                         personalization);
+    Blake2bInitPersonal(base_state.h, (512/N)*N/8, personalization);
+    base_state.t = 0;
+    base_state.buflen = 0;
+    return 0;
+}
+
+void eh_HashState::Update(const unsigned char* input, size_t inputLen)
+{
+    while (inputLen > 0) {
+        if (buflen == sizeof(buf)) {
+            t += sizeof(buf);
+            Blake2bCompress(h, buf, t, false);
+            buflen = 0;
+        }
+        const size_t n = std::min(inputLen, sizeof(buf) - buflen);
+        memcpy(buf + buflen, input, n);
+        buflen += n;
+        input += n;
+        inputLen -= n;
+    }
 }
 
 void GenerateHash(const eh_HashState& base_state, eh_index g,
                   unsigned char* hash, size_t hLen)
 {
-    eh_HashState state;
-    state = base_state;
-    eh_index lei = htole32(g);
-    crypto_generichash_blake2b_update(&state, (const unsigned char*) &lei,
-                                      sizeof(eh_index));
-    crypto_generichash_blake2b_final(&state, hash, hLen);
+    GenerateHashes(base_state, &g, 1, hash, hLen);
+}
+
+void GenerateHashes(const eh_HashState& base_state, const eh_index* indices, size_t count,
+                    unsigned char* hashes, size_t hLen)
+{
+    const uint64_t t = base_state.t + base_state.buflen + sizeof(eh_index);
+    if (base_state.buflen + sizeof(eh_index) <= sizeof(base_state.buf)) {
+        unsigned char block[128] = {};
+        memcpy(block, base_state.buf, base_state.buflen);
+        Blake2bFinalizeLanes(base_state.h, t, block, base_state.buflen, indices, count, hashes, hLen);
+        return;
+    }
+
+    // The index straddles two blocks, the first of which differs for every
+    // index too.
+    for (size_t i = 0; i < count; i++) {
+        unsigned char blocks[2 * 128] = {};
+        memcpy(blocks, base_state.buf, base_state.buflen);
+        WriteLE32(blocks + base_state.buflen, indices[i]);
+        uint64_t h[8];
+        std::copy(base_state.h, base_state.h + 8, h);
+        Blake2bCompress(h, blocks, base_state.t + 128, false);
+        Blake2bFinalizeBlocks(h, t, blocks + 128, 1, hashes + i * hLen, hLen);
+    }
+}
+
+/** GenerateHashes for the count consecutive indices starting at first. */
+static void GenerateHashRange(const eh_HashState& base_state, eh_index first, size_t count,
+                              unsigned char* hashes, size_t hLen)
+{
+    eh_index indices[EH_HASH_BATCH];
+    assert(count <= EH_HASH_BATCH);
+    for (size_t i = 0; i < count; i++) {
+        indices[i] = first + i;
+    }
+    GenerateHashes(base_state, indices, count, hashes, hLen);
 }
 
 void ExpandArray(const unsigned char* in, size_t in_len,
@@ -338,9 +386,11 @@ bool Equihash<N,K>::BasicSolve(const eh_HashState& base_state,
     size_t lenIndices = sizeof(eh_index);
     std::vector<FullStepRow<FullWidth>> X;
     X.reserve(init_size);
-    unsigned char tmpHash[HashOutput];
+    unsigned char tmpHashes[EH_HASH_BATCH * HashOutput];
     for (eh_index g = 0; X.size() < init_size; g++) {
-        GenerateHash(base_state, g, tmpHash, HashOutput);
+        if (g % EH_HASH_BATCH == 0)
+            GenerateHashRange(base_state, g, EH_HASH_BATCH, tmpHashes, HashOutput);
+        const unsigned char* tmpHash = tmpHashes + (g % EH_HASH_BATCH) * HashOutput;
         for (eh_index i = 0; i < IndicesPerHashOutput && X.size() < init_size; i++) {
             X.emplace_back(tmpHash+(i*N/8), N/8, HashLength,
                            CollisionBitLength, (g*IndicesPerHashOutput)+i);
@@ -512,14 +562,22 @@ bool Equihash<N,K>::OptimisedSolve(const eh_HashState& base_state,
     {
 
         // 1) Generate first list
+        // The list and the overflow buffer below are reused by every round,
+        // but not kept across calls: a caller solving one nonce after the
+        // other would hold their memory, over a GiB with the mainnet
+        // parameters, between solves, and allocating them once per call
+        // costs little next to sorting them K times. The lists recreating
+        // the indices below only hold the candidates of single indices.
         LogPrint(BCLog::EQUIHASH, "Generating first list\n");
         size_t hashLen = HashLength;
         size_t lenIndices = sizeof(eh_trunc);
         std::vector<TruncatedStepRow<TruncatedWidth>> Xt;
         Xt.reserve(init_size);
-        unsigned char tmpHash[HashOutput];
+        unsigned char tmpHashes[EH_HASH_BATCH * HashOutput];
         for (eh_index g = 0; Xt.size() < init_size; g++) {
-            GenerateHash(base_state, g, tmpHash, HashOutput);
+            if (g % EH_HASH_BATCH == 0)
+                GenerateHashRange(base_state, g, EH_HASH_BATCH, tmpHashes, HashOutput);
+            const unsigned char* tmpHash = tmpHashes + (g % EH_HASH_BATCH) * HashOutput;
             for (eh_index i = 0; i < IndicesPerHashOutput && Xt.size() < init_size; i++) {
                 Xt.emplace_back(tmpHash+(i*N/8), N/8, HashLength, CollisionBitLength,
                                 (g*IndicesPerHashOutput)+i, CollisionBitLength + 1);
@@ -527,6 +585,10 @@ bool Equihash<N,K>::OptimisedSolve(const eh_HashState& base_state,
             if (cancelled(ListGeneration)) throw solver_cancelled;
         }
 
+        // Collisions that can't yet be stored in place
+        std::vector<TruncatedStepRow<TruncatedWidth>> Xc;
+        Xc.reserve(init_size / 4);
+
         // 3) Repeat step 2 until 2n/(k+1) bits remain
         for (int r = 1; r < K && Xt.size() > 0; r++) {
             LogPrint(BCLog::EQUIHASH, "Round %d:\n", r);
@@ -538,7 +600,7 @@ bool Equihash<N,K>::OptimisedSolve(const eh_HashState& base_state,
             LogPrint(BCLog::EQUIHASH, "- Finding collisions\n");
             int i = 0;
             int posFree = 0;
-            std::vector<TruncatedStepRow<TruncatedWidth>> Xc;
+            Xc.clear();
             while (i < Xt.size() - 1) {
                 // 2b) Find next set of unordered pairs with collisions on the next n/(k+1) bits
                 int j = 1;
@@ -583,9 +645,9 @@ bool Equihash<N,K>::OptimisedSolve(const eh_HashState& base_state,
                 // 2f) Add overflow to end of table
                 Xt.insert(Xt.end(), Xc.begin(), Xc.end());
             } else if (posFree < Xt.size()) {
-                // 2g) Remove empty space at the end
+                // 2g) Remove empty space at the end, keeping the capacity for
+                // the next round
                 Xt.erase(Xt.begin()+posFree, Xt.end());
-                Xt.shrink_to_fit();
             }
 
             hashLen -= CollisionByteLength;
@@ -643,7 +705,8 @@ bool Equihash<N,K>::OptimisedSolve(const eh_HashState& base_state,
         for (eh_index i = 0; i < soln_size; i++) {
             // 1) Generate first list of possibilities
             std::vector<FullStepRow<FinalFullWidth>> icv;
-            icv.reserve(recreate_size);
+            // Leave room for merging in the sibling list below
+            icv.reserve(2 * recreate_size);
             for (eh_index j = 0; j < recreate_size; j++) {
                 eh_index newIndex { UntruncateIndex(partialSoln.get()[i], j, CollisionBitLength + 1) };
                 if (j == 0 || newIndex % IndicesPerHashOutput == 0) {
@@ -654,7 +717,7 @@ bool Equihash<N,K>::OptimisedSolve(const eh_HashState& base_state,
                                  N/8, HashLength, CollisionBitLength, newIndex);
                 if (cancelled(PartialGeneration)) throw solver_cancelled;
             }
-            boost::optional<std::vector<FullStepRow<FinalFullWidth>>> ic = icv;
+            boost::optional<std::vector<FullStepRow<FinalFullWidth>>> ic = std::move(icv);
 
             // 2a) For each pair of lists:
             hashLen = HashLength;
@@ -684,11 +747,11 @@ bool Equihash<N,K>::OptimisedSolve(const eh_HashState& base_state,
                         lenIndices *= 2;
                         rti = lti;
                     } else {
-                        X[r] = *ic;
+                        X[r] = std::move(ic);
                         break;
                     }
                 } else {
-                    X.push_back(ic);
+                    X.push_back(std::move(ic));
                     break;
                 }
                 if (cancelled(PartialSubtreeEnd)) throw solver_cancelled;
@@ -728,12 +791,19 @@ bool Equihash<N,K>::IsValidSolution(const eh_HashState& base_state, std::vector<
         return false;
     }
 
+    std::vector<eh_index> indices { GetIndicesFromMinimal(soln, CollisionBitLength) };
+    std::vector<eh_index> hashIndices(indices.size());
+    for (size_t j = 0; j < indices.size(); j++) {
+        hashIndices[j] = indices[j]/IndicesPerHashOutput;
+    }
+    std::vector<unsigned char> hashes(indices.size() * HashOutput);
+    GenerateHashes(base_state, hashIndices.data(), hashIndices.size(), hashes.data(), HashOutput);
+
     std::vector<FullStepRow<FinalFullWidth>> X;
     X.reserve(1 << K);
-    unsigned char tmpHash[HashOutput];
-    for (eh_index i : GetIndicesFromMinimal(soln, CollisionBitLength)) {
-        GenerateHash(base_state, i/IndicesPerHashOutput, tmpHash, HashOutput);
-        X.emplace_back(tmpHash+((i % IndicesPerHashOutput) * N/8),
+    for (size_t j = 0; j < indices.size(); j++) {
+        eh_index i = indices[j];
+        X.emplace_back(hashes.data()+(j*HashOutput)+((i % IndicesPerHashOutput) * N/8),
                        N/8, HashLength, CollisionBitLength, i);
     }
 
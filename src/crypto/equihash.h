@@ -9,21 +9,53 @@
 #include "crypto/sha256.h"
 #include "utilstrencodings.h"
 
-#include "sodium.h"
-
+#include <cstdint>
 #include <cstring>
 #include <exception>
 #include <functional>
 #include <memory>
 #include <set>
+#include <stdexcept>
 #include <vector>
 
 #include <boost/static_assert.hpp>
 
-typedef crypto_generichash_blake2b_state eh_HashState;
 typedef uint32_t eh_index;
 typedef uint8_t eh_trunc;
 
+/**
+ * BLAKE2b state of an Equihash instance, into which its input I||V is hashed
+ * before each index is appended. It is kept with our own BLAKE2b code, so
+ * that GenerateHashes() can finish many indices at once from the chaining
+ * value and the buffered input.
+ */
+struct eh_HashState
+{
+    //! Chaining value after the compressed blocks
+    uint64_t h[8];
+    //! Number of bytes compressed into h
+    uint64_t t;
+    //! Input not compressed yet. BLAKE2b only compresses a block once more
+    //! input follows, so this holds from 1 to 128 bytes after any input.
+    unsigned char buf[128];
+    size_t buflen;
+
+    void Update(const unsigned char* input, size_t inputLen);
+};
+
+//! Number of hashes the solvers generate at a time
+static const size_t EH_HASH_BATCH = 64;
+
+void GenerateHash(const eh_HashState& base_state, eh_index g,
+                  unsigned char* hash, size_t hLen);
+/**
+ * Compute the hashes of count indices at once, hashes[i*hLen..] being
+ * GenerateHash(base_state, indices[i]). Uses the multi-lane BLAKE2b
+ * implementation where possible.
+ */
+void GenerateHashes(const eh_HashState& base_state, const eh_index* indices, size_t count,
+                    unsigned char* hashes, size_t hLen);
+
 void ExpandArray(const unsigned char* in, size_t in_len,
                  unsigned char* out, size_t out_len,
                  size_t bit_len, size_t byte_pad=0);
@@ -179,6 +211,12 @@ public:
     enum : size_t { FinalTruncatedWidth=max(HashLength+sizeof(eh_trunc), 2*CollisionByteLength+sizeof(eh_trunc)*(1 << (K))) };
     enum : size_t { SolutionWidth=(1 << K)*(CollisionBitLength+1)/8 };
 
+    /** Estimated peak memory of OptimisedSolve() in bytes: its first list,
+     *  with room to double when collisions overflow it. */
+    static constexpr uint64_t OptimisedSolveMemory() {
+        return (uint64_t{1} << (CollisionBitLength + 1)) * sizeof(TruncatedStepRow<TruncatedWidth>) * 2;
+    }
+
     Equihash() { }
 
     int InitialiseState(eh_HashState& base_state);
@@ -255,6 +293,21 @@ inline bool EhOptimisedSolve(unsigned int n, unsigned int k, const eh_HashState&
     }
 }
 
+inline uint64_t EhOptimisedSolveMemory(unsigned int n, unsigned int k)
+{
+    if (n == 96 && k == 3) {
+        return Eh96_3.OptimisedSolveMemory();
+    } else if (n == 200 && k == 9) {
+        return Eh200_9.OptimisedSolveMemory();
+    } else if (n == 96 && k == 5) {
+        return Eh96_5.OptimisedSolveMemory();
+    } else if (n == 48 && k == 5) {
+        return Eh48_5.OptimisedSolveMemory();
+    } else {
+        throw std::invalid_argument("Unsupported Equihash parameters");
+    }
+}
+
 inline bool EhOptimisedSolveUncancellable(unsigned int n, unsigned int k, const eh_HashState& base_state,
                     const std::function<bool(std::vector<unsigned char>)> validBlock)
 {
@@ -745,3 +745,18 @@ void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
         --blocks;
     }
 }
+
+void SHA256Compress64(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    while (blocks) {
+        uint32_t s[8];
+        sha256::Initialize(s);
+        Transform(s, in, 1);
+        for (int i = 0; i < 8; i++) {
+            WriteBE32(out + 4 * i, s[i]);
+        }
+        out += 32;
+        in += 64;
+        --blocks;
+    }
+}
@@ -39,4 +39,13 @@ std::string SHA256AutoDetect();
  */
 void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks);
 
+/** Compute the SHA-256 compression function of multiple 64-byte blobs, each
+ *  from the initial state and without padding, as used by the note
+ *  commitment tree.
+ *  output:  pointer to a blocks*32 byte output buffer
+ *  input:   pointer to a blocks*64 byte input buffer
+ *  blocks:  the number of compressions to compute.
+ */
+void SHA256Compress64(unsigned char* output, const unsigned char* input, size_t blocks);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
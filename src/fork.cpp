@@ -3,21 +3,33 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <algorithm>
 #include <ios>
+#include <memory>
 #include <sstream>
 #include <utility>
 
-#include <boost/tuple/tuple.hpp>
-#include <boost/range/combine.hpp>
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
+#include <checkqueue.h>
+#include <crypto/common.h>
+#include <fs.h>
 #include <script/script.h>
 #include <fork.h>
+#include <sync.h>
 #include <util.h>
 #include <validation.h>
 
+#include <boost/thread.hpp>
+
 std::string GetUTXOFileName(int nHeight, const CChainParams& chainparams)
 {
     boost::filesystem::path utxo_path(GetDataDir() / "utxo_snapshot");
@@ -35,20 +47,204 @@ std::string GetUTXOFileName(int nHeight, const CChainParams& chainparams)
     return utxo_file.generic_string();
 }
 
-inline uint64_t bytes2uint64(char* array)
+CForkUTXOFile::CForkUTXOFile(const std::string& path)
+{
+#ifndef WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            pdata = static_cast<const unsigned char*>(addr);
+            nSize = st.st_size;
+            fMapped = true;
+        }
+    }
+    close(fd);
+    if (fMapped) {
+        fOpen = true;
+        return;
+    }
+#endif
+    // Read the whole file in one go if it couldn't be mapped
+    FILE* file = fsbridge::fopen(path, "rb");
+    if (!file) {
+        return;
+    }
+    unsigned char buf[65536];
+    size_t nRead;
+    while ((nRead = fread(buf, 1, sizeof(buf), file)) > 0) {
+        vData.insert(vData.end(), buf, buf + nRead);
+    }
+    fclose(file);
+    pdata = vData.data();
+    nSize = vData.size();
+    fOpen = true;
+}
+
+CForkUTXOFile::~CForkUTXOFile()
+{
+#ifndef WIN32
+    if (fMapped) {
+        munmap(const_cast<unsigned char*>(pdata), nSize);
+    }
+#endif
+}
+
+void CForkUTXOFile::Prefetch() const
+{
+#ifndef WIN32
+    if (fMapped) {
+        madvise(const_cast<unsigned char*>(pdata), nSize, MADV_WILLNEED);
+    }
+#endif
+}
+
+void CForkUTXOFile::BuildIndex(size_t nMaxRecords)
+{
+    vOffsets.clear();
+    vOffsets.reserve(nMaxRecords);
+
+    size_t nPos = 0;
+    while (vOffsets.size() < nMaxRecords) {
+        if (nSize - nPos < 8) {
+            LogPrintf("AcceptBlock(): FORK Block - No more data in the file \n");
+            break;
+        }
+        if (nSize - nPos < 16) {
+            LogPrintf("AcceptBlock(): FORK Block - UTXO file corrupted? - Not more data (PubKeyScript size)\n");
+            break;
+        }
+        uint64_t nScriptSize = ReadLE64(pdata + nPos + 8);
+        if (nScriptSize == 0) {
+            LogPrintf("AcceptBlock(): FORK Block - UTXO file corrupted? - Warning! PubKeyScript size = 0\n");
+            //but proceed
+        }
+        if (nScriptSize > nSize - nPos - 16) {
+            LogPrintf("AcceptBlock(): FORK Block - UTXO file corrupted? - Not more data (PubKeyScript)\n");
+            break;
+        }
+        size_t nNext = nPos + 16 + nScriptSize;
+        if (nNext == nSize) {
+            LogPrintf("AcceptBlock(): FORK Block - UTXO file corrupted? - No more data (record separator)\n");
+            break;
+        }
+        if (pdata[nNext] == '\n') {
+            nNext++;
+        } else {
+            //This maybe not an error, but warning none the less
+            LogPrintf("AcceptBlock(): FORK Block - UTXO file corrupted? - Warning! No record separator ('0xA') was found\n");
+        }
+        vOffsets.push_back(nPos);
+        nPos = nNext;
+    }
+}
+
+bool CForkUTXOFile::MatchesRecord(size_t i, const CTxOut& txout) const
 {
-    uint64_t x =
-        static_cast<uint64_t>(array[0])       & 0x00000000000000ff |
-        static_cast<uint64_t>(array[1]) << 8  & 0x000000000000ff00 |
-        static_cast<uint64_t>(array[2]) << 16 & 0x0000000000ff0000 |
-        static_cast<uint64_t>(array[3]) << 24 & 0x00000000ff000000 |
-        static_cast<uint64_t>(array[4]) << 32 & 0x000000ff00000000 |
-        static_cast<uint64_t>(array[5]) << 40 & 0x0000ff0000000000 |
-        static_cast<uint64_t>(array[6]) << 48 & 0x00ff000000000000 |
-        static_cast<uint64_t>(array[7]) << 56 & 0xff00000000000000;
-    return x;
+    const unsigned char* rec = pdata + vOffsets[i];
+    uint64_t amount = ReadLE64(rec);
+    uint64_t nScriptSize = ReadLE64(rec + 8);
+    return amount == static_cast<uint64_t>(txout.nValue) &&
+           nScriptSize == txout.scriptPubKey.size() &&
+           std::equal(rec + 16, rec + 16 + nScriptSize, txout.scriptPubKey.begin());
 }
 
+bool CForkRecordCheck::operator()()
+{
+    for (size_t i = nBegin; i < nEnd; i++) {
+        if (!pfile->MatchesRecord(i, pblock->vtx[i]->vout[0])) {
+            *pnMismatch = i;
+            break;
+        }
+    }
+    // Every check has to run for the first mismatch to be found, so a
+    // mismatch isn't reported to the queue
+    return true;
+}
+
+//! Number of records compared by a CForkRecordCheck
+static const size_t FORK_RECORDS_PER_CHECK = 100;
+
+size_t FindForkRecordMismatch(const CForkUTXOFile& file, const CBlock& block)
+{
+    const size_t nRecords = file.GetRecordCount();
+    std::vector<size_t> vMismatch((nRecords + FORK_RECORDS_PER_CHECK - 1) / FORK_RECORDS_PER_CHECK, nRecords);
+    std::vector<CForkRecordCheck> vChecks;
+    vChecks.reserve(vMismatch.size());
+    for (size_t j = 0; j < vMismatch.size(); j++) {
+        vChecks.emplace_back(file, block, j * FORK_RECORDS_PER_CHECK,
+                             std::min(nRecords, (j + 1) * FORK_RECORDS_PER_CHECK), vMismatch[j]);
+    }
+
+    if (nScriptCheckThreads > 1 && vChecks.size() > 1) {
+        // Records are only compared while the fork blocks are imported, so
+        // the threads that check them last for a block instead of the
+        // whole run. Once the checks are done they wait for more, which is
+        // where they are interrupted.
+        CCheckQueue<CForkRecordCheck> forkcheckqueue(8);
+        boost::thread_group threadGroup;
+        for (int i = 0; i < nScriptCheckThreads - 1; i++) {
+            threadGroup.create_thread([&forkcheckqueue] {
+                RenameThread("bitcoin-forkcheck");
+                forkcheckqueue.Thread();
+            });
+        }
+        {
+            CCheckQueueControl<CForkRecordCheck> control(&forkcheckqueue);
+            control.Add(vChecks);
+            control.Wait();
+        }
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+    } else {
+        for (CForkRecordCheck& check : vChecks) {
+            check();
+        }
+    }
+
+    return vMismatch.empty() ? nRecords : *std::min_element(vMismatch.begin(), vMismatch.end());
+}
+
+namespace {
+
+Mutex cs_next_utxo_file;
+//! The UTXO file of the next fork block, opened ahead of time
+std::unique_ptr<CForkUTXOFile> g_next_utxo_file GUARDED_BY(cs_next_utxo_file);
+int g_next_utxo_file_height GUARDED_BY(cs_next_utxo_file) = 0;
+
+/**
+ * Open the UTXO file of the fork block at nHeight, reusing the file opened by
+ * the previous call if it was prefetched, and start reading the file of the
+ * following fork block in the background.
+ */
+std::unique_ptr<CForkUTXOFile> OpenUTXOFile(int nHeight, const CChainParams& chainparams)
+{
+    LOCK(cs_next_utxo_file);
+    std::unique_ptr<CForkUTXOFile> file;
+    if (g_next_utxo_file && g_next_utxo_file_height == nHeight) {
+        file = std::move(g_next_utxo_file);
+    } else {
+        file.reset(new CForkUTXOFile(GetUTXOFileName(nHeight, chainparams)));
+    }
+
+    g_next_utxo_file.reset();
+    if (isForkBlock(nHeight + 1, chainparams.ForkStartHeight(), chainparams.ForkHeightRange())) {
+        std::unique_ptr<CForkUTXOFile> next(new CForkUTXOFile(GetUTXOFileName(nHeight + 1, chainparams)));
+        if (next->IsOpen()) {
+            next->Prefetch();
+            g_next_utxo_file = std::move(next);
+            g_next_utxo_file_height = nHeight + 1;
+        }
+    }
+    return file;
+}
+
+} // namespace
+
 bool ContextualCheckBlockFork(const CBlock& block, CValidationState& state,
                               const CChainParams& chainparams, const CBlockIndex* pindexprev)
 {
@@ -65,76 +261,24 @@ bool ContextualCheckBlockFork(const CBlock& block, CValidationState& state,
     if (fExpensiveChecks && isForkBlock(nHeight, chainparams.ForkStartHeight(), chainparams.ForkHeightRange())) {
         // If block is in forking region, validate it against file records
 
-        std::string utxo_file_path = GetUTXOFileName(nHeight, chainparams);
-        std::ifstream if_utxo(utxo_file_path, std::ios::binary | std::ios::in);
-        if (if_utxo.is_open()) {
+        std::unique_ptr<CForkUTXOFile> utxo_file = OpenUTXOFile(nHeight, chainparams);
+        if (utxo_file->IsOpen()) {
             LogPrintf("AcceptBlock(): FORK Block - Validating block - %u / %s  with UTXO file - %s\n",
-                      nHeight, block.GetHash().ToString(), utxo_file_path);
-
-            std::vector<std::pair<uint64_t, CScript>> txFromFile;
-            txFromFile.reserve(FORK_CB_PER_BLOCK);
-            int recs = 0;
-
-            while (if_utxo && recs < FORK_CB_PER_BLOCK) {
-                char term = 0;
-                char coin[8] = {};
-                if (!if_utxo.read(coin, 8)) {
-                    LogPrintf("AcceptBlock(): FORK Block - No more data in the file \n");
-                    break;
-                }
-                uint64_t amount = bytes2uint64(coin);
-
-                char pubkeysize[8] = {};
-                if (!if_utxo.read(pubkeysize, 8)) {
-                    LogPrintf("AcceptBlock(): FORK Block - UTXO file corrupted? - Not more data (PubKeyScript size)\n");
-                    break;
-                }
-                int pbsize = bytes2uint64(pubkeysize);
-                if (pbsize == 0) {
-                    LogPrintf("AcceptBlock(): FORK Block - UTXO file corrupted? - Warning! PubKeyScript size = 0\n");
-                    //but proceed
-                }
-                std::unique_ptr<char[]> pubKeyScript(new char[pbsize]);
-                if (!if_utxo.read(&pubKeyScript[0], pbsize)) {
-                    LogPrintf("AcceptBlock(): FORK Block - UTXO file corrupted? - Not more data (PubKeyScript)\n");
-                    break;
-                }
-                unsigned char* pks = (unsigned char*)pubKeyScript.get();
-                CScript script = CScript(pks, pks+pbsize);
-
-                txFromFile.push_back(std::make_pair(amount, script));
-
-                if (!if_utxo.read(&term, 1)) {
-                    LogPrintf("AcceptBlock(): FORK Block - UTXO file corrupted? - No more data (record separator)\n");
-                    break;
-                }
-                if (term != '\n') {
-                    //This maybe not an error, but warning none the less
-                    LogPrintf("AcceptBlock(): FORK Block - UTXO file corrupted? - Warning! No record separator ('0xA') was found\n");
-                    if_utxo.seekg(-1, std::ios_base::cur); //move one char back - if it is not a separator, maybe there is not separators at all
-                }
-                recs++;
-            }
+                      nHeight, block.GetHash().ToString(), GetUTXOFileName(nHeight, chainparams));
+
+            utxo_file->BuildIndex(FORK_CB_PER_BLOCK);
+            size_t recs = utxo_file->GetRecordCount();
             LogPrintf("AcceptBlock(): FORK Block - %d records read from UTXO file\n", recs);
 
-            if (txFromFile.size() != block.vtx.size() || recs != block.vtx.size()) {
+            if (recs != block.vtx.size()) {
                 return state.DoS(100, error("AcceptBlock(): Number of file records - %d doesn't match number of transcations in block - %d\n", recs, block.vtx.size()), REJECT_INVALID, "bad-fork-block");
             }
 
-            int txid = 0;
-            typedef boost::tuple<std::pair<uint64_t, CScript>&, const CTransaction&> fork_cmp_tuple;
-            for (int i = 0; i < recs; i++) {
-                std::pair<uint64_t, CScript>& rec = txFromFile[i];
-                const CTransaction& tx = *block.vtx[i];
-
-                if (rec.first != tx.vout[0].nValue ||
-                    rec.second != tx.vout[0].scriptPubKey)
-                {
-                    LogPrintf("AcceptBlock(): FORK Block - Error: Transaction (%d) mismatch\n", txid);
-                    return state.DoS(100, error("AcceptBlock(): FORK Block - Transaction (%d) doesn't match record in the UTXO file", txid), REJECT_INVALID, "bad-fork-block");
-                }
+            size_t txid = FindForkRecordMismatch(*utxo_file, block);
+            if (txid != recs) {
+                LogPrintf("AcceptBlock(): FORK Block - Error: Transaction (%d) mismatch\n", txid);
+                return state.DoS(100, error("AcceptBlock(): FORK Block - Transaction (%d) doesn't match record in the UTXO file", txid), REJECT_INVALID, "bad-fork-block");
             }
-            txid++;
         }
     }
 
@@ -8,6 +8,12 @@
 #include <consensus/validation.h>
 #include <primitives/block.h>
 
+#include <string>
+#include <vector>
+
+class CBlockIndex;
+class CChainParams;
+
 static const uint256 forkExtraHashSentinel = uint256S("f0f0f0f0fafafafaffffffffffffffffffffffffffffffffafafafaf0f0f0f0f");
 static constexpr unsigned int FORK_CB_PER_BLOCK = 10000;
 
@@ -31,4 +37,85 @@ bool ContextualCheckBlockFork(const CBlock& block, CValidationState& state,
 
 std::string GetUTXOFileName(int);
 
+/**
+ * Read-only view of a fork UTXO snapshot file. The file is memory mapped
+ * where possible and its records are found through an offset index, so
+ * they are never copied.
+ *
+ * Each record is an 8-byte little-endian amount, an 8-byte little-endian
+ * scriptPubKey size, the scriptPubKey and a '\n' separator, which may be
+ * missing.
+ */
+class CForkUTXOFile
+{
+private:
+    bool fOpen = false;
+    bool fMapped = false;
+    const unsigned char* pdata = nullptr;
+    size_t nSize = 0;
+    //! Contents of the file when it couldn't be mapped
+    std::vector<unsigned char> vData;
+    //! Offset of each record in the file
+    std::vector<size_t> vOffsets;
+
+public:
+    explicit CForkUTXOFile(const std::string& path);
+    ~CForkUTXOFile();
+
+    CForkUTXOFile(const CForkUTXOFile&) = delete;
+    CForkUTXOFile& operator=(const CForkUTXOFile&) = delete;
+
+    bool IsOpen() const { return fOpen; }
+
+    /** Ask the OS to start reading the file in the background. */
+    void Prefetch() const;
+
+    /** Index the records of the file, up to nMaxRecords of them. */
+    void BuildIndex(size_t nMaxRecords);
+
+    size_t GetRecordCount() const { return vOffsets.size(); }
+
+    /** Whether record i has the amount and scriptPubKey of txout. */
+    bool MatchesRecord(size_t i, const CTxOut& txout) const;
+};
+
+/**
+ * Closure comparing the first output of the transactions nBegin to nEnd of a
+ * fork block with their records, which sets *pnMismatch to the first one
+ * that doesn't match.
+ */
+class CForkRecordCheck
+{
+private:
+    const CForkUTXOFile* pfile;
+    const CBlock* pblock;
+    size_t nBegin;
+    size_t nEnd;
+    size_t* pnMismatch;
+
+public:
+    CForkRecordCheck(): pfile(nullptr), pblock(nullptr), nBegin(0), nEnd(0), pnMismatch(nullptr) {}
+    CForkRecordCheck(const CForkUTXOFile& fileIn, const CBlock& blockIn, size_t nBeginIn, size_t nEndIn, size_t& nMismatchIn) :
+        pfile(&fileIn), pblock(&blockIn), nBegin(nBeginIn), nEnd(nEndIn), pnMismatch(&nMismatchIn) { }
+
+    bool operator()();
+
+    void swap(CForkRecordCheck &check) {
+        std::swap(pfile, check.pfile);
+        std::swap(pblock, check.pblock);
+        std::swap(nBegin, check.nBegin);
+        std::swap(nEnd, check.nEnd);
+        std::swap(pnMismatch, check.pnMismatch);
+    }
+};
+
+/**
+ * Compare the first output of each transaction of block with its record in
+ * file, on as many threads as verify scripts. block must have a transaction
+ * per record.
+ * Returns the index of the first mismatching transaction, or the number of
+ * records if they all match.
+ */
+size_t FindForkRecordMismatch(const CForkUTXOFile& file, const CBlock& block);
+
 #endif // BITCOIN_FORK_H
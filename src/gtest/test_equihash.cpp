@@ -83,10 +83,10 @@ TEST(equihash_tests, is_probably_duplicate) {
 #ifdef ENABLE_MINING
 TEST(equihash_tests, check_basic_solver_cancelled) {
     Equihash<48,5> Eh48_5;
-    crypto_generichash_blake2b_state state;
+    eh_HashState state;
     Eh48_5.InitialiseState(state);
     uint256 V = uint256S("0x00");
-    crypto_generichash_blake2b_update(&state, V.begin(), V.size());
+    state.Update(V.begin(), V.size());
 
     {
         ASSERT_NO_THROW(Eh48_5.BasicSolve(state, [](std::vector<unsigned char> soln) {
@@ -187,10 +187,10 @@ TEST(equihash_tests, check_basic_solver_cancelled) {
 
 TEST(equihash_tests, check_optimised_solver_cancelled) {
     Equihash<48,5> Eh48_5;
-    crypto_generichash_blake2b_state state;
+    eh_HashState state;
     Eh48_5.InitialiseState(state);
     uint256 V = uint256S("0x00");
-    crypto_generichash_blake2b_update(&state, V.begin(), V.size());
+    state.Update(V.begin(), V.size());
 
     {
         ASSERT_NO_THROW(Eh48_5.OptimisedSolve(state, [](std::vector<unsigned char> soln) {
@@ -15,6 +15,8 @@
 #include <chainparams.h>
 #include <checkpoints.h>
 #include <compat/sanity.h>
+#include <crypto/blake2b.h>
+#include <consensus/joinsplit.h>
 #include <consensus/validation.h>
 #include <fs.h>
 #include <httpserver.h>
@@ -72,6 +74,7 @@ bool fFeeEstimatesInitialized = false;
 static const bool DEFAULT_PROXYRANDOMIZE = true;
 static const bool DEFAULT_REST_ENABLE = false;
 static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
+static const bool DEFAULT_PRELOAD_PROVING_KEY = false;
 
 std::unique_ptr<CConnman> g_connman;
 std::unique_ptr<PeerLogicValidation> peerLogic;
@@ -239,6 +242,7 @@ void Shutdown()
         }
         pcoinsTip.reset();
         pcoinscatcher.reset();
+        pcoinsflush.reset();
         pcoinsdbview.reset();
         pblocktree.reset();
     }
@@ -346,6 +350,7 @@ void SetupServerArgs()
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbcache=<n>", strprintf("Set database cache size in megabytes (%d to %d, default: %d)", nMinDbCache, nMaxDbCache, nDefaultDbCache), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbcacheevict", strprintf("Keep the in-memory UTXO set across database writes, evicting unmodified, least recently used coins to stay within -dbcache (default: %u)", DEFAULT_DBCACHE_EVICT), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (-nodebuglogfile to disable; default: %s)", DEFAULT_DEBUGLOGFILE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", false, OptionsCategory::OPTIONS);
@@ -362,6 +367,9 @@ void SetupServerArgs()
 #else
     hidden_args.emplace_back("-pid");
 #endif
+    gArgs.AddArg("-prefetchthreads=<n>", strprintf("Set the number of threads reading the coins of a new block into the cache ahead of connecting it (0 to disable, max: %d, default: %d)",
+        MAX_PREFETCH_THREADS, DEFAULT_PREFETCH_THREADS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-preloadprovingkey", strprintf("Load the JoinSplit proving key into memory at startup and share it between proofs, instead of reading it for each proof (default: %u)", DEFAULT_PRELOAD_PROVING_KEY), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >=%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), false, OptionsCategory::OPTIONS);
@@ -459,6 +467,7 @@ void SetupServerArgs()
     gArgs.AddArg("-logtimestamps", strprintf("Prepend debug output with timestamp (default: %u)", DEFAULT_LOGTIMESTAMPS), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)", true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-maxjoinsplitcachesize=<n>", strprintf("Limit size of the JoinSplit proof cache to <n> MiB (default: %u)", DEFAULT_MAX_JOINSPLIT_CACHE_SIZE), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxtxfee=<amt>", strprintf("Maximum total fees (in %s) to use in a single wallet transaction or raw transaction; setting this too low may abort large transactions (default: %s)",
@@ -486,6 +495,7 @@ void SetupServerArgs()
     gArgs.AddArg("-blockmaxweight=<n>", strprintf("Set maximum BIP141 block weight (default: %d)", DEFAULT_BLOCK_MAX_WEIGHT), false, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-blockmintxfee=<amt>", strprintf("Set lowest fee rate (in %s/kB) for transactions to be included in block creation. (default: %s)", CURRENCY_UNIT, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE)), false, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-blockversion=<n>", "Override block version to test forking scenarios", true, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-genproclimit=<n>", strprintf("Set the number of threads the generate RPCs use to solve Equihash, as many as fit in %u MiB (0 = one per core, default: %d)", MAX_GENERATE_SOLVER_MEMORY, DEFAULT_GENERATE_THREADS), false, OptionsCategory::BLOCK_CREATION);
 
     gArgs.AddArg("-rest", strprintf("Accept public REST requests (default: %u)", DEFAULT_REST_ENABLE), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcallowip=<ip>", "Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times", false, OptionsCategory::RPC);
@@ -718,6 +728,24 @@ static void ZC_LoadParams()
     gettimeofday(&tv_end, 0);
     elapsed = float(tv_end.tv_sec-tv_start.tv_sec) + (tv_end.tv_usec-tv_start.tv_usec)/float(1000000);
     LogPrintf("Loaded verifying key in %fs seconds.\n", elapsed);
+
+    if (gArgs.GetBoolArg("-preloadprovingkey", DEFAULT_PRELOAD_PROVING_KEY)) {
+        LogPrintf("Loading proving key from %s\n", pk_path.string().c_str());
+        gettimeofday(&tv_start, 0);
+
+        try {
+            pzcashParams->loadProvingKey();
+        } catch (const std::exception& e) {
+            uiInterface.ThreadSafeMessageBox(strprintf(_("Error loading the proving key: %s"), e.what()),
+                "", CClientUIInterface::MSG_ERROR);
+            StartShutdown();
+            return;
+        }
+
+        gettimeofday(&tv_end, 0);
+        elapsed = float(tv_end.tv_sec-tv_start.tv_sec) + (tv_end.tv_usec-tv_start.tv_usec)/float(1000000);
+        LogPrintf("Loaded proving key in %fs seconds.\n", elapsed);
+    }
 }
 
 /** Sanity checks
@@ -1052,6 +1080,9 @@ bool AppInitParameterInteraction()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    // -prefetchthreads=0 disables prefetching
+    nPrefetchThreads = std::max(0, std::min((int)gArgs.GetArg("-prefetchthreads", DEFAULT_PREFETCH_THREADS), MAX_PREFETCH_THREADS));
+
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = gArgs.GetArg("-prune", 0);
     if (nPruneArg < 0) {
@@ -1163,6 +1194,8 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string blake2b_algo = Blake2bAutoDetect();
+    LogPrintf("Using the '%s' BLAKE2b implementation\n", blake2b_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1238,13 +1271,26 @@ bool AppInitMain()
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitJoinSplitCache();
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        // A block's JoinSplit proofs are checked while its scripts are, so
+        // rather than as many threads again they get about half as many
+        for (int i=0; i<nScriptCheckThreads/2; i++)
+            threadGroup.create_thread(&ThreadJoinSplitCheck);
+        // Header solutions are only checked while headers are downloaded,
+        // and a round of them is short, so they make do with as many
+        for (int i=0; i<nScriptCheckThreads/2; i++)
+            threadGroup.create_thread(&ThreadHeaderCheck);
     }
 
+    LogPrintf("Using %u threads for coins prefetching\n", nPrefetchThreads);
+    for (int i=0; i<nPrefetchThreads-1; i++)
+        threadGroup.create_thread(&ThreadPrefetch);
+
     // These must be disabled for now, they are buggy and we probably don't
     // want any of libsnark's profiling in production anyway.
     libsnark::inhibit_profiling_info = true;
@@ -1414,6 +1460,7 @@ bool AppInitMain()
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
+    fCoinCacheEvict = gArgs.GetBoolArg("-dbcacheevict", DEFAULT_DBCACHE_EVICT);
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
@@ -1437,8 +1484,9 @@ bool AppInitMain()
             try {
                 UnloadBlockIndex();
                 pcoinsTip.reset();
-                pcoinsdbview.reset();
                 pcoinscatcher.reset();
+                pcoinsflush.reset();
+                pcoinsdbview.reset();
                 // new CBlockTreeDB tries to delete the existing file, which
                 // fails if it's still open from the previous loop. Close it first:
                 pblocktree.reset();
@@ -1488,7 +1536,15 @@ bool AppInitMain()
                 // block tree into mapBlockIndex!
 
                 pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState));
-                pcoinscatcher.reset(new CCoinsViewErrorCatcher(pcoinsdbview.get()));
+                pcoinsflush.reset(new CCoinsViewBackgroundFlush(pcoinsdbview.get()));
+                pcoinscatcher.reset(new CCoinsViewErrorCatcher(pcoinsflush.get()));
+
+                // Refuse a database in another format than the one we write.
+                // This always passes if we cleared the coinsviewdb with -reindex or -reindex-chainstate
+                if (!pcoinsdbview->CheckVersion()) {
+                    strLoadError = _("The chainstate database is in an incompatible format. You will need to rebuild the database using -reindex-chainstate.");
+                    break;
+                }
 
                 // If necessary, upgrade from older database format.
                 // This is a no-op if we cleared the coinsviewdb with -reindex or -reindex-chainstate
@@ -1543,7 +1599,7 @@ bool AppInitMain()
                         break;
                     }
 
-                    if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview.get(), gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL),
+                    if (!CVerifyDB().VerifyDB(chainparams, pcoinsflush.get(), gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL),
                                   gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
                         strLoadError = _("Corrupted block database detected");
                         break;
@@ -6,6 +6,8 @@
 #define BITCOIN_MEMUSAGE_H
 
 #include <indirectmap.h>
+#include <pooledmap.h>
+#include <prevector.h>
 
 #include <stdlib.h>
 
@@ -165,6 +167,30 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+// pooled_hash_map allocates its entries by the chunk, so count the chunks
+// whether or not they are full
+
+template<typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const pooled_hash_map<X, Y, Z>& m)
+{
+    return MallocUsage(pooled_hash_map<X, Y, Z>::chunk_bytes()) * m.allocated_chunks() +
+           MallocUsage(sizeof(void*) * m.chunk_count()) +
+           MallocUsage(pooled_hash_map<X, Y, Z>::bucket_bytes() * m.bucket_count());
+}
+
+// The usage of a pooled_hash_map once shrink_to_fit() has released what its
+// entries don't need
+
+template<typename X, typename Y, typename Z>
+static inline size_t ShrunkDynamicUsage(const pooled_hash_map<X, Y, Z>& m)
+{
+    typedef pooled_hash_map<X, Y, Z> map_type;
+    const size_t chunks = map_type::chunks_for(m.size());
+    return MallocUsage(map_type::chunk_bytes()) * chunks +
+           MallocUsage(sizeof(void*) * chunks) +
+           MallocUsage(map_type::bucket_bytes() * map_type::table_size_for(m.size()));
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
@@ -23,6 +23,10 @@ class CScript;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Default for -genproclimit, the number of Equihash solver threads of the generate RPCs (0 = one per core) */
+static const int DEFAULT_GENERATE_THREADS = 1;
+/** Memory the Equihash solver threads of the generate RPCs may use together, in MiB */
+static const uint64_t MAX_GENERATE_SOLVER_MEMORY = 4096;
 
 struct CBlockTemplate
 {
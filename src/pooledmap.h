@@ -0,0 +1,382 @@
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_POOLEDMAP_H
+#define BITCOIN_POOLEDMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* Unordered map with open addressing, for maps of many small entries such as
+ * the coins cache.
+ *
+ * The table holds 8 bytes per slot: 32 bits of the key's hash, and the index
+ * of the entry. The entries themselves are kept in fixed-size chunks, with
+ * erased ones reused before new chunks are allocated, so that an insertion
+ * rarely allocates and there is no per-entry allocation overhead. Iterating
+ * walks the table rather than chasing list nodes.
+ *
+ * As with std::unordered_map, references to entries stay valid until they
+ * are erased, and iterators until the table is rehashed by an insertion.
+ * Erasing leaves a tombstone in the table, so erasing while iterating is
+ * fine.
+ */
+template <class K, class T, class Hash>
+class pooled_hash_map {
+public:
+    typedef K key_type;
+    typedef T mapped_type;
+    typedef std::pair<const K, T> value_type;
+    typedef size_t size_type;
+
+    /** Number of entries allocated at a time */
+    static const uint32_t CHUNK_SIZE = 64;
+
+private:
+    struct slot {
+        uint32_t hash;
+        uint32_t index; // EMPTY, DELETED, or FIRST plus the entry index
+    };
+    static const uint32_t EMPTY = 0;
+    static const uint32_t DELETED = 1;
+    static const uint32_t FIRST = 2;
+    static const uint32_t NO_FREE = UINT32_MAX;
+
+    union node {
+        value_type value;
+        uint32_t next_free;
+        node() {}
+        ~node() {}
+    };
+
+    std::vector<slot> slots;
+    std::vector<std::unique_ptr<node[]>> chunks;
+    uint32_t nodes_used;
+    uint32_t free_head;
+    size_t entries;
+    size_t deleted;
+    Hash hasher;
+
+    node& get_node(uint32_t index) const {
+        const uint32_t n = index - FIRST;
+        return chunks[n / CHUNK_SIZE][n % CHUNK_SIZE];
+    }
+
+    uint32_t new_node() {
+        uint32_t n;
+        if (free_head != NO_FREE) {
+            n = free_head;
+            free_head = get_node(n + FIRST).next_free;
+        } else {
+            if (nodes_used == chunks.size() * CHUNK_SIZE) {
+                chunks.emplace_back(new node[CHUNK_SIZE]);
+            }
+            n = nodes_used++;
+        }
+        return n + FIRST;
+    }
+
+    void free_node(uint32_t index) {
+        node& n = get_node(index);
+        n.value.~value_type();
+        n.next_free = free_head;
+        free_head = index - FIRST;
+    }
+
+    /* Look key up. Returns its slot, or slots.size() if it is absent, in
+     * which case *insert_pos is set to where it would go. */
+    size_t probe(const K& key, uint32_t hash, size_t* insert_pos) const {
+        const size_t mask = slots.size() - 1;
+        size_t pos = hash & mask;
+        size_t first_deleted = slots.size();
+        for (size_t step = 1; ; step++) {
+            const slot& s = slots[pos];
+            if (s.index == EMPTY) {
+                if (insert_pos) *insert_pos = first_deleted < slots.size() ? first_deleted : pos;
+                return slots.size();
+            }
+            if (s.index == DELETED) {
+                if (first_deleted == slots.size()) first_deleted = pos;
+            } else if (s.hash == hash && get_node(s.index).value.first == key) {
+                return pos;
+            }
+            // Triangular numbers visit every slot of a power of two table
+            pos = (pos + step) & mask;
+        }
+    }
+
+    /* Place a slot of a new entry in a table without tombstones. */
+    static void place(std::vector<slot>& table, const slot& s) {
+        const size_t mask = table.size() - 1;
+        size_t pos = s.hash & mask;
+        for (size_t step = 1; table[pos].index != EMPTY; step++) {
+            pos = (pos + step) & mask;
+        }
+        table[pos] = s;
+    }
+
+    void rehash(size_t new_size) {
+        std::vector<slot> old(new_size, slot{0, EMPTY});
+        old.swap(slots);
+        for (const slot& s : old) {
+            if (s.index >= FIRST) place(slots, s);
+        }
+        deleted = 0;
+    }
+
+    /* Make room for one more entry, keeping at least a quarter of the
+     * slots empty so that probes stay short and end. */
+    void grow() {
+        if ((entries + deleted + 1) * 4 <= slots.size() * 3) return;
+        size_t new_size = slots.empty() ? 16 : slots.size();
+        while ((entries + 1) * 8 > new_size * 3) {
+            new_size *= 2;
+        }
+        rehash(new_size);
+    }
+
+    template <bool Const>
+    class iterator_base {
+    private:
+        friend class pooled_hash_map;
+        template <bool> friend class iterator_base;
+        typedef typename std::conditional<Const, const pooled_hash_map, pooled_hash_map>::type map_type;
+        map_type* map;
+        size_t pos;
+
+        iterator_base(map_type* mapIn, size_t posIn) : map(mapIn), pos(posIn) {}
+        void skip() {
+            while (pos < map->slots.size() && map->slots[pos].index < FIRST) pos++;
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename pooled_hash_map::value_type value_type;
+        typedef ptrdiff_t difference_type;
+        typedef typename std::conditional<Const, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<Const, const value_type&, value_type&>::type reference;
+
+        iterator_base() : map(nullptr), pos(0) {}
+        template <bool OtherConst, typename = typename std::enable_if<Const || !OtherConst>::type>
+        iterator_base(const iterator_base<OtherConst>& other) : map(other.map), pos(other.pos) {}
+
+        reference operator*() const { return map->get_node(map->slots[pos].index).value; }
+        pointer operator->() const { return &**this; }
+        iterator_base& operator++() { pos++; skip(); return *this; }
+        iterator_base operator++(int) { iterator_base copy(*this); ++*this; return copy; }
+        template <bool OtherConst>
+        bool operator==(const iterator_base<OtherConst>& other) const { return pos == other.pos; }
+        template <bool OtherConst>
+        bool operator!=(const iterator_base<OtherConst>& other) const { return pos != other.pos; }
+    };
+
+public:
+    typedef iterator_base<false> iterator;
+    typedef iterator_base<true> const_iterator;
+
+    pooled_hash_map() : nodes_used(0), free_head(NO_FREE), entries(0), deleted(0) {}
+    ~pooled_hash_map() { clear(); }
+
+    pooled_hash_map(pooled_hash_map&& other)
+        : slots(std::move(other.slots)), chunks(std::move(other.chunks)), nodes_used(other.nodes_used),
+          free_head(other.free_head), entries(other.entries), deleted(other.deleted), hasher(other.hasher)
+    {
+        other.slots.clear();
+        other.chunks.clear();
+        other.nodes_used = 0;
+        other.free_head = NO_FREE;
+        other.entries = 0;
+        other.deleted = 0;
+    }
+    pooled_hash_map& operator=(pooled_hash_map&& other) { swap(other); return *this; }
+    pooled_hash_map(const pooled_hash_map&) = delete;
+    pooled_hash_map& operator=(const pooled_hash_map&) = delete;
+
+    void swap(pooled_hash_map& other) {
+        slots.swap(other.slots);
+        chunks.swap(other.chunks);
+        std::swap(nodes_used, other.nodes_used);
+        std::swap(free_head, other.free_head);
+        std::swap(entries, other.entries);
+        std::swap(deleted, other.deleted);
+        std::swap(hasher, other.hasher);
+    }
+
+    iterator begin()                { iterator it(this, 0); it.skip(); return it; }
+    iterator end()                  { return iterator(this, slots.size()); }
+    const_iterator begin() const    { const_iterator it(this, 0); it.skip(); return it; }
+    const_iterator end() const      { return const_iterator(this, slots.size()); }
+    const_iterator cbegin() const   { return begin(); }
+    const_iterator cend() const     { return end(); }
+
+    /* The first entry from bucket n on, and the bucket of an entry, to
+     * walk the table from where an earlier walk stopped. */
+    iterator from_bucket(size_t n)  { iterator it(this, std::min(n, slots.size())); it.skip(); return it; }
+    size_t bucket_of(const_iterator it) const { return it.pos; }
+
+    bool empty() const              { return entries == 0; }
+    size_type size() const          { return entries; }
+
+    iterator find(const K& key) {
+        if (entries == 0) return end();
+        return iterator(this, probe(key, hasher(key), nullptr));
+    }
+    const_iterator find(const K& key) const {
+        if (entries == 0) return end();
+        return const_iterator(this, probe(key, hasher(key), nullptr));
+    }
+    size_type count(const K& key) const { return find(key) != end(); }
+
+    T& at(const K& key) {
+        iterator it = find(key);
+        if (it == end()) throw std::out_of_range("pooled_hash_map::at");
+        return it->second;
+    }
+    const T& at(const K& key) const {
+        const_iterator it = find(key);
+        if (it == end()) throw std::out_of_range("pooled_hash_map::at");
+        return it->second;
+    }
+
+    /* Constructs the entry first, like std::unordered_map, and drops it if
+     * its key is already present. */
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        const uint32_t index = new_node();
+        node& n = get_node(index);
+        try {
+            new (&n.value) value_type(std::forward<Args>(args)...);
+        } catch (...) {
+            n.next_free = free_head;
+            free_head = index - FIRST;
+            throw;
+        }
+        const uint32_t hash = hasher(n.value.first);
+        size_t insert_pos = 0;
+        if (!slots.empty()) {
+            const size_t pos = probe(n.value.first, hash, &insert_pos);
+            if (pos < slots.size()) {
+                free_node(index);
+                return std::make_pair(iterator(this, pos), false);
+            }
+        }
+        if ((entries + deleted + 1) * 4 > slots.size() * 3) {
+            grow();
+            probe(n.value.first, hash, &insert_pos);
+        }
+        if (slots[insert_pos].index == DELETED) deleted--;
+        slots[insert_pos] = slot{hash, index};
+        entries++;
+        return std::make_pair(iterator(this, insert_pos), true);
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) { return emplace(value); }
+
+    T& operator[](const K& key) {
+        iterator it = find(key);
+        if (it != end()) return it->second;
+        return emplace(std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>()).first->second;
+    }
+
+    /* Returns the iterator following the erased entry. */
+    iterator erase(const_iterator it) {
+        slot& s = slots[it.pos];
+        free_node(s.index);
+        s.index = DELETED;
+        entries--;
+        deleted++;
+        iterator next(this, it.pos);
+        ++next;
+        return next;
+    }
+    iterator erase(iterator it) { return erase(const_iterator(it)); }
+    size_type erase(const K& key) {
+        iterator it = find(key);
+        if (it == end()) return 0;
+        erase(it);
+        return 1;
+    }
+
+    /* Destroys every entry and releases the memory. */
+    void clear() {
+        for (const slot& s : slots) {
+            if (s.index >= FIRST) get_node(s.index).value.~value_type();
+        }
+        std::vector<slot>().swap(slots);
+        std::vector<std::unique_ptr<node[]>>().swap(chunks);
+        nodes_used = 0;
+        free_head = NO_FREE;
+        entries = 0;
+        deleted = 0;
+    }
+
+    /* Erased entries are only reused, never freed, so after erasing many
+     * this moves the others into as few chunks as they need and the table
+     * down to the size it would have for them, releasing the rest. Unlike
+     * any other operation but clear(), this invalidates references. */
+    void shrink_to_fit() {
+        const size_t n_chunks = chunks_for(entries);
+        const size_t n_slots = table_size_for(entries);
+        if (chunks.size() == n_chunks && chunks.capacity() == n_chunks && slots.capacity() == n_slots && deleted == 0) {
+            return;
+        }
+        if (entries == 0) {
+            clear();
+            return;
+        }
+
+        // Allocate first, so that nothing has moved if that fails
+        std::vector<slot> new_slots(n_slots, slot{0, EMPTY});
+        std::vector<std::unique_ptr<node[]>> new_chunks;
+        new_chunks.reserve(n_chunks);
+        for (size_t i = 0; i < n_chunks; i++) {
+            new_chunks.emplace_back(new node[CHUNK_SIZE]);
+        }
+
+        uint32_t used = 0;
+        for (const slot& s : slots) {
+            if (s.index < FIRST) continue;
+            node& from = get_node(s.index);
+            node& to = new_chunks[used / CHUNK_SIZE][used % CHUNK_SIZE];
+            new (&to.value) value_type(std::move(from.value));
+            from.value.~value_type();
+            place(new_slots, slot{s.hash, used + FIRST});
+            used++;
+        }
+        slots.swap(new_slots);
+        chunks.swap(new_chunks);
+        nodes_used = used;
+        free_head = NO_FREE;
+        deleted = 0;
+    }
+
+    /* The number of chunks, and of slots, that shrink_to_fit() leaves for
+     * n entries. */
+    static size_t chunks_for(size_t n) { return (n + CHUNK_SIZE - 1) / CHUNK_SIZE; }
+    static size_t table_size_for(size_t n) {
+        if (n == 0) return 0;
+        size_t size = 16;
+        while (n * 8 > size * 3) size *= 2;
+        return size;
+    }
+
+    // Memory layout, for memusage::DynamicUsage
+    size_t bucket_count() const { return slots.capacity(); }
+    size_t chunk_count() const { return chunks.capacity(); }
+    size_t allocated_chunks() const { return chunks.size(); }
+    static size_t bucket_bytes() { return sizeof(slot); }
+    static size_t chunk_bytes() { return sizeof(node) * CHUNK_SIZE; }
+};
+
+#endif // BITCOIN_POOLEDMAP_H
@@ -16,8 +16,6 @@
 #include <util.h>
 #include <validation.h>
 
-#include <sodium.h>
-
 #ifdef ENABLE_RUST
 #include <librustzcash.h>
 #endif // ENABLE_RUST
@@ -140,7 +138,7 @@ bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams& param
     unsigned int k = params.EquihashK();
 
     // Hash state
-    crypto_generichash_blake2b_state state;
+    eh_HashState state;
     EhInitialiseState(n, k, state);
 
     // I = the block header minus nonce and solution.
@@ -151,7 +149,7 @@ bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams& param
     ss << pblock->nNonce;
 
     // H(I||V||...
-    crypto_generichash_blake2b_update(&state, (unsigned char*)&ss[0], ss.size());
+    state.Update((unsigned char*)&ss[0], ss.size());
 
 #ifdef ENABLE_RUST
     // Ensure that our Rust interactions are working in production builds. This is
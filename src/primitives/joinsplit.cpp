@@ -18,7 +18,8 @@ JSDescription::JSDescription(ZCJoinSplit& params,
                              CAmount vpub_old,
                              CAmount vpub_new,
                              bool computeProof,
-                             uint256 *esk // payment disclosure
+                             uint256 *esk, // payment disclosure
+                             ZCJoinSplit::ProofWitness *witness
     ) : vpub_old(vpub_old), vpub_new(vpub_new), anchor(anchor)
 {
     std::array<libzcash::Note, ZC_NUM_JS_OUTPUTS> notes;
@@ -38,7 +39,8 @@ JSDescription::JSDescription(ZCJoinSplit& params,
         vpub_new,
         anchor,
         computeProof,
-        esk // payment disclosure
+        esk, // payment disclosure
+        witness
         );
 }
 
@@ -54,7 +56,8 @@ JSDescription JSDescription::Randomized(
     CAmount vpub_new,
     bool computeProof,
     uint256 *esk, // payment disclosure
-    std::function<int(int)> gen
+    std::function<int(int)> gen,
+    ZCJoinSplit::ProofWitness *witness
     )
 {
     // Randomize the order of the inputs and outputs
@@ -69,7 +72,8 @@ JSDescription JSDescription::Randomized(
     return JSDescription(
         params, pubKeyHash, anchor, inputs, outputs,
         vpub_old, vpub_new, computeProof,
-        esk // payment disclosure
+        esk, // payment disclosure
+        witness
         );
 }
 
@@ -79,7 +79,8 @@ public:
                   CAmount vpub_old,
                   CAmount vpub_new,
                   bool computeProof = true, // Set to false in some tests
-                  uint256 *esk = nullptr // payment disclosure
+                  uint256 *esk = nullptr, // payment disclosure
+                  ZCJoinSplit::ProofWitness *witness = nullptr // to prove later
         );
 
     static JSDescription Randomized(
@@ -94,7 +95,8 @@ public:
         CAmount vpub_new,
         bool computeProof = true, // Set to false in some tests
         uint256 *esk = nullptr, // payment disclosure
-        std::function<int(int)> gen = GetRandInt
+        std::function<int(int)> gen = GetRandInt,
+        ZCJoinSplit::ProofWitness *witness = nullptr // to prove later
         );
 
     // Verifies that the JoinSplit proof is correct.
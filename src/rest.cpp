@@ -151,8 +151,11 @@ static bool rest_headers(HTTPRequest* req,
     switch (rf) {
     case RetFormat::BINARY: {
         CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
-        for (const CBlockIndex *pindex : headers) {
-            ssHeader << pindex->GetBlockHeader();
+        {
+            LOCK(cs_main);
+            for (const CBlockIndex *pindex : headers) {
+                ssHeader << pindex->GetBlockHeader();
+            }
         }
 
         std::string binaryHeader = ssHeader.str();
@@ -163,8 +166,11 @@ static bool rest_headers(HTTPRequest* req,
 
     case RetFormat::HEX: {
         CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
-        for (const CBlockIndex *pindex : headers) {
-            ssHeader << pindex->GetBlockHeader();
+        {
+            LOCK(cs_main);
+            for (const CBlockIndex *pindex : headers) {
+                ssHeader << pindex->GetBlockHeader();
+            }
         }
 
         std::string strHex = HexStr(ssHeader.begin(), ssHeader.end()) + "\n";
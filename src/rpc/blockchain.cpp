@@ -71,8 +71,8 @@ double GetDifficultyINTERNAL(const CBlockIndex* blockindex, bool networkDifficul
     }
 
     uint32_t bits;
-    auto tipblock = chainActive.Tip()->GetBlockHeader();
     if (networkDifficulty) {
+        auto tipblock = chainActive.Tip()->GetBlockHeader();
         bits = GetNextWorkRequired(blockindex, &tipblock, Params());
     } else {
         bits = blockindex->nBits;
@@ -1044,6 +1044,44 @@ static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
     return ret;
 }
 
+static UniValue getcoinscacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getcoinscacheinfo\n"
+            "\nReturns details on the in-memory cache of the unspent transaction output set.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"evict\": true|false,        (boolean) Whether the cache is kept across database writes (-dbcacheevict)\n"
+            "  \"usage\": xxxxx,              (numeric) Current memory usage of the cache\n"
+            "  \"maxusage\": xxxxx,           (numeric) Memory usage the cache is allowed, before the mempool's unused share\n"
+            "  \"coins\": xxxxx,              (numeric) Number of coins in the cache\n"
+            "  \"hits\": xxxxx,               (numeric) Number of coin lookups answered by the cache\n"
+            "  \"misses\": xxxxx,             (numeric) Number of coin lookups that went to the database\n"
+            "  \"evicted\": xxxxx,            (numeric) Number of unmodified coins evicted to stay within the limit\n"
+            "  \"syncs\": xxxxx,              (numeric) Number of writes that kept the cache\n"
+            "  \"flushes\": xxxxx             (numeric) Number of writes that emptied the cache\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getcoinscacheinfo", "")
+            + HelpExampleRpc("getcoinscacheinfo", "")
+        );
+
+    LOCK(cs_main);
+    const CCoinsCacheCounters& counters = pcoinsTip->GetCounters();
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("evict", fCoinCacheEvict);
+    ret.pushKV("usage", (int64_t) pcoinsTip->DynamicMemoryUsage());
+    ret.pushKV("maxusage", (int64_t) nCoinCacheUsage);
+    ret.pushKV("coins", (int64_t) pcoinsTip->GetCacheSize());
+    ret.pushKV("hits", (int64_t) counters.nHits);
+    ret.pushKV("misses", (int64_t) counters.nMisses);
+    ret.pushKV("evicted", (int64_t) counters.nEvicted);
+    ret.pushKV("syncs", (int64_t) counters.nSyncs);
+    ret.pushKV("flushes", (int64_t) counters.nFlushes);
+    return ret;
+}
+
 UniValue gettxout(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
@@ -2231,6 +2269,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getblockhash",           &getblockhash,           {"height"} },
     { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"} },
     { "blockchain",         "getchaintips",           &getchaintips,           {} },
+    { "blockchain",         "getcoinscacheinfo",      &getcoinscacheinfo,      {} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          {} },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    {"txid","verbose"} },
     { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  {"txid","verbose"} },
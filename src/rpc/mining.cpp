@@ -28,8 +28,10 @@
 #include <versionbitsinfo.h>
 #include <warnings.h>
 
+#include <atomic>
 #include <memory>
 #include <stdint.h>
+#include <thread>
 
 unsigned int ParseConfirmTarget(const UniValue& value)
 {
@@ -105,6 +107,136 @@ static UniValue getnetworkhashps(const JSONRPCRequest& request)
     return GetNetworkHashPS(!request.params[0].isNull() ? request.params[0].get_int() : 120, !request.params[1].isNull() ? request.params[1].get_int() : -1);
 }
 
+/**
+ * Search for an Equihash solution that makes pblock meet its target, trying
+ * the nonces after pblock->nNonce up to nInnerLoopCount on nThreads threads.
+ * The threads claim their nonces from a shared counter, so that no nonce is
+ * solved twice, and give up as soon as one of them finds a block, the tip
+ * changes or shutdown is requested. nMaxTries is decreased by the number of
+ * nonces tried.
+ * Returns true, with pblock's nNonce and nSolution set, if a block was found.
+ */
+static bool SolveBlock(CBlock* pblock, int nThreads, int nInnerLoopCount, uint64_t& nMaxTries)
+{
+    const unsigned int n = Params().EquihashN();
+    const unsigned int k = Params().EquihashK();
+
+    uint256 hashBestBlock;
+    {
+        LOCK(g_best_block_mutex);
+        hashBestBlock = g_best_block;
+    }
+
+    // Hash state
+    eh_HashState eh_state;
+    EhInitialiseState(n, k, eh_state);
+
+    // I = the block header minus nonce and solution.
+    CEquihashInput I{*pblock};
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << I;
+
+    // H(I||...
+    eh_state.Update((unsigned char*)&ss[0], ss.size());
+
+    const arith_uint256 nNonceStart = UintToArith256(pblock->nNonce);
+    uint64_t nLimit = 0;
+    if (nNonceStart < nInnerLoopCount) {
+        nLimit = std::min<uint64_t>(nMaxTries, nInnerLoopCount - nNonceStart.GetLow64());
+    }
+
+    // Every thread solves its own copy of the header, and pblock is only
+    // written once they are all done.
+    const CBlockHeader blockHeader = pblock->GetBlockHeader();
+
+    std::atomic<uint64_t> nTries{0};
+    std::atomic<bool> fStop{false};
+    Mutex cs_found;
+    bool fFound = false;
+    CBlockHeader foundHeader;
+    std::string strError;
+
+    // Looking at the tip takes a lock, so the solver only does so between
+    // rounds rather than at every one of its cancellation points.
+    auto ShouldStop = [&](bool fCheckTip) {
+        if (!fStop && ShutdownRequested()) fStop = true;
+        if (!fStop && fCheckTip) {
+            LOCK(g_best_block_mutex);
+            if (g_best_block != hashBestBlock) fStop = true;
+        }
+        return fStop.load();
+    };
+
+    auto Solver = [&, blockHeader]() {
+        CBlockHeader header = blockHeader;
+
+        // (x_1, x_2, ...) = A(I, V, n, k)
+        std::function<bool(std::vector<unsigned char>)> validBlock =
+            [&](std::vector<unsigned char> soln) {
+            header.nSolution = soln;
+            if (!CheckProofOfWork(header.GetHash(), header.nBits, Params().GetConsensus())) {
+                return false;
+            }
+            LOCK(cs_found);
+            if (!fFound) {
+                fFound = true;
+                foundHeader = header;
+            }
+            fStop = true;
+            return true;
+        };
+        std::function<bool(EhSolverCancelCheck)> cancelled =
+            [&](EhSolverCancelCheck pos) {
+            return ShouldStop(pos == RoundEnd || pos == FinalSorting || pos == PartialEnd);
+        };
+
+        try {
+            while (!ShouldStop(true)) {
+                uint64_t nTry = nTries++;
+                if (nTry >= nLimit) break;
+                // Yes, there is a chance every nonce could fail to satisfy the -regtest
+                // target -- 1 in 2^(2^256). That ain't gonna happen
+                header.nNonce = ArithToUint256(nNonceStart + nTry + 1);
+
+                // H(I||V||...
+                eh_HashState curr_state;
+                curr_state = eh_state;
+                curr_state.Update(header.nNonce.begin(), header.nNonce.size());
+
+                EhOptimisedSolve(n, k, curr_state, validBlock, cancelled);
+            }
+        } catch (const EhSolverCancelledException&) {
+        } catch (const std::exception& e) {
+            LOCK(cs_found);
+            strError = e.what();
+            fStop = true;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads; i++) {
+        threads.emplace_back(Solver);
+    }
+    Solver();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    if (!strError.empty()) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Equihash solver failed: %s", strError));
+    }
+
+    const uint64_t nTried = std::min<uint64_t>(nTries, nLimit);
+    nMaxTries -= nTried;
+    if (fFound) {
+        pblock->nNonce = foundHeader.nNonce;
+        pblock->nSolution = foundHeader.nSolution;
+    } else {
+        pblock->nNonce = ArithToUint256(nNonceStart + nTried);
+    }
+    return fFound;
+}
+
 UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGenerate, uint64_t nMaxTries, bool keepScript)
 {
     static const int nInnerLoopCount = 0x10000;
@@ -116,10 +248,16 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
         nHeight = chainActive.Height();
         nHeightEnd = nHeight+nGenerate;
     }
+    int nThreads = gArgs.GetArg("-genproclimit", DEFAULT_GENERATE_THREADS);
+    if (nThreads <= 0) {
+        nThreads = GetNumCores();
+    }
+    // Every solver thread builds its own lists, which take over a GiB each
+    // with the mainnet parameters
+    const uint64_t nSolverMemory = EhOptimisedSolveMemory(Params().EquihashN(), Params().EquihashK());
+    nThreads = std::max<int64_t>(1, std::min<int64_t>(nThreads, (MAX_GENERATE_SOLVER_MEMORY << 20) / nSolverMemory));
     unsigned int nExtraNonce = 0;
     UniValue blockHashes(UniValue::VARR);
-    unsigned int n = Params().EquihashN();
-    unsigned int k = Params().EquihashK();
     while (nHeight < nHeightEnd && !ShutdownRequested())
     {
         std::unique_ptr<CBlockTemplate> pblocktemplate(BlockAssembler(Params()).CreateNewBlock(coinbaseScript->reserveScript));
@@ -131,51 +269,15 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
             IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
         }
 
-        // Hash state
-        crypto_generichash_blake2b_state eh_state;
-        EhInitialiseState(n, k, eh_state);
-
-        // I = the block header minus nonce and solution.
-        CEquihashInput I{*pblock};
-        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-        ss << I;
-
-        // H(I||...
-        crypto_generichash_blake2b_update(&eh_state, (unsigned char*)&ss[0], ss.size());
-
-        while (nMaxTries > 0 && UintToArith256(pblock->nNonce) < nInnerLoopCount) {
-            // Yes, there is a chance every nonce could fail to satisfy the -regtest
-            // target -- 1 in 2^(2^256). That ain't gonna happen
-            pblock->nNonce = ArithToUint256(UintToArith256(pblock->nNonce) + 1);
-            --nMaxTries;
-
-            // H(I||V||...
-            crypto_generichash_blake2b_state curr_state;
-            curr_state = eh_state;
-            crypto_generichash_blake2b_update(&curr_state,
-                                              pblock->nNonce.begin(),
-                                              pblock->nNonce.size());
-
-            // (x_1, x_2, ...) = A(I, V, n, k)
-            std::function<bool(std::vector<unsigned char>)> validBlock =
-                [&pblock](std::vector<unsigned char> soln) {
-                pblock->nSolution = soln;
-                return CheckProofOfWork(pblock->GetHash(), pblock->nBits, Params().GetConsensus());
-            };
-            bool found = EhBasicSolveUncancellable(n, k, curr_state, validBlock);
-            if (found) {
-                goto endloop;
+        if (!SolveBlock(pblock, nThreads, nInnerLoopCount, nMaxTries)) {
+            if (nMaxTries == 0) {
+                break;
             }
-        }
-
-        if (nMaxTries == 0) {
-            break;
-        }
-        if (UintToArith256(pblock->nNonce) == nInnerLoopCount) {
+            // Out of nonces, or the tip changed under us: start over with a
+            // new template
             continue;
         }
 
-    endloop:
         std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(*pblock);
         if (!ProcessNewBlock(Params(), shared_pblock, true, nullptr))
             throw JSONRPCError(RPC_INTERNAL_ERROR, "ProcessNewBlock, block not accepted");
@@ -7,6 +7,8 @@
 
 #include "algebra/curves/alt_bn128/alt_bn128_g1.hpp"
 
+#include <cstdlib>
+
 namespace libsnark {
 
 #ifdef PROFILE_OP_COUNTS
@@ -521,4 +523,135 @@ void batch_to_special_all_non_zeros<alt_bn128_G1>(std::vector<alt_bn128_G1> &vec
     }
 }
 
+/*
+  The buckets are kept in affine coordinates (special form), so that adding a
+  point only takes one field inversion, and the inversions of a round of
+  additions are shared by Montgomery's trick. A round adds at most one point
+  to each bucket; additions to a bucket that is busy are deferred to the next
+  round.
+*/
+template<>
+void batch_add_to_buckets<alt_bn128_G1>(std::vector<alt_bn128_G1> &buckets,
+                                        const std::vector<std::pair<long, const alt_bn128_G1*> > &additions)
+{
+    std::vector<std::pair<size_t, alt_bn128_G1> > pending;
+    pending.reserve(additions.size());
+    std::vector<size_t> non_special;
+
+    for (const auto &addition : additions)
+    {
+        const alt_bn128_G1 &P = *addition.second;
+        if (P.is_zero())
+        {
+            continue;
+        }
+        if (!P.is_special())
+        {
+            non_special.emplace_back(pending.size());
+        }
+        pending.emplace_back(std::labs(addition.first) - 1, addition.first > 0 ? P : -P);
+    }
+
+    if (!non_special.empty())
+    {
+        std::vector<alt_bn128_G1> points;
+        points.reserve(non_special.size());
+        for (const size_t i : non_special)
+        {
+            points.emplace_back(pending[i].second);
+        }
+        batch_to_special_all_non_zeros<alt_bn128_G1>(points);
+        for (size_t k = 0; k < non_special.size(); ++k)
+        {
+            pending[non_special[k]].second = points[k];
+        }
+    }
+
+    std::vector<bool> busy(buckets.size(), false);
+    std::vector<std::pair<size_t, alt_bn128_G1> > deferred;
+    std::vector<size_t> scheduled;
+    std::vector<alt_bn128_Fq> denominators;
+
+    while (!pending.empty())
+    {
+        deferred.clear();
+        scheduled.clear();
+        denominators.clear();
+
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            const size_t idx = pending[i].first;
+            const alt_bn128_G1 &P = pending[i].second;
+            alt_bn128_G1 &B = buckets[idx];
+#ifdef DEBUG
+            assert(B.is_special());
+#endif
+
+            if (busy[idx])
+            {
+                deferred.emplace_back(pending[i]);
+                continue;
+            }
+
+            if (B.is_zero())
+            {
+                B = P;
+                continue;
+            }
+
+            if (B.X == P.X)
+            {
+                if (B.Y != P.Y)
+                {
+                    // P = -B
+                    B = alt_bn128_G1::zero();
+                    continue;
+                }
+                // doubling: lambda = 3 x^2 / 2 y
+                denominators.emplace_back(B.Y + B.Y);
+            }
+            else
+            {
+                // addition: lambda = (y2 - y1) / (x2 - x1)
+                denominators.emplace_back(P.X - B.X);
+            }
+            busy[idx] = true;
+            scheduled.emplace_back(i);
+        }
+
+        batch_invert<alt_bn128_Fq>(denominators);
+
+        for (size_t k = 0; k < scheduled.size(); ++k)
+        {
+            const size_t idx = pending[scheduled[k]].first;
+            const alt_bn128_G1 &P = pending[scheduled[k]].second;
+            alt_bn128_G1 &B = buckets[idx];
+
+            alt_bn128_Fq lambda;
+            if (B.X == P.X)
+            {
+                const alt_bn128_Fq XX = B.X.squared();
+                lambda = (XX + XX + XX) * denominators[k];
+#ifdef PROFILE_OP_COUNTS
+                alt_bn128_G1::dbl_cnt++;
+#endif
+            }
+            else
+            {
+                lambda = (P.Y - B.Y) * denominators[k];
+#ifdef PROFILE_OP_COUNTS
+                alt_bn128_G1::add_cnt++;
+#endif
+            }
+
+            const alt_bn128_Fq X3 = lambda.squared() - B.X - P.X;
+            B.Y = lambda * (B.X - X3) - B.Y;
+            B.X = X3;
+            busy[idx] = false;
+        }
+
+        pending.swap(deferred);
+    }
+}
+
 } // libsnark
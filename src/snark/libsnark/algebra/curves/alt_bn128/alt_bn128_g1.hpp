@@ -7,6 +7,7 @@
 
 #ifndef ALT_BN128_G1_HPP_
 #define ALT_BN128_G1_HPP_
+#include <utility>
 #include <vector>
 #include "algebra/curves/alt_bn128/alt_bn128_init.hpp"
 #include "algebra/curves/curve_utils.hpp"
@@ -91,5 +92,12 @@ void batch_to_special_all_non_zeros(std::vector<T> &vec);
 template<>
 void batch_to_special_all_non_zeros<alt_bn128_G1>(std::vector<alt_bn128_G1> &vec);
 
+template<typename T>
+void batch_add_to_buckets(std::vector<T> &buckets,
+                          const std::vector<std::pair<long, const T*> > &additions);
+template<>
+void batch_add_to_buckets<alt_bn128_G1>(std::vector<alt_bn128_G1> &buckets,
+                                        const std::vector<std::pair<long, const alt_bn128_G1*> > &additions);
+
 } // libsnark
 #endif // ALT_BN128_G1_HPP_
@@ -9,6 +9,7 @@
 #include "algebra/curves/bn128/bn128_pp.hpp"
 #endif
 #include "algebra/curves/alt_bn128/alt_bn128_pp.hpp"
+#include "algebra/scalar_multiplication/multiexp.hpp"
 #include <sstream>
 
 #include <gtest/gtest.h>
@@ -134,6 +135,38 @@ void test_output()
     }
 }
 
+template<typename GroupT>
+void test_multi_exp(const size_t size, const size_t chunks)
+{
+    typedef typename GroupT::scalar_field FieldT;
+
+    std::vector<GroupT> bases;
+    std::vector<FieldT> scalars;
+    for (size_t i = 0; i < size; ++i)
+    {
+        bases.emplace_back(GroupT::random_element());
+        scalars.emplace_back(FieldT::random_element());
+    }
+    /* special form bases, zeros, and bases repeated with equal or opposite
+       signs, so that the buckets see doublings and cancellations */
+    batch_to_special<GroupT>(bases);
+    bases[0] = GroupT::zero();
+    scalars[1] = FieldT::zero();
+    scalars[2] = FieldT::one();
+    scalars[3] = -FieldT::one();
+    bases[5] = bases[4];
+    scalars[5] = scalars[4];
+    bases[7] = -bases[6];
+    scalars[7] = scalars[6];
+    bases[8] = GroupT::random_element();
+
+    const GroupT expected = naive_plain_exp<GroupT, FieldT>(bases.begin(), bases.end(), scalars.begin(), scalars.end());
+    const GroupT result = multi_exp<GroupT, FieldT>(bases.begin(), bases.end(), scalars.begin(), scalars.end(), chunks, true);
+    EXPECT_EQ(result, expected);
+    const GroupT pippenger_result = multi_exp_pippenger<GroupT, FieldT>(bases.begin(), bases.end(), scalars.begin(), scalars.end(), chunks);
+    EXPECT_EQ(pippenger_result, expected);
+}
+
 TEST(algebra, groups)
 {
     alt_bn128_pp::init_public_params();
@@ -143,6 +176,11 @@ TEST(algebra, groups)
     test_output<G2<alt_bn128_pp> >();
     test_mul_by_q<G2<alt_bn128_pp> >();
 
+    test_multi_exp<G1<alt_bn128_pp> >(10, 1);
+    test_multi_exp<G1<alt_bn128_pp> >(1000, 1);
+    test_multi_exp<G1<alt_bn128_pp> >(1000, 64);
+    test_multi_exp<G2<alt_bn128_pp> >(200, 4);
+
 #ifdef CURVE_BN128       // BN128 has fancy dependencies so it may be disabled
     bn128_pp::init_public_params();
     test_group<G1<bn128_pp> >();
@@ -23,6 +23,8 @@ class basic_radix2_domain : public evaluation_domain<FieldT> {
 public:
 
     FieldT omega;
+    /* omega^{0},...,omega^{m/2-1}, shared by all FFTs over the domain */
+    std::vector<FieldT> twiddles;
 
     basic_radix2_domain(const size_t m);
 
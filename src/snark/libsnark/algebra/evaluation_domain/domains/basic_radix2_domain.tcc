@@ -14,6 +14,8 @@
 #ifndef BASIC_RADIX2_DOMAIN_TCC_
 #define BASIC_RADIX2_DOMAIN_TCC_
 
+#include <algorithm>
+
 #include "algebra/evaluation_domain/domains/basic_radix2_domain_aux.hpp"
 
 namespace libsnark {
@@ -26,6 +28,7 @@ basic_radix2_domain<FieldT>::basic_radix2_domain(const size_t m) : evaluation_do
     assert(logm <= (FieldT::s));
 
     omega = get_root_of_unity<FieldT>(m);
+    twiddles = _basic_radix2_twiddles(m, omega);
 }
 
 template<typename FieldT>
@@ -33,7 +36,7 @@ void basic_radix2_domain<FieldT>::FFT(std::vector<FieldT> &a)
 {
     enter_block("Execute FFT");
     assert(a.size() == this->m);
-    _basic_radix2_FFT(a, omega);
+    _blocked_radix2_FFT(a, twiddles);
     leave_block("Execute FFT");
 }
 
@@ -42,7 +45,9 @@ void basic_radix2_domain<FieldT>::iFFT(std::vector<FieldT> &a)
 {
     enter_block("Execute inverse FFT");
     assert(a.size() == this->m);
-    _basic_radix2_FFT(a, omega.inverse());
+    /* The FFT for omega^{-1} is the FFT for omega, with outputs 1..m-1 reversed */
+    _blocked_radix2_FFT(a, twiddles);
+    std::reverse(a.begin() + 1, a.end());
 
     const FieldT sconst = FieldT(a.size()).inverse();
     for (size_t i = 0; i < a.size(); ++i)
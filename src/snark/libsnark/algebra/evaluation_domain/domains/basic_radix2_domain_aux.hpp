@@ -29,6 +29,23 @@ void _basic_radix2_FFT(std::vector<FieldT> &a, const FieldT &omega);
 template<typename FieldT>
 void _parallel_basic_radix2_FFT(std::vector<FieldT> &a, const FieldT &omega);
 
+/**
+ * Compute the twiddle factors omega^{0},...,omega^{m/2-1} used by
+ * _blocked_radix2_FFT over the set S={omega^{0},...,omega^{m-1}}.
+ */
+template<typename FieldT>
+std::vector<FieldT> _basic_radix2_twiddles(const size_t m, const FieldT &omega);
+
+/**
+ * Compute the radix-2 FFT of the vector a, like _basic_radix2_FFT, but with
+ * twiddle factors precomputed by _basic_radix2_twiddles.
+ *
+ * Large vectors are split into rows and columns that fit in cache (Bailey's
+ * four-step FFT), whose FFTs are scheduled dynamically across threads.
+ */
+template<typename FieldT>
+void _blocked_radix2_FFT(std::vector<FieldT> &a, const std::vector<FieldT> &twiddles);
+
 /**
  * Translate the vector a to a coset defined by g.
  */
@@ -14,6 +14,7 @@
 #ifndef BASIC_RADIX2_DOMAIN_AUX_TCC_
 #define BASIC_RADIX2_DOMAIN_AUX_TCC_
 
+#include <algorithm>
 #include <cassert>
 #ifdef MULTICORE
 #include <omp.h>
@@ -168,6 +169,179 @@ void _basic_parallel_radix2_FFT(std::vector<FieldT> &a, const FieldT &omega)
     }
 }
 
+/* FFTs smaller than this are not worth splitting into rows and columns. */
+const size_t blocked_FFT_min_log_size = 10;
+
+/* The number of columns that the four-step FFT gathers at a time. */
+const size_t blocked_FFT_column_block = 16;
+
+template<typename FieldT>
+std::vector<FieldT> _basic_radix2_twiddles(const size_t m, const FieldT &omega)
+{
+    const size_t half = m / 2;
+    std::vector<FieldT> twiddles(half);
+
+#ifdef MULTICORE
+    const size_t chunks = std::min<size_t>(omp_get_max_threads(), half);
+#else
+    const size_t chunks = 1;
+#endif
+
+#ifdef MULTICORE
+    #pragma omp parallel for
+#endif
+    for (size_t c = 0; c < chunks; ++c)
+    {
+        const size_t begin = c * half / chunks, end = (c + 1) * half / chunks;
+        FieldT w = omega^begin;
+        for (size_t i = begin; i < end; ++i)
+        {
+            twiddles[i] = w;
+            w *= omega;
+        }
+    }
+
+    return twiddles;
+}
+
+/*
+ The FFT of the n elements at a, for a root of unity of order n whose powers
+ are a subsequence of the twiddles, which are the first half of the powers of
+ a root of unity of order 2*twiddles.size().
+ */
+template<typename FieldT>
+void _radix2_FFT_with_twiddles(FieldT *a, const size_t n, const std::vector<FieldT> &twiddles)
+{
+    const size_t logn = log2(n);
+    assert(n == (1ul << logn) && n <= 2 * twiddles.size());
+
+    for (size_t k = 0; k < n; ++k)
+    {
+        const size_t rk = bitreverse(k, logn);
+        if (k < rk)
+            std::swap(a[k], a[rk]);
+    }
+
+    for (size_t m = 1; m < n; m *= 2)
+    {
+        // the twiddles of this level are those of the root of order 2*m
+        const size_t step = twiddles.size() / m;
+        for (size_t k = 0; k < n; k += 2*m)
+        {
+            const FieldT t0 = a[k+m];
+            a[k+m] = a[k] - t0;
+            a[k] += t0;
+            for (size_t j = 1; j < m; ++j)
+            {
+                const FieldT t = twiddles[j * step] * a[k+j+m];
+                a[k+j+m] = a[k+j] - t;
+                a[k+j] += t;
+            }
+        }
+    }
+}
+
+/*
+ Bailey's four-step FFT. Seeing a as an n1 x n2 matrix, with element j at
+ row j / n2 and column j % n2, the FFT is:
+ 1. an FFT of size n1 down each column,
+ 2. a multiplication of element (k1, j2) by omega^{j2*k1},
+ 3. an FFT of size n2 along each row,
+ 4. a transposition, so that element (k1, k2) ends up at k1 + n1*k2.
+ Every FFT then works on a block of memory that fits in cache.
+ */
+template<typename FieldT>
+void _blocked_radix2_FFT(std::vector<FieldT> &a, const std::vector<FieldT> &twiddles)
+{
+    const size_t n = a.size(), logn = log2(n);
+    assert(n == (1ul << logn) && n == 2 * twiddles.size());
+
+    if (logn < blocked_FFT_min_log_size)
+    {
+        _radix2_FFT_with_twiddles(a.data(), n, twiddles);
+        return;
+    }
+
+    const size_t n1 = 1ul << (logn / 2), n2 = n / n1;
+    const size_t half = twiddles.size();
+
+    enter_block("Column FFTs");
+#ifdef MULTICORE
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (size_t c = 0; c < n2; c += blocked_FFT_column_block)
+    {
+        const size_t width = std::min(blocked_FFT_column_block, n2 - c);
+        std::vector<FieldT> columns(width * n1);
+        for (size_t j1 = 0; j1 < n1; ++j1)
+        {
+            for (size_t b = 0; b < width; ++b)
+            {
+                columns[b * n1 + j1] = a[j1 * n2 + c + b];
+            }
+        }
+
+        for (size_t b = 0; b < width; ++b)
+        {
+            FieldT *column = &columns[b * n1];
+            _radix2_FFT_with_twiddles(column, n1, twiddles);
+
+            const size_t j2 = c + b;
+            for (size_t k1 = 1; k1 < n1; ++k1)
+            {
+                // omega^{n/2} = -1, so only half of the powers are kept
+                const size_t e = j2 * k1;
+                if (e < half)
+                {
+                    column[k1] *= twiddles[e];
+                }
+                else
+                {
+                    column[k1] = -(column[k1] * twiddles[e - half]);
+                }
+            }
+        }
+
+        for (size_t k1 = 0; k1 < n1; ++k1)
+        {
+            for (size_t b = 0; b < width; ++b)
+            {
+                a[k1 * n2 + c + b] = columns[b * n1 + k1];
+            }
+        }
+    }
+    leave_block("Column FFTs");
+
+    enter_block("Row FFTs");
+#ifdef MULTICORE
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (size_t k1 = 0; k1 < n1; ++k1)
+    {
+        _radix2_FFT_with_twiddles(&a[k1 * n2], n2, twiddles);
+    }
+    leave_block("Row FFTs");
+
+    enter_block("Transpose");
+    std::vector<FieldT> result(n);
+#ifdef MULTICORE
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (size_t k2 = 0; k2 < n2; k2 += blocked_FFT_column_block)
+    {
+        const size_t width = std::min(blocked_FFT_column_block, n2 - k2);
+        for (size_t k1 = 0; k1 < n1; ++k1)
+        {
+            for (size_t b = 0; b < width; ++b)
+            {
+                result[k1 + n1 * (k2 + b)] = a[k1 * n2 + k2 + b];
+            }
+        }
+    }
+    a.swap(result);
+    leave_block("Transpose");
+}
+
 template<typename FieldT>
 void _multiply_by_coset(std::vector<FieldT> &a, const FieldT &g)
 {
@@ -0,0 +1,67 @@
+/**
+ *****************************************************************************
+ * @author     This file is part of libsnark, developed by SCIPR Lab
+ *             and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+#include <vector>
+
+#include "common/profiling.hpp"
+#include "algebra/curves/alt_bn128/alt_bn128_pp.hpp"
+#include "algebra/evaluation_domain/evaluation_domain.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace libsnark;
+
+template<typename FieldT>
+void test_basic_radix2_domain(const size_t m)
+{
+    basic_radix2_domain<FieldT> domain(m);
+
+    std::vector<FieldT> a(m);
+    for (size_t i = 0; i < m; ++i)
+    {
+        a[i] = FieldT::random_element();
+    }
+
+    // The FFT agrees with the unblocked FFT without twiddle tables
+    std::vector<FieldT> expected = a;
+    _basic_serial_radix2_FFT(expected, domain.omega);
+    std::vector<FieldT> b = a;
+    domain.FFT(b);
+    EXPECT_TRUE(b == expected);
+
+    // ... and evaluates the polynomial with coefficients a at omega^i
+    for (size_t i : {(size_t)0, (size_t)1, m / 2, m - 1})
+    {
+        FieldT x = domain.get_element(i), y = FieldT::zero();
+        for (size_t j = m; j-- > 0; )
+        {
+            y = y * x + a[j];
+        }
+        EXPECT_TRUE(b[i] == y);
+    }
+
+    domain.iFFT(b);
+    EXPECT_TRUE(b == a);
+
+    const FieldT g = FieldT::multiplicative_generator;
+    domain.cosetFFT(b, g);
+    domain.icosetFFT(b, g);
+    EXPECT_TRUE(b == a);
+}
+
+TEST(algebra, basic_radix2_domain)
+{
+    start_profiling();
+    alt_bn128_pp::init_public_params();
+    inhibit_profiling_info = true;
+
+    // Below and above the size from which the FFT is blocked, with square
+    // and non-square blocks
+    for (size_t logm : {1, 2, 5, 10, 11, 14})
+    {
+        test_basic_radix2_domain<Fr<alt_bn128_pp> >(1ul << logm);
+    }
+}
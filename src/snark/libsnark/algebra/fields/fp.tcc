@@ -14,6 +14,7 @@
 #include <cmath>
 
 #include "algebra/fields/fp_aux.tcc"
+#include "algebra/fields/fp_mont.hpp"
 #include "algebra/fields/field_utils.hpp"
 #include "common/assert_except.hpp"
 
@@ -157,6 +158,13 @@ void Fp_model<n,modulus>::mul_reduce(const bigint<n> &other)
         mpn_copyi(this->mont_repr.data, tmp, n);
     }
     else
+#endif
+#ifdef LIBSNARK_HAVE_MONT_4LIMB
+    if (n == 4)
+    { // Use the fixed-width 4-limb Montgomery multiplication
+        mont_mul_4limb(this->mont_repr.data, this->mont_repr.data, other.data, modulus.data, inv);
+    }
+    else
 #endif
     {
         mp_limb_t res[2*n];
@@ -612,6 +620,15 @@ Fp_model<n,modulus> Fp_model<n,modulus>::squared() const
         return r;
     }
     else
+#endif
+#ifdef LIBSNARK_HAVE_MONT_4LIMB
+    if (n == 4)
+    { // A dedicated squaring doesn't beat the fixed-width multiplication
+        Fp_model<n, modulus> r;
+        mont_mul_4limb(r.mont_repr.data, this->mont_repr.data, this->mont_repr.data, modulus.data, inv);
+        return r;
+    }
+    else
 #endif
     {
         Fp_model<n, modulus> r(*this);
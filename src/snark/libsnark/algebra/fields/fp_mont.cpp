@@ -0,0 +1,217 @@
+/** @file
+ *****************************************************************************
+ Implementation of fixed-width Montgomery multiplication for 4-limb prime
+ fields.
+
+ Both implementations use the CIOS method: each limb of b is multiplied into
+ the accumulator, which is then reduced by one limb.
+ *****************************************************************************
+ * @author     This file is part of libsnark, developed by SCIPR Lab
+ *             and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include "algebra/fields/fp_mont.hpp"
+
+#ifdef LIBSNARK_HAVE_MONT_4LIMB
+
+#include <cstdint>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <cpuid.h>
+#define LIBSNARK_MONT_4LIMB_ADX 1
+#endif
+
+namespace libsnark {
+
+typedef unsigned __int128 uint128_t;
+
+namespace {
+
+/** Return the low limb of t + a * b + carry, setting carry to the high limb. */
+inline uint64_t mac(uint64_t t, uint64_t a, uint64_t b, uint64_t &carry)
+{
+    const uint128_t r = (uint128_t)a * b + t + carry;
+    carry = (uint64_t)(r >> 64);
+    return (uint64_t)r;
+}
+
+/** Set res = t - m if t >= m, else t, where t = (t4:t0..t3) < 2m. */
+inline void final_subtract(mp_limb_t *res, const uint64_t t[4], uint64_t t4, const mp_limb_t *m)
+{
+    uint64_t u[4];
+    uint64_t borrow = 0;
+    for (size_t j = 0; j < 4; ++j)
+    {
+        uint128_t d = (uint128_t)t[j] - m[j] - borrow;
+        u[j] = (uint64_t)d;
+        borrow = (uint64_t)(d >> 64) & 1;
+    }
+    /* t >= m unless the subtraction borrowed from a zero top limb */
+    const bool keep = borrow > t4;
+    for (size_t j = 0; j < 4; ++j)
+    {
+        res[j] = keep ? t[j] : u[j];
+    }
+}
+
+/**
+ * One CIOS iteration: set t = (t + a * bi + k * m) / 2^64, where k makes the
+ * low limb vanish. t holds five limbs.
+ */
+inline void mont_step(uint64_t t[5], const mp_limb_t *a, uint64_t bi,
+                      const mp_limb_t *m, mp_limb_t inv)
+{
+    uint64_t c = 0;
+    t[0] = mac(t[0], a[0], bi, c);
+    t[1] = mac(t[1], a[1], bi, c);
+    t[2] = mac(t[2], a[2], bi, c);
+    t[3] = mac(t[3], a[3], bi, c);
+    const uint128_t top = (uint128_t)t[4] + c;
+
+    const uint64_t k = t[0] * inv;
+    c = 0;
+    mac(t[0], k, m[0], c);
+    t[0] = mac(t[1], k, m[1], c);
+    t[1] = mac(t[2], k, m[2], c);
+    t[2] = mac(t[3], k, m[3], c);
+    const uint128_t s = top + c;
+    t[3] = (uint64_t)s;
+    t[4] = (uint64_t)(s >> 64);
+}
+
+#ifdef LIBSNARK_MONT_4LIMB_ADX
+
+/*
+ * One CIOS iteration with two interleaved carry chains: ADOX adds the low
+ * halves of the products and ADCX their high halves. T4 must be zero on
+ * entry; on exit T0 is zero and (T4:T1) holds the accumulator, so the next
+ * iteration uses the registers rotated by one.
+ *
+ * This needs m < 2^255, so that the accumulator always fits in five limbs.
+ */
+#define MONT_ADX_ITER(i, T0, T1, T2, T3, T4)                             \
+    "xorq %%rax, %%rax                \n\t"                             \
+    "movq " #i "*8(%[B]), %%rdx       \n\t"                             \
+    "mulxq 0(%[A]), %%rax, %%rbx      \n\t"                             \
+    "adoxq %%rax, %[" #T0 "]          \n\t"                             \
+    "adcxq %%rbx, %[" #T1 "]          \n\t"                             \
+    "mulxq 8(%[A]), %%rax, %%rbx      \n\t"                             \
+    "adoxq %%rax, %[" #T1 "]          \n\t"                             \
+    "adcxq %%rbx, %[" #T2 "]          \n\t"                             \
+    "mulxq 16(%[A]), %%rax, %%rbx     \n\t"                             \
+    "adoxq %%rax, %[" #T2 "]          \n\t"                             \
+    "adcxq %%rbx, %[" #T3 "]          \n\t"                             \
+    "mulxq 24(%[A]), %%rax, %%rbx     \n\t"                             \
+    "adoxq %%rax, %[" #T3 "]          \n\t"                             \
+    "adcxq %%rbx, %[" #T4 "]          \n\t"                             \
+    "movq $0, %%rax                   \n\t"                             \
+    "adoxq %%rax, %[" #T4 "]          \n\t"                             \
+    "/* k = T0 * inv */               \n\t"                             \
+    "movq %[" #T0 "], %%rdx           \n\t"                             \
+    "imulq %[inv], %%rdx              \n\t"                             \
+    "xorq %%rax, %%rax                \n\t"                             \
+    "mulxq 0(%[M]), %%rax, %%rbx      \n\t"                             \
+    "adoxq %%rax, %[" #T0 "]          \n\t"                             \
+    "adcxq %%rbx, %[" #T1 "]          \n\t"                             \
+    "mulxq 8(%[M]), %%rax, %%rbx      \n\t"                             \
+    "adoxq %%rax, %[" #T1 "]          \n\t"                             \
+    "adcxq %%rbx, %[" #T2 "]          \n\t"                             \
+    "mulxq 16(%[M]), %%rax, %%rbx     \n\t"                             \
+    "adoxq %%rax, %[" #T2 "]          \n\t"                             \
+    "adcxq %%rbx, %[" #T3 "]          \n\t"                             \
+    "mulxq 24(%[M]), %%rax, %%rbx     \n\t"                             \
+    "adoxq %%rax, %[" #T3 "]          \n\t"                             \
+    "adcxq %%rbx, %[" #T4 "]          \n\t"                             \
+    "movq $0, %%rax                   \n\t"                             \
+    "adoxq %%rax, %[" #T4 "]          \n\t"
+
+void mont_mul_4limb_adx(mp_limb_t *res, const mp_limb_t *a, const mp_limb_t *b,
+                        const mp_limb_t *m, mp_limb_t inv)
+{
+    uint64_t r0, r1, r2, r3, r4;
+
+    __asm__ volatile
+        ("xorq %[r0], %[r0]               \n\t"
+         "xorq %[r1], %[r1]               \n\t"
+         "xorq %[r2], %[r2]               \n\t"
+         "xorq %[r3], %[r3]               \n\t"
+         "xorq %[r4], %[r4]               \n\t"
+         MONT_ADX_ITER(0, r0, r1, r2, r3, r4)
+         MONT_ADX_ITER(1, r1, r2, r3, r4, r0)
+         MONT_ADX_ITER(2, r2, r3, r4, r0, r1)
+         MONT_ADX_ITER(3, r3, r4, r0, r1, r2)
+         "/* the result (r2:r4) < 2m; subtract m if it doesn't borrow */ \n\t"
+         "movq %[r4], %%rax               \n\t"
+         "subq 0(%[M]), %%rax             \n\t"
+         "movq %[r0], %%rbx               \n\t"
+         "sbbq 8(%[M]), %%rbx             \n\t"
+         "movq %[r1], %%rdx               \n\t"
+         "sbbq 16(%[M]), %%rdx            \n\t"
+         "movq %[r2], %[r3]               \n\t"
+         "sbbq 24(%[M]), %[r3]            \n\t"
+         "cmovcq %[r4], %%rax             \n\t"
+         "cmovcq %[r0], %%rbx             \n\t"
+         "cmovcq %[r1], %%rdx             \n\t"
+         "cmovcq %[r2], %[r3]             \n\t"
+         "movq %%rax, 0(%[res])           \n\t"
+         "movq %%rbx, 8(%[res])           \n\t"
+         "movq %%rdx, 16(%[res])          \n\t"
+         "movq %[r3], 24(%[res])          \n\t"
+         : [r0] "=&r" (r0), [r1] "=&r" (r1), [r2] "=&r" (r2), [r3] "=&r" (r3), [r4] "=&r" (r4)
+         : [res] "r" (res), [A] "r" (a), [B] "r" (b), [M] "r" (m), [inv] "r" (inv)
+         : "cc", "memory", "%rax", "%rbx", "%rdx");
+}
+
+#undef MONT_ADX_ITER
+
+bool cpu_has_adx()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, nullptr) < 7)
+    {
+        return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    const bool bmi2 = (ebx >> 8) & 1;
+    const bool adx = (ebx >> 19) & 1;
+    return bmi2 && adx;
+}
+
+inline bool use_adx(const mp_limb_t *m)
+{
+    static const bool have_adx = cpu_has_adx();
+    return have_adx && (m[3] >> 63) == 0;
+}
+
+#endif // LIBSNARK_MONT_4LIMB_ADX
+
+} // namespace
+
+void mont_mul_4limb_portable(mp_limb_t *res, const mp_limb_t *a, const mp_limb_t *b,
+                             const mp_limb_t *m, mp_limb_t inv)
+{
+    uint64_t t[5] = {0, 0, 0, 0, 0};
+    mont_step(t, a, b[0], m, inv);
+    mont_step(t, a, b[1], m, inv);
+    mont_step(t, a, b[2], m, inv);
+    mont_step(t, a, b[3], m, inv);
+    final_subtract(res, t, t[4], m);
+}
+
+void mont_mul_4limb(mp_limb_t *res, const mp_limb_t *a, const mp_limb_t *b,
+                    const mp_limb_t *m, mp_limb_t inv)
+{
+#ifdef LIBSNARK_MONT_4LIMB_ADX
+    if (use_adx(m))
+    {
+        mont_mul_4limb_adx(res, a, b, m, inv);
+        return;
+    }
+#endif
+    mont_mul_4limb_portable(res, a, b, m, inv);
+}
+
+} // libsnark
+
+#endif // LIBSNARK_HAVE_MONT_4LIMB
@@ -0,0 +1,42 @@
+/** @file
+ *****************************************************************************
+ Declaration of fixed-width Montgomery multiplication for 4-limb prime fields,
+ such as the base and scalar fields of alt_bn128.
+ *****************************************************************************
+ * @author     This file is part of libsnark, developed by SCIPR Lab
+ *             and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef FP_MONT_HPP_
+#define FP_MONT_HPP_
+
+#include <gmp.h>
+
+#if defined(__SIZEOF_INT128__) && GMP_NUMB_BITS == 64
+#define LIBSNARK_HAVE_MONT_4LIMB 1
+#endif
+
+namespace libsnark {
+
+#ifdef LIBSNARK_HAVE_MONT_4LIMB
+
+/**
+ * Set res = a * b * R^{-1} mod m, for R = 2^256, where a and b are smaller
+ * than m and inv = -m^{-1} mod 2^64. res may alias a or b.
+ *
+ * This uses MULX/ADCX/ADOX when the CPU supports them and m < 2^255, and
+ * portable 128-bit arithmetic otherwise.
+ */
+void mont_mul_4limb(mp_limb_t *res, const mp_limb_t *a, const mp_limb_t *b,
+                    const mp_limb_t *m, mp_limb_t inv);
+
+/* The portable implementation, exposed for testing. */
+void mont_mul_4limb_portable(mp_limb_t *res, const mp_limb_t *a, const mp_limb_t *b,
+                             const mp_limb_t *m, mp_limb_t inv);
+
+#endif
+
+} // libsnark
+
+#endif // FP_MONT_HPP_
@@ -11,6 +11,7 @@
 #include "algebra/curves/alt_bn128/alt_bn128_pp.hpp"
 #include "algebra/fields/fp6_3over2.hpp"
 #include "algebra/fields/fp12_2over3over2.hpp"
+#include "algebra/fields/fp_mont.hpp"
 
 #include <gtest/gtest.h>
 
@@ -94,6 +95,68 @@ void test_unitary_inverse()
     EXPECT_EQ(aqcubed_minus1.inverse(), aqcubed_minus1.unitary_inverse());
 }
 
+#ifdef LIBSNARK_HAVE_MONT_4LIMB
+template<typename FieldT>
+void test_mont_4limb()
+{
+    const mp_size_t n = FieldT::num_limbs;
+    ASSERT_EQ(n, 4);
+    const bigint<n> &mod = FieldT::mod;
+
+    mpz_t p, r_inv;
+    mpz_init(p);
+    mpz_init(r_inv);
+    mod.to_mpz(p);
+    mpz_set_ui(r_inv, 1);
+    mpz_mul_2exp(r_inv, r_inv, GMP_NUMB_BITS * n);
+    mpz_invert(r_inv, r_inv, p);
+
+    std::vector<bigint<n> > values;
+    values.emplace_back(bigint<n>(0ul));
+    values.emplace_back(bigint<n>(1ul));
+    bigint<n> mod_minus_one = mod;
+    mpn_sub_1(mod_minus_one.data, mod_minus_one.data, n, 1);
+    values.emplace_back(mod_minus_one);
+    for (size_t i = 0; i < 100; ++i)
+    {
+        values.emplace_back(FieldT::random_element().mont_repr);
+    }
+
+    mpz_t x, y;
+    mpz_init(x);
+    mpz_init(y);
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        const bigint<n> &a = values[i];
+        const bigint<n> &b = values[(i * 7 + 3) % values.size()];
+
+        /* expected a * b * R^{-1} mod p */
+        a.to_mpz(x);
+        b.to_mpz(y);
+        mpz_mul(x, x, y);
+        mpz_mul(x, x, r_inv);
+        mpz_mod(x, x, p);
+        const bigint<n> expected(x);
+
+        bigint<n> res;
+        mont_mul_4limb(res.data, a.data, b.data, mod.data, FieldT::inv);
+        EXPECT_EQ(res, expected);
+        mont_mul_4limb_portable(res.data, a.data, b.data, mod.data, FieldT::inv);
+        EXPECT_EQ(res, expected);
+
+        /* res may alias the inputs */
+        res = a;
+        mont_mul_4limb(res.data, res.data, b.data, mod.data, FieldT::inv);
+        EXPECT_EQ(res, expected);
+    }
+
+    mpz_clear(y);
+    mpz_clear(x);
+    mpz_clear(r_inv);
+    mpz_clear(p);
+}
+#endif
+
 template<typename ppT>
 void test_all_fields()
 {
@@ -183,6 +246,11 @@ TEST(algebra, fields)
     test_Frobenius<alt_bn128_Fq6>();
     test_all_fields<alt_bn128_pp>();
 
+#ifdef LIBSNARK_HAVE_MONT_4LIMB
+    test_mont_4limb<alt_bn128_Fq>();
+    test_mont_4limb<alt_bn128_Fr>();
+#endif
+
 #ifdef CURVE_BN128       // BN128 has fancy dependencies so it may be disabled
     bn128_pp::init_public_params();
     test_field<Fr<bn128_pp> >();
@@ -37,7 +37,8 @@ knowledge_commitment<T1, T2> kc_multi_exp_with_mixed_addition(const knowledge_co
     const FieldT one = FieldT::one();
 
     std::vector<FieldT> p;
-    std::vector<knowledge_commitment<T1, T2> > g;
+    std::vector<T1> g;
+    std::vector<T2> h;
 
     knowledge_commitment<T1, T2> acc = knowledge_commitment<T1, T2>::zero();
 
@@ -73,7 +74,8 @@ knowledge_commitment<T1, T2> kc_multi_exp_with_mixed_addition(const knowledge_co
         else
         {
             p.emplace_back(scalar);
-            g.emplace_back(*value_it);
+            g.emplace_back(value_it->g);
+            h.emplace_back(value_it->h);
             ++num_other;
         }
 
@@ -86,7 +88,9 @@ knowledge_commitment<T1, T2> kc_multi_exp_with_mixed_addition(const knowledge_co
     //print_indent(); printf("* Elements of w remaining: %zu (%0.2f%%)\n", num_other, 100.*num_other/(num_skip+num_add+num_other));
     leave_block("Process scalar vector");
 
-    return acc + multi_exp<knowledge_commitment<T1, T2>, FieldT>(g.begin(), g.end(), p.begin(), p.end(), chunks, use_multiexp);
+    // The two halves are done separately, so that each uses the additions of its own group
+    return acc + knowledge_commitment<T1, T2>(multi_exp<T1, FieldT>(g.begin(), g.end(), p.begin(), p.end(), chunks, use_multiexp),
+                                              multi_exp<T2, FieldT>(h.begin(), h.end(), p.begin(), p.end(), chunks, use_multiexp));
 }
 
 template<typename T1, typename T2>
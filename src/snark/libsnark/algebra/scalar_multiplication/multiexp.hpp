@@ -31,11 +31,13 @@ T naive_plain_exp(typename std::vector<T>::const_iterator vec_start,
                   typename std::vector<FieldT>::const_iterator scalar_end);
 
 /**
- * Naive multi-exponentiation uses a variant of the Bos-Coster algorithm [1],
- * and implementation suggestions from [2].
+ * Multi-exponentiation with use_multiexp uses the bucket method of [3] for
+ * large inputs, and otherwise a variant of the Bos-Coster algorithm [1],
+ * with implementation suggestions from [2], on each of the chunks.
  *
  * [1] = Bos and Coster, "Addition chain heuristics", CRYPTO '89
  * [2] = Bernstein, Duif, Lange, Schwabe, and Yang, "High-speed high-security signatures", CHES '11
+ * [3] = Pippenger, "On the evaluation of powers and related problems", FOCS '76
  */
 template<typename T, typename FieldT>
 T multi_exp(typename std::vector<T>::const_iterator vec_start,
@@ -45,6 +47,28 @@ T multi_exp(typename std::vector<T>::const_iterator vec_start,
             const size_t chunks,
             const bool use_multiexp=false);
 
+/**
+ * Pippenger's bucket method, with scalars recoded into signed c-bit digits.
+ * Each (window, range of bases) pair is a separate task, and tasks are
+ * scheduled dynamically over the given number of threads.
+ */
+template<typename T, typename FieldT>
+T multi_exp_pippenger(typename std::vector<T>::const_iterator vec_start,
+                      typename std::vector<T>::const_iterator vec_end,
+                      typename std::vector<FieldT>::const_iterator scalar_start,
+                      typename std::vector<FieldT>::const_iterator scalar_end,
+                      const size_t num_threads);
+
+/**
+ * Add bases to the buckets of the bucket method: for each (d, P) in
+ * additions, add P to buckets[d-1] if d > 0, and subtract it from
+ * buckets[-d-1] if d < 0. The generic version uses one addition per base;
+ * curves may specialize it.
+ */
+template<typename T>
+void batch_add_to_buckets(std::vector<T> &buckets,
+                          const std::vector<std::pair<long, const T*> > &additions);
+
 
 /**
  * A variant of multi_exp that takes advantage of the method mixed_add (instead of the operator '+').
@@ -18,7 +18,9 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdlib>
 #include <type_traits>
+#include <utility>
 
 #include "common/profiling.hpp"
 #include "common/utils.hpp"
@@ -266,6 +268,190 @@ T multi_exp_inner(typename std::vector<T>::const_iterator vec_start,
     return opt_result;
 }
 
+/* Bases with this many digits are handed to batch_add_to_buckets at once */
+const size_t multi_exp_bucket_batch_size = 2048;
+
+/* Below this many bases the bucket method loses to Bos-Coster */
+const size_t multi_exp_pippenger_min_size = 256;
+
+template<mp_size_t n>
+size_t bigint_window(const bigint<n> &x, const size_t offset, const size_t c)
+{
+    const size_t limb = offset / GMP_NUMB_BITS;
+    const size_t shift = offset % GMP_NUMB_BITS;
+    if (limb >= n)
+    {
+        return 0;
+    }
+
+    mp_limb_t bits = x.data[limb] >> shift;
+    if (shift + c > GMP_NUMB_BITS && limb + 1 < n)
+    {
+        bits |= x.data[limb+1] << (GMP_NUMB_BITS - shift);
+    }
+    return bits & ((1ul << c) - 1);
+}
+
+/*
+  Choose the digit size c minimizing the number of additions: each of the
+  windows costs one addition per base plus two per bucket, and signed digits
+  need 2^(c-1) buckets. c is at least 4 so that the carries of the signed
+  recoding fit in a 64-bit mask.
+*/
+inline size_t pippenger_window_size(const size_t num_bases, const size_t scalar_bits)
+{
+    size_t best_c = 4;
+    size_t best_cost = (size_t)-1;
+    for (size_t c = 4; c <= 16; ++c)
+    {
+        const size_t windows = (scalar_bits + c) / c;
+        const size_t cost = windows * (num_bases + (1ul << c));
+        if (cost < best_cost)
+        {
+            best_c = c;
+            best_cost = cost;
+        }
+    }
+    return best_c;
+}
+
+template<typename T>
+void batch_add_to_buckets(std::vector<T> &buckets,
+                          const std::vector<std::pair<long, const T*> > &additions)
+{
+    for (const auto &addition : additions)
+    {
+        T &bucket = buckets[std::labs(addition.first) - 1];
+        bucket = (addition.first > 0 ? bucket + *addition.second : bucket - *addition.second);
+    }
+}
+
+/*
+  The multi-exponentiation below is Pippenger's bucket method. Every scalar
+  is written as sum_j d_j 2^(c*j) with signed digits -2^(c-1) < d_j <= 2^(c-1).
+  For each window j, adding each base to bucket |d_j| (negated if d_j < 0)
+  and summing the buckets with running sums gives sum_i d_ij * g_i using one
+  addition per base. The windows are then combined with c doublings apiece.
+*/
+template<typename T, typename FieldT>
+T multi_exp_pippenger(typename std::vector<T>::const_iterator vec_start,
+                      typename std::vector<T>::const_iterator vec_end,
+                      typename std::vector<FieldT>::const_iterator scalar_start,
+                      typename std::vector<FieldT>::const_iterator scalar_end,
+                      const size_t num_threads)
+{
+    const mp_size_t n = FieldT::num_limbs;
+    const size_t num_bases = vec_end - vec_start;
+    const size_t scalar_bits = FieldT::size_in_bits();
+    assert((size_t)(scalar_end - scalar_start) == num_bases);
+
+    if (num_bases == 0)
+    {
+        return T::zero();
+    }
+
+    /*
+      Give every thread a task even when there are fewer windows than threads,
+      by also splitting the bases into ranges. Each range has its own buckets,
+      so the digit size is chosen for the range size.
+    */
+    size_t c = pippenger_window_size(num_bases, scalar_bits);
+    size_t windows = (scalar_bits + c) / c;
+    size_t splits = std::max<size_t>(1, std::min((num_threads + windows - 1) / windows, num_bases));
+    if (splits > 1)
+    {
+        c = pippenger_window_size(num_bases / splits, scalar_bits);
+        windows = (scalar_bits + c) / c;
+        splits = std::max<size_t>(1, std::min((num_threads + windows - 1) / windows, num_bases));
+    }
+    assert(windows <= 64);
+    const size_t half = 1ul << (c - 1);
+    const size_t range = (num_bases + splits - 1) / splits;
+
+    /* carries[i] has bit j set if window j of scalar i receives a carry */
+    std::vector<bigint<n> > scalars(num_bases);
+    std::vector<uint64_t> carries(num_bases);
+#ifdef MULTICORE
+#pragma omp parallel for num_threads(num_threads)
+#endif
+    for (size_t i = 0; i < num_bases; ++i)
+    {
+        scalars[i] = (scalar_start + i)->as_bigint();
+
+        uint64_t mask = 0;
+        size_t carry = 0;
+        for (size_t j = 0; j < windows; ++j)
+        {
+            mask |= (uint64_t)carry << j;
+            carry = (bigint_window(scalars[i], j * c, c) + carry > half ? 1 : 0);
+        }
+        assert(carry == 0);
+        carries[i] = mask;
+    }
+
+    std::vector<T> partial(windows * splits, T::zero());
+
+#ifdef MULTICORE
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+#endif
+    for (size_t task = 0; task < windows * splits; ++task)
+    {
+        const size_t j = task / splits;
+        const size_t begin = (task % splits) * range;
+        const size_t end = std::min(begin + range, num_bases);
+
+        std::vector<T> buckets(half, T::zero());
+        std::vector<std::pair<long, const T*> > additions;
+        additions.reserve(multi_exp_bucket_batch_size);
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            long digit = bigint_window(scalars[i], j * c, c) + ((carries[i] >> j) & 1);
+            if (digit > (long)half)
+            {
+                digit -= 2 * half;
+            }
+            if (digit == 0)
+            {
+                continue;
+            }
+
+            additions.emplace_back(digit, &*(vec_start + i));
+            if (additions.size() == multi_exp_bucket_batch_size)
+            {
+                batch_add_to_buckets<T>(buckets, additions);
+                additions.clear();
+            }
+        }
+        batch_add_to_buckets<T>(buckets, additions);
+
+        /* sum_k k * buckets[k-1] */
+        T running = T::zero();
+        T sum = T::zero();
+        for (size_t k = half; k > 0; --k)
+        {
+            running = running + buckets[k-1];
+            sum = sum + running;
+        }
+        partial[task] = sum;
+    }
+
+    T result = T::zero();
+    for (size_t j = windows; j > 0; --j)
+    {
+        for (size_t i = 0; i < c; ++i)
+        {
+            result = result.dbl();
+        }
+        for (size_t s = 0; s < splits; ++s)
+        {
+            result = result + partial[(j-1) * splits + s];
+        }
+    }
+
+    return result;
+}
+
 template<typename T, typename FieldT>
 T multi_exp(typename std::vector<T>::const_iterator vec_start,
             typename std::vector<T>::const_iterator vec_end,
@@ -275,6 +461,11 @@ T multi_exp(typename std::vector<T>::const_iterator vec_start,
             const bool use_multiexp)
 {
     const size_t total = vec_end - vec_start;
+    if (use_multiexp && total >= multi_exp_pippenger_min_size)
+    {
+        return multi_exp_pippenger<T, FieldT>(vec_start, vec_end, scalar_start, scalar_end, chunks);
+    }
+
     if (total < chunks)
     {
         return naive_exp<T, FieldT>(vec_start, vec_end, scalar_start, scalar_end);
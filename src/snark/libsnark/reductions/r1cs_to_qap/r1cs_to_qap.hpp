@@ -63,6 +63,19 @@ qap_witness<FieldT> r1cs_to_qap_witness_map(const r1cs_constraint_system<FieldT>
                                             const FieldT &d2,
                                             const FieldT &d3);
 
+/**
+ * Witness map for the R1CS-to-QAP reduction over a given evaluation domain,
+ * so that the domain can be shared when mapping several witnesses of cs.
+ */
+template<typename FieldT>
+qap_witness<FieldT> r1cs_to_qap_witness_map(const r1cs_constraint_system<FieldT> &cs,
+                                            const std::shared_ptr<evaluation_domain<FieldT> > &domain,
+                                            const r1cs_primary_input<FieldT> &primary_input,
+                                            const r1cs_auxiliary_input<FieldT> &auxiliary_input,
+                                            const FieldT &d1,
+                                            const FieldT &d2,
+                                            const FieldT &d3);
+
 } // libsnark
 
 #include "reductions/r1cs_to_qap/r1cs_to_qap.tcc"
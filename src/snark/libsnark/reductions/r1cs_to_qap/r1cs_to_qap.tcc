@@ -209,13 +209,25 @@ qap_witness<FieldT> r1cs_to_qap_witness_map(const r1cs_constraint_system<FieldT>
                                             const FieldT &d1,
                                             const FieldT &d2,
                                             const FieldT &d3)
+{
+    const std::shared_ptr<evaluation_domain<FieldT> > domain = get_evaluation_domain<FieldT>(cs.num_constraints() + cs.num_inputs() + 1);
+    return r1cs_to_qap_witness_map(cs, domain, primary_input, auxiliary_input, d1, d2, d3);
+}
+
+template<typename FieldT>
+qap_witness<FieldT> r1cs_to_qap_witness_map(const r1cs_constraint_system<FieldT> &cs,
+                                            const std::shared_ptr<evaluation_domain<FieldT> > &domain,
+                                            const r1cs_primary_input<FieldT> &primary_input,
+                                            const r1cs_auxiliary_input<FieldT> &auxiliary_input,
+                                            const FieldT &d1,
+                                            const FieldT &d2,
+                                            const FieldT &d3)
 {
     enter_block("Call to r1cs_to_qap_witness_map");
 
     /* sanity check */
     assert(cs.is_satisfied(primary_input, auxiliary_input));
-
-    const std::shared_ptr<evaluation_domain<FieldT> > domain = get_evaluation_domain<FieldT>(cs.num_constraints() + cs.num_inputs() + 1);
+    assert(domain->m >= cs.num_constraints() + cs.num_inputs() + 1);
 
     r1cs_variable_assignment<FieldT> full_variable_assignment = primary_input;
     full_variable_assignment.insert(full_variable_assignment.end(), auxiliary_input.begin(), auxiliary_input.end());
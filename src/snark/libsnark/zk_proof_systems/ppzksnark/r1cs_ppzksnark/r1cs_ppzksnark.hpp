@@ -51,6 +51,7 @@
 #include "algebra/curves/public_params.hpp"
 #include "common/data_structures/accumulation_vector.hpp"
 #include "algebra/knowledge_commitment/knowledge_commitment.hpp"
+#include "algebra/scalar_multiplication/multiexp.hpp"
 #include "relations/constraint_satisfaction_problems/r1cs/r1cs.hpp"
 #include "zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark_params.hpp"
 
@@ -243,6 +244,12 @@ public:
 
     accumulation_vector<G1<ppT> > encoded_IC_query;
 
+    /* Optional fixed-base tables for encoded_IC_query, in special form (see
+       r1cs_ppzksnark_verifier_process_IC_tables). They are derived from
+       encoded_IC_query, so they are neither compared nor serialized. */
+    size_t IC_window = 0;
+    std::vector<window_table<G1<ppT> > > encoded_IC_tables;
+
     bool operator==(const r1cs_ppzksnark_processed_verification_key &other) const;
     friend std::ostream& operator<< <ppT>(std::ostream &out, const r1cs_ppzksnark_processed_verification_key<ppT> &pvk);
     friend std::istream& operator>> <ppT>(std::istream &in, r1cs_ppzksnark_processed_verification_key<ppT> &pvk);
@@ -398,11 +405,37 @@ r1cs_ppzksnark_proof<ppT> r1cs_ppzksnark_prover(const r1cs_ppzksnark_proving_key
                                                 const r1cs_ppzksnark_constraint_system<ppT> &constraint_system);
 
 template<typename ppT>
-r1cs_ppzksnark_proof<ppT> r1cs_ppzksnark_prover_streaming(std::ifstream &proving_key_file,
+r1cs_ppzksnark_proof<ppT> r1cs_ppzksnark_prover_streaming(std::istream &proving_key_file,
                                                           const r1cs_ppzksnark_primary_input<ppT> &primary_input,
                                                           const r1cs_ppzksnark_auxiliary_input<ppT> &auxiliary_input,
                                                           const r1cs_ppzksnark_constraint_system<ppT> &constraint_system);
 
+/**
+ * A prover algorithm producing several proofs for the same R1CS at once,
+ * from a proving key in memory.
+ *
+ * The evaluation domain is shared between the proofs, and each query of the
+ * key is used for every proof before the next one, while it is in cache.
+ */
+template<typename ppT>
+std::vector<r1cs_ppzksnark_proof<ppT> > r1cs_ppzksnark_batch_prover(const r1cs_ppzksnark_proving_key<ppT> &pk,
+                                                                    const std::vector<r1cs_ppzksnark_primary_input<ppT> > &primary_inputs,
+                                                                    const std::vector<r1cs_ppzksnark_auxiliary_input<ppT> > &auxiliary_inputs,
+                                                                    const r1cs_ppzksnark_constraint_system<ppT> &constraint_system);
+
+/**
+ * A prover algorithm producing several proofs for the same R1CS at once.
+ *
+ * The proving key is read from the stream only once, each of its queries
+ * being used for every proof before the next one is read, and the
+ * evaluation domain is shared between the proofs.
+ */
+template<typename ppT>
+std::vector<r1cs_ppzksnark_proof<ppT> > r1cs_ppzksnark_batch_prover_streaming(std::istream &proving_key_file,
+                                                                              const std::vector<r1cs_ppzksnark_primary_input<ppT> > &primary_inputs,
+                                                                              const std::vector<r1cs_ppzksnark_auxiliary_input<ppT> > &auxiliary_inputs,
+                                                                              const r1cs_ppzksnark_constraint_system<ppT> &constraint_system);
+
 /*
  Below are four variants of verifier algorithm for the R1CS ppzkSNARK.
 
@@ -443,6 +476,25 @@ bool r1cs_ppzksnark_verifier_strong_IC(const r1cs_ppzksnark_verification_key<ppT
 template<typename ppT>
 r1cs_ppzksnark_processed_verification_key<ppT> r1cs_ppzksnark_verifier_process_vk(const r1cs_ppzksnark_verification_key<ppT> &vk);
 
+/**
+ * Precompute fixed-base window tables for the IC query of a processed
+ * verification key, for primary inputs whose i-th element has at most
+ * input_bits[i] bits, as when the input packs bits into field elements.
+ * Inputs that turn out to be larger are still handled, just more slowly.
+ */
+template<typename ppT>
+void r1cs_ppzksnark_verifier_process_IC_tables(r1cs_ppzksnark_processed_verification_key<ppT> &pvk,
+                                               const std::vector<size_t> &input_bits,
+                                               const size_t window);
+
+/**
+ * Compute the input-dependent part of A, i.e., the IC query of the processed
+ * verification key evaluated at a (prefix of the) primary input.
+ */
+template<typename ppT>
+G1<ppT> r1cs_ppzksnark_accumulate_IC(const r1cs_ppzksnark_processed_verification_key<ppT> &pvk,
+                                     const r1cs_ppzksnark_primary_input<ppT> &primary_input);
+
 /**
  * A verifier algorithm for the R1CS ppzkSNARK that:
  * (1) accepts a processed verification key, and
@@ -463,6 +515,23 @@ bool r1cs_ppzksnark_online_verifier_strong_IC(const r1cs_ppzksnark_processed_ver
                                               const r1cs_ppzksnark_primary_input<ppT> &primary_input,
                                               const r1cs_ppzksnark_proof<ppT> &proof);
 
+/**
+ * A batch verifier algorithm for the R1CS ppzkSNARK that:
+ * (1) accepts a processed verification key (and the verification key it was processed from), and
+ * (2) has strong input consistency.
+ *
+ * The pairing checks of all the proofs are combined with random 128-bit
+ * coefficients into a single product of Miller loops, so that the whole batch
+ * pays for one final exponentiation. If the batch is accepted, every proof in
+ * it is valid except with probability about 2^-128; if it is rejected, at
+ * least one of the proofs is invalid.
+ */
+template<typename ppT>
+bool r1cs_ppzksnark_online_batch_verifier_strong_IC(const r1cs_ppzksnark_verification_key<ppT> &vk,
+                                                    const r1cs_ppzksnark_processed_verification_key<ppT> &pvk,
+                                                    const std::vector<r1cs_ppzksnark_primary_input<ppT> > &primary_inputs,
+                                                    const std::vector<r1cs_ppzksnark_proof<ppT> > &proofs);
+
 /****************************** Miscellaneous ********************************/
 
 /**
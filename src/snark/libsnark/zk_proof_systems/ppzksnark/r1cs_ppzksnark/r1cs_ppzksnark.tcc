@@ -585,73 +585,196 @@ r1cs_ppzksnark_proof<ppT> r1cs_ppzksnark_prover(const r1cs_ppzksnark_proving_key
 }
 
 template <typename ppT>
-r1cs_ppzksnark_proof<ppT> r1cs_ppzksnark_prover_streaming(std::ifstream &proving_key_file,
+r1cs_ppzksnark_proof<ppT> r1cs_ppzksnark_prover_streaming(std::istream &proving_key_file,
                                                           const r1cs_ppzksnark_primary_input<ppT> &primary_input,
                                                           const r1cs_ppzksnark_auxiliary_input<ppT> &auxiliary_input,
                                                           const r1cs_ppzksnark_constraint_system<ppT> &constraint_system)
 {
     enter_block("Call to r1cs_ppzksnark_prover_streaming");
 
-    const Fr<ppT> d1 = Fr<ppT>::random_element(),
-        d2 = Fr<ppT>::random_element(),
-        d3 = Fr<ppT>::random_element();
+    const std::vector<r1cs_ppzksnark_primary_input<ppT> > primary_inputs(1, primary_input);
+    const std::vector<r1cs_ppzksnark_auxiliary_input<ppT> > auxiliary_inputs(1, auxiliary_input);
+    r1cs_ppzksnark_proof<ppT> proof = r1cs_ppzksnark_batch_prover_streaming<ppT>(proving_key_file, primary_inputs, auxiliary_inputs, constraint_system)[0];
 
-    enter_block("Compute the polynomial H");
-    const qap_witness<Fr<ppT> > qap_wit = r1cs_to_qap_witness_map(constraint_system, primary_input, auxiliary_input, d1, d2, d3);
-    leave_block("Compute the polynomial H");
+    leave_block("Call to r1cs_ppzksnark_prover_streaming");
 
-    enter_block("Compute the proof");
+    return proof;
+}
 
-    r1cs_ppzksnark_proof<ppT> proof;
+/**
+ * Map the witnesses of a batch to QAP witnesses, over one evaluation domain.
+ */
+template <typename ppT>
+std::vector<qap_witness<Fr<ppT> > > r1cs_ppzksnark_batch_qap_witnesses(const std::vector<r1cs_ppzksnark_primary_input<ppT> > &primary_inputs,
+                                                                        const std::vector<r1cs_ppzksnark_auxiliary_input<ppT> > &auxiliary_inputs,
+                                                                        const r1cs_ppzksnark_constraint_system<ppT> &constraint_system)
+{
+    assert(primary_inputs.size() == auxiliary_inputs.size());
 
-    enter_block("Compute answer to A-query", false);
+    const std::shared_ptr<evaluation_domain<Fr<ppT> > > domain =
+        get_evaluation_domain<Fr<ppT> >(constraint_system.num_constraints() + constraint_system.num_inputs() + 1);
+
+    enter_block("Compute the polynomials H");
+    std::vector<qap_witness<Fr<ppT> > > qap_wits;
+    qap_wits.reserve(primary_inputs.size());
+    for (size_t i = 0; i < primary_inputs.size(); ++i)
+    {
+#ifdef DEBUG
+        assert(constraint_system.is_satisfied(primary_inputs[i], auxiliary_inputs[i]));
+#endif
+        const Fr<ppT> d1 = Fr<ppT>::random_element(),
+            d2 = Fr<ppT>::random_element(),
+            d3 = Fr<ppT>::random_element();
+
+        qap_wits.emplace_back(r1cs_to_qap_witness_map(constraint_system, domain, primary_inputs[i], auxiliary_inputs[i], d1, d2, d3));
+    }
+    leave_block("Compute the polynomials H");
+
+    return qap_wits;
+}
+
+template <typename ppT>
+std::vector<r1cs_ppzksnark_proof<ppT> > r1cs_ppzksnark_batch_prover(const r1cs_ppzksnark_proving_key<ppT> &pk,
+                                                                    const std::vector<r1cs_ppzksnark_primary_input<ppT> > &primary_inputs,
+                                                                    const std::vector<r1cs_ppzksnark_auxiliary_input<ppT> > &auxiliary_inputs,
+                                                                    const r1cs_ppzksnark_constraint_system<ppT> &constraint_system)
+{
+    enter_block("Call to r1cs_ppzksnark_batch_prover");
+
+    const size_t num_proofs = primary_inputs.size();
+    const std::vector<qap_witness<Fr<ppT> > > qap_wits = r1cs_ppzksnark_batch_qap_witnesses<ppT>(primary_inputs, auxiliary_inputs, constraint_system);
+
+    enter_block("Compute the proofs");
+
+    std::vector<r1cs_ppzksnark_proof<ppT> > proofs(num_proofs);
+
+    enter_block("Compute answers to A-query", false);
+    for (size_t i = 0; i < num_proofs; ++i)
+    {
+        proofs[i].g_A = r1cs_compute_proof_kc<ppT, G1<ppT>, G1<ppT> >(qap_wits[i], pk.A_query, qap_wits[i].d1);
+    }
+    leave_block("Compute answers to A-query", false);
+
+    enter_block("Compute answers to B-query", false);
+    for (size_t i = 0; i < num_proofs; ++i)
+    {
+        proofs[i].g_B = r1cs_compute_proof_kc<ppT, G2<ppT>, G1<ppT> >(qap_wits[i], pk.B_query, qap_wits[i].d2);
+    }
+    leave_block("Compute answers to B-query", false);
+
+    enter_block("Compute answers to C-query", false);
+    for (size_t i = 0; i < num_proofs; ++i)
+    {
+        proofs[i].g_C = r1cs_compute_proof_kc<ppT, G1<ppT>, G1<ppT> >(qap_wits[i], pk.C_query, qap_wits[i].d3);
+    }
+    leave_block("Compute answers to C-query", false);
+
+    enter_block("Compute answers to H-query", false);
+    for (size_t i = 0; i < num_proofs; ++i)
+    {
+        proofs[i].g_H = r1cs_compute_proof_H<ppT>(qap_wits[i], pk.H_query);
+    }
+    leave_block("Compute answers to H-query", false);
+
+    enter_block("Compute answers to K-query", false);
+    for (size_t i = 0; i < num_proofs; ++i)
+    {
+        const qap_witness<Fr<ppT> > &qap_wit = qap_wits[i];
+        G1<ppT> zk_shift = qap_wit.d1*pk.K_query[qap_wit.num_variables()+1] +
+                           qap_wit.d2*pk.K_query[qap_wit.num_variables()+2] +
+                           qap_wit.d3*pk.K_query[qap_wit.num_variables()+3];
+        proofs[i].g_K = r1cs_compute_proof_K<ppT>(qap_wit, pk.K_query, zk_shift);
+    }
+    leave_block("Compute answers to K-query", false);
+
+    leave_block("Compute the proofs");
+
+    leave_block("Call to r1cs_ppzksnark_batch_prover");
+
+    return proofs;
+}
+
+template <typename ppT>
+std::vector<r1cs_ppzksnark_proof<ppT> > r1cs_ppzksnark_batch_prover_streaming(std::istream &proving_key_file,
+                                                                              const std::vector<r1cs_ppzksnark_primary_input<ppT> > &primary_inputs,
+                                                                              const std::vector<r1cs_ppzksnark_auxiliary_input<ppT> > &auxiliary_inputs,
+                                                                              const r1cs_ppzksnark_constraint_system<ppT> &constraint_system)
+{
+    enter_block("Call to r1cs_ppzksnark_batch_prover_streaming");
+
+    assert(primary_inputs.size() == auxiliary_inputs.size());
+    const size_t num_proofs = primary_inputs.size();
+
+    const std::vector<qap_witness<Fr<ppT> > > qap_wits = r1cs_ppzksnark_batch_qap_witnesses<ppT>(primary_inputs, auxiliary_inputs, constraint_system);
+
+    enter_block("Compute the proofs");
+
+    std::vector<r1cs_ppzksnark_proof<ppT> > proofs(num_proofs);
+
+    enter_block("Compute answers to A-query", false);
     {
         knowledge_commitment_vector<G1<ppT>, G1<ppT> > A_query;
         proving_key_file >> A_query;
-        proof.g_A = r1cs_compute_proof_kc<ppT, G1<ppT>, G1<ppT> >(qap_wit, A_query, qap_wit.d1);
+        for (size_t i = 0; i < num_proofs; ++i)
+        {
+            proofs[i].g_A = r1cs_compute_proof_kc<ppT, G1<ppT>, G1<ppT> >(qap_wits[i], A_query, qap_wits[i].d1);
+        }
     }
-    leave_block("Compute answer to A-query", false);
+    leave_block("Compute answers to A-query", false);
 
-    enter_block("Compute answer to B-query", false);
+    enter_block("Compute answers to B-query", false);
     {
         knowledge_commitment_vector<G2<ppT>, G1<ppT> > B_query;
         proving_key_file >> B_query;
-        proof.g_B = r1cs_compute_proof_kc<ppT, G2<ppT>, G1<ppT> >(qap_wit, B_query, qap_wit.d2);
+        for (size_t i = 0; i < num_proofs; ++i)
+        {
+            proofs[i].g_B = r1cs_compute_proof_kc<ppT, G2<ppT>, G1<ppT> >(qap_wits[i], B_query, qap_wits[i].d2);
+        }
     }
-    leave_block("Compute answer to B-query", false);
+    leave_block("Compute answers to B-query", false);
 
-    enter_block("Compute answer to C-query", false);
+    enter_block("Compute answers to C-query", false);
     {
         knowledge_commitment_vector<G1<ppT>, G1<ppT> > C_query;
         proving_key_file >> C_query;
-        proof.g_C = r1cs_compute_proof_kc<ppT, G1<ppT>, G1<ppT> >(qap_wit, C_query, qap_wit.d3);
+        for (size_t i = 0; i < num_proofs; ++i)
+        {
+            proofs[i].g_C = r1cs_compute_proof_kc<ppT, G1<ppT>, G1<ppT> >(qap_wits[i], C_query, qap_wits[i].d3);
+        }
     }
-    leave_block("Compute answer to C-query", false);
+    leave_block("Compute answers to C-query", false);
 
-    enter_block("Compute answer to H-query", false);
+    enter_block("Compute answers to H-query", false);
     {
         G1_vector<ppT> H_query;
         proving_key_file >> H_query;
-        proof.g_H = r1cs_compute_proof_H<ppT>(qap_wit, H_query);
+        for (size_t i = 0; i < num_proofs; ++i)
+        {
+            proofs[i].g_H = r1cs_compute_proof_H<ppT>(qap_wits[i], H_query);
+        }
     }
-    leave_block("Compute answer to H-query", false);
+    leave_block("Compute answers to H-query", false);
 
-    enter_block("Compute answer to K-query", false);
+    enter_block("Compute answers to K-query", false);
     {
         G1_vector<ppT> K_query;
         proving_key_file >> K_query;
-        G1<ppT> zk_shift = qap_wit.d1*K_query[qap_wit.num_variables()+1] +
-                           qap_wit.d2*K_query[qap_wit.num_variables()+2] +
-                           qap_wit.d3*K_query[qap_wit.num_variables()+3];
-        proof.g_K = r1cs_compute_proof_K<ppT>(qap_wit, K_query, zk_shift);
+        for (size_t i = 0; i < num_proofs; ++i)
+        {
+            const qap_witness<Fr<ppT> > &qap_wit = qap_wits[i];
+            G1<ppT> zk_shift = qap_wit.d1*K_query[qap_wit.num_variables()+1] +
+                               qap_wit.d2*K_query[qap_wit.num_variables()+2] +
+                               qap_wit.d3*K_query[qap_wit.num_variables()+3];
+            proofs[i].g_K = r1cs_compute_proof_K<ppT>(qap_wit, K_query, zk_shift);
+        }
     }
-    leave_block("Compute answer to K-query", false);
+    leave_block("Compute answers to K-query", false);
 
-    leave_block("Compute the proof");
+    leave_block("Compute the proofs");
 
-    leave_block("Call to r1cs_ppzksnark_prover_streaming");
+    leave_block("Call to r1cs_ppzksnark_batch_prover_streaming");
 
-    return proof;
+    return proofs;
 }
 
 template <typename ppT>
@@ -676,6 +799,85 @@ r1cs_ppzksnark_processed_verification_key<ppT> r1cs_ppzksnark_verifier_process_v
     return pvk;
 }
 
+template <typename ppT>
+void r1cs_ppzksnark_verifier_process_IC_tables(r1cs_ppzksnark_processed_verification_key<ppT> &pvk,
+                                               const std::vector<size_t> &input_bits,
+                                               const size_t window)
+{
+    enter_block("Call to r1cs_ppzksnark_verifier_process_IC_tables");
+
+    const sparse_vector<G1<ppT> > &rest = pvk.encoded_IC_query.rest;
+    std::vector<window_table<G1<ppT> > > tables(std::min(input_bits.size(), rest.domain_size()));
+
+    for (size_t i = 0; i < rest.indices.size(); ++i)
+    {
+        const size_t idx = rest.indices[i];
+        if (idx >= tables.size() || input_bits[idx] == 0)
+        {
+            continue;
+        }
+
+        tables[idx] = get_window_table(input_bits[idx], window, rest.values[i]);
+        for (auto &row : tables[idx])
+        {
+            batch_to_special<G1<ppT> >(row);
+        }
+    }
+
+    pvk.IC_window = window;
+    pvk.encoded_IC_tables = std::move(tables);
+
+    leave_block("Call to r1cs_ppzksnark_verifier_process_IC_tables");
+}
+
+template <typename ppT>
+G1<ppT> r1cs_ppzksnark_accumulate_IC(const r1cs_ppzksnark_processed_verification_key<ppT> &pvk,
+                                     const r1cs_ppzksnark_primary_input<ppT> &primary_input)
+{
+    if (pvk.encoded_IC_tables.empty())
+    {
+        return pvk.encoded_IC_query.template accumulate_chunk<Fr<ppT> >(primary_input.begin(), primary_input.end(), 0).first;
+    }
+
+    const size_t window = pvk.IC_window;
+    G1<ppT> acc = pvk.encoded_IC_query.first;
+
+    /* Elements without a table large enough are left to the generic accumulation */
+    std::vector<Fr<ppT> > other_input(primary_input.size(), Fr<ppT>::zero());
+    bool use_other_input = false;
+
+    for (size_t i = 0; i < primary_input.size(); ++i)
+    {
+        const bigint<Fr<ppT>::num_limbs> x = primary_input[i].as_bigint();
+        if (i >= pvk.encoded_IC_tables.size() ||
+            pvk.encoded_IC_tables[i].empty() ||
+            x.num_bits() > pvk.encoded_IC_tables[i].size() * window)
+        {
+            other_input[i] = primary_input[i];
+            use_other_input = true;
+            continue;
+        }
+
+        const window_table<G1<ppT> > &table = pvk.encoded_IC_tables[i];
+        for (size_t outer = 0; outer < table.size(); ++outer)
+        {
+            const size_t inner = bigint_window(x, outer * window, window);
+            if (inner != 0)
+            {
+                acc = acc.mixed_add(table[outer][inner]);
+            }
+        }
+    }
+
+    if (use_other_input)
+    {
+        const accumulation_vector<G1<ppT> > accumulated_IC = pvk.encoded_IC_query.template accumulate_chunk<Fr<ppT> >(other_input.begin(), other_input.end(), 0);
+        acc = acc + (accumulated_IC.first - pvk.encoded_IC_query.first);
+    }
+
+    return acc;
+}
+
 template <typename ppT>
 bool r1cs_ppzksnark_online_verifier_weak_IC(const r1cs_ppzksnark_processed_verification_key<ppT> &pvk,
                                             const r1cs_ppzksnark_primary_input<ppT> &primary_input,
@@ -683,8 +885,7 @@ bool r1cs_ppzksnark_online_verifier_weak_IC(const r1cs_ppzksnark_processed_verif
 {
     assert(pvk.encoded_IC_query.domain_size() >= primary_input.size());
 
-    const accumulation_vector<G1<ppT> > accumulated_IC = pvk.encoded_IC_query.template accumulate_chunk<Fr<ppT> >(primary_input.begin(), primary_input.end(), 0);
-    const G1<ppT> &acc = accumulated_IC.first;
+    const G1<ppT> acc = r1cs_ppzksnark_accumulate_IC<ppT>(pvk, primary_input);
 
     if (!proof.is_well_formed())
     {
@@ -780,6 +981,103 @@ bool r1cs_ppzksnark_online_verifier_strong_IC(const r1cs_ppzksnark_processed_ver
     return result;
 }
 
+template<typename ppT>
+bool r1cs_ppzksnark_online_batch_verifier_strong_IC(const r1cs_ppzksnark_verification_key<ppT> &vk,
+                                                    const r1cs_ppzksnark_processed_verification_key<ppT> &pvk,
+                                                    const std::vector<r1cs_ppzksnark_primary_input<ppT> > &primary_inputs,
+                                                    const std::vector<r1cs_ppzksnark_proof<ppT> > &proofs)
+{
+    assert(primary_inputs.size() == proofs.size());
+    enter_block("Call to r1cs_ppzksnark_online_batch_verifier_strong_IC");
+
+    /*
+      Each proof j has to satisfy five pairing product equations:
+
+        e(A_g, alphaA_g2)                             = e(A_h, g2)
+        e(alphaB_g1, B_g)                             = e(B_h, g2)
+        e(C_g, alphaC_g2)                             = e(C_h, g2)
+        e(A_g + acc, B_g)                             = e(H, rC_Z_g2) * e(C_g, g2)
+        e(K, gamma_g2)                                = e(A_g + acc + C_g, gamma_beta_g2) * e(gamma_beta_g1, B_g)
+
+      Raising the k-th equation of proof j to a random r_jk and multiplying
+      everything together, all the terms that share a fixed G2 element collapse
+      into one Miller loop, and the three terms paired with B_g collapse into
+      one Miller loop per proof.
+    */
+    G1<ppT> sum_alphaA = G1<ppT>::zero();
+    G1<ppT> sum_one = G1<ppT>::zero();
+    G1<ppT> sum_alphaC = G1<ppT>::zero();
+    G1<ppT> sum_rC_Z = G1<ppT>::zero();
+    G1<ppT> sum_gamma = G1<ppT>::zero();
+    G1<ppT> sum_gamma_beta = G1<ppT>::zero();
+
+    Fqk<ppT> acc_miller = Fqk<ppT>::one();
+
+    for (size_t j = 0; j < proofs.size(); ++j)
+    {
+        const r1cs_ppzksnark_primary_input<ppT> &primary_input = primary_inputs[j];
+        const r1cs_ppzksnark_proof<ppT> &proof = proofs[j];
+
+        if (pvk.encoded_IC_query.domain_size() != primary_input.size())
+        {
+            print_indent(); printf("Input length differs from expected (got %zu, expected %zu).\n", primary_input.size(), pvk.encoded_IC_query.domain_size());
+            leave_block("Call to r1cs_ppzksnark_online_batch_verifier_strong_IC");
+            return false;
+        }
+
+        if (!proof.is_well_formed())
+        {
+            leave_block("Call to r1cs_ppzksnark_online_batch_verifier_strong_IC");
+            return false;
+        }
+
+        const G1<ppT> A_g_acc = proof.g_A.g + r1cs_ppzksnark_accumulate_IC<ppT>(pvk, primary_input);
+
+        bigint<2> r[5];
+        for (size_t k = 0; k < 5; ++k)
+        {
+            do {
+                r[k].randomize();
+            } while (r[k].is_zero());
+        }
+
+        sum_alphaA = sum_alphaA + r[0] * proof.g_A.g;
+        sum_one = sum_one + r[0] * proof.g_A.h + r[1] * proof.g_B.h + r[2] * proof.g_C.h + r[3] * proof.g_C.g;
+        sum_alphaC = sum_alphaC + r[2] * proof.g_C.g;
+        sum_rC_Z = sum_rC_Z + r[3] * proof.g_H;
+        sum_gamma = sum_gamma + r[4] * proof.g_K;
+        sum_gamma_beta = sum_gamma_beta + r[4] * (A_g_acc + proof.g_C.g);
+
+        const G1<ppT> P_B = r[1] * vk.alphaB_g1 + r[3] * A_g_acc - r[4] * vk.gamma_beta_g1;
+        if (!P_B.is_zero() && !proof.g_B.g.is_zero())
+        {
+            acc_miller = acc_miller * ppT::miller_loop(ppT::precompute_G1(P_B), ppT::precompute_G2(proof.g_B.g));
+        }
+    }
+
+    // e(0, Q) = 1, so terms whose G1 side cancelled out are simply skipped.
+    const std::vector<std::pair<G1<ppT>, const G2_precomp<ppT>*> > fixed_terms = {
+        { sum_alphaA,      &pvk.vk_alphaA_g2_precomp },
+        { -sum_one,        &pvk.pp_G2_one_precomp },
+        { sum_alphaC,      &pvk.vk_alphaC_g2_precomp },
+        { -sum_rC_Z,       &pvk.vk_rC_Z_g2_precomp },
+        { sum_gamma,       &pvk.vk_gamma_g2_precomp },
+        { -sum_gamma_beta, &pvk.vk_gamma_beta_g2_precomp },
+    };
+    for (const auto &term : fixed_terms)
+    {
+        if (!term.first.is_zero())
+        {
+            acc_miller = acc_miller * ppT::miller_loop(ppT::precompute_G1(term.first), *term.second);
+        }
+    }
+
+    const bool result = (ppT::final_exponentiation(acc_miller) == GT<ppT>::one());
+
+    leave_block("Call to r1cs_ppzksnark_online_batch_verifier_strong_IC");
+    return result;
+}
+
 template<typename ppT>
 bool r1cs_ppzksnark_verifier_strong_IC(const r1cs_ppzksnark_verification_key<ppT> &vk,
                                        const r1cs_ppzksnark_primary_input<ppT> &primary_input,
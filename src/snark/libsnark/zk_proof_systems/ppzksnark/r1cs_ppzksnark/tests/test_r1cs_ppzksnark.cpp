@@ -10,6 +10,7 @@
  *****************************************************************************/
 #include <cassert>
 #include <cstdio>
+#include <sstream>
 
 #include "algebra/curves/alt_bn128/alt_bn128_pp.hpp"
 #include "common/profiling.hpp"
@@ -42,3 +43,122 @@ TEST(zk_proof_systems, r1cs_ppzksnark)
 
     test_r1cs_ppzksnark<alt_bn128_pp>(1000, 20);
 }
+
+template<typename ppT>
+void test_r1cs_ppzksnark_batch_verifier(size_t num_constraints,
+                                        size_t input_size,
+                                        size_t num_proofs)
+{
+    print_header("(enter) Test R1CS ppzkSNARK batch verifier");
+
+    r1cs_example<Fr<ppT> > example = generate_r1cs_example_with_binary_input<Fr<ppT> >(num_constraints, input_size);
+    example.constraint_system.swap_AB_if_beneficial();
+    r1cs_ppzksnark_keypair<ppT> keypair = r1cs_ppzksnark_generator<ppT>(example.constraint_system);
+    r1cs_ppzksnark_processed_verification_key<ppT> pvk = r1cs_ppzksnark_verifier_process_vk<ppT>(keypair.vk);
+
+    std::vector<r1cs_ppzksnark_primary_input<ppT> > primary_inputs(num_proofs, example.primary_input);
+    std::vector<r1cs_ppzksnark_proof<ppT> > proofs;
+    for (size_t i = 0; i < num_proofs; ++i)
+    {
+        proofs.emplace_back(r1cs_ppzksnark_prover<ppT>(keypair.pk, example.primary_input, example.auxiliary_input, example.constraint_system));
+    }
+
+    EXPECT_TRUE(r1cs_ppzksnark_online_batch_verifier_strong_IC<ppT>(keypair.vk, pvk, primary_inputs, proofs));
+
+    // A single bad proof makes the whole batch fail
+    std::vector<r1cs_ppzksnark_proof<ppT> > bad_proofs = proofs;
+    bad_proofs[num_proofs / 2].g_H = bad_proofs[num_proofs / 2].g_H + G1<ppT>::one();
+    EXPECT_FALSE(r1cs_ppzksnark_online_batch_verifier_strong_IC<ppT>(keypair.vk, pvk, primary_inputs, bad_proofs));
+
+    // So does a proof checked against the wrong primary input
+    std::vector<r1cs_ppzksnark_primary_input<ppT> > bad_inputs = primary_inputs;
+    bad_inputs[0][0] = bad_inputs[0][0] + Fr<ppT>::one();
+    EXPECT_FALSE(r1cs_ppzksnark_online_batch_verifier_strong_IC<ppT>(keypair.vk, pvk, bad_inputs, proofs));
+
+    print_header("(leave) Test R1CS ppzkSNARK batch verifier");
+}
+
+TEST(zk_proof_systems, r1cs_ppzksnark_batch_verifier)
+{
+    start_profiling();
+    alt_bn128_pp::init_public_params();
+
+    test_r1cs_ppzksnark_batch_verifier<alt_bn128_pp>(100, 10, 4);
+}
+
+template<typename ppT>
+void test_r1cs_ppzksnark_batch_prover_streaming(size_t num_constraints,
+                                                size_t input_size,
+                                                size_t num_proofs)
+{
+    print_header("(enter) Test R1CS ppzkSNARK batch streaming prover");
+
+    r1cs_example<Fr<ppT> > example = generate_r1cs_example_with_binary_input<Fr<ppT> >(num_constraints, input_size);
+    example.constraint_system.swap_AB_if_beneficial();
+    r1cs_ppzksnark_keypair<ppT> keypair = r1cs_ppzksnark_generator<ppT>(example.constraint_system);
+
+    std::stringstream pk_stream;
+    pk_stream << keypair.pk;
+
+    std::vector<r1cs_ppzksnark_primary_input<ppT> > primary_inputs(num_proofs, example.primary_input);
+    std::vector<r1cs_ppzksnark_auxiliary_input<ppT> > auxiliary_inputs(num_proofs, example.auxiliary_input);
+    std::vector<r1cs_ppzksnark_proof<ppT> > proofs = r1cs_ppzksnark_batch_prover_streaming<ppT>(pk_stream, primary_inputs, auxiliary_inputs, example.constraint_system);
+
+    EXPECT_EQ(proofs.size(), num_proofs);
+    for (size_t i = 0; i < proofs.size(); ++i)
+    {
+        EXPECT_TRUE(r1cs_ppzksnark_verifier_strong_IC<ppT>(keypair.vk, example.primary_input, proofs[i]));
+    }
+    // Each proof is randomized independently
+    EXPECT_FALSE(proofs[0] == proofs[1]);
+
+    print_header("(leave) Test R1CS ppzkSNARK batch streaming prover");
+}
+
+TEST(zk_proof_systems, r1cs_ppzksnark_batch_prover_streaming)
+{
+    start_profiling();
+    alt_bn128_pp::init_public_params();
+
+    test_r1cs_ppzksnark_batch_prover_streaming<alt_bn128_pp>(100, 10, 3);
+}
+
+template<typename ppT>
+void test_r1cs_ppzksnark_IC_tables(size_t num_constraints,
+                                   size_t input_size)
+{
+    print_header("(enter) Test R1CS ppzkSNARK IC tables");
+
+    r1cs_example<Fr<ppT> > example = generate_r1cs_example_with_binary_input<Fr<ppT> >(num_constraints, input_size);
+    example.constraint_system.swap_AB_if_beneficial();
+    r1cs_ppzksnark_keypair<ppT> keypair = r1cs_ppzksnark_generator<ppT>(example.constraint_system);
+    r1cs_ppzksnark_processed_verification_key<ppT> pvk = r1cs_ppzksnark_verifier_process_vk<ppT>(keypair.vk);
+    r1cs_ppzksnark_processed_verification_key<ppT> pvk_tables = pvk;
+
+    // Tables for 20-bit inputs, except for the last input which has none
+    std::vector<size_t> input_bits(input_size - 1, 20);
+    r1cs_ppzksnark_verifier_process_IC_tables<ppT>(pvk_tables, input_bits, 3);
+
+    // Small inputs, an input too large for its table, and one without a table
+    r1cs_ppzksnark_primary_input<ppT> input;
+    for (size_t i = 0; i < input_size; ++i)
+    {
+        input.emplace_back(Fr<ppT>(i * 77777 + 1));
+    }
+    input[1] = Fr<ppT>::random_element();
+    EXPECT_EQ(r1cs_ppzksnark_accumulate_IC<ppT>(pvk_tables, input), r1cs_ppzksnark_accumulate_IC<ppT>(pvk, input));
+
+    r1cs_ppzksnark_proof<ppT> proof = r1cs_ppzksnark_prover<ppT>(keypair.pk, example.primary_input, example.auxiliary_input, example.constraint_system);
+    EXPECT_TRUE(r1cs_ppzksnark_online_verifier_strong_IC<ppT>(pvk_tables, example.primary_input, proof));
+    EXPECT_FALSE(r1cs_ppzksnark_online_verifier_strong_IC<ppT>(pvk_tables, input, proof));
+
+    print_header("(leave) Test R1CS ppzkSNARK IC tables");
+}
+
+TEST(zk_proof_systems, r1cs_ppzksnark_IC_tables)
+{
+    start_profiling();
+    alt_bn128_pp::init_public_params();
+
+    test_r1cs_ppzksnark_IC_tables<alt_bn128_pp>(100, 10);
+}
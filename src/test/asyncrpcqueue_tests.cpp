@@ -0,0 +1,221 @@
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <asyncrpcoperation.h>
+#include <asyncrpcqueue.h>
+#include <test/test_bitcoin.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(asyncrpcqueue_tests, BasicTestingSetup)
+
+/**
+ * An operation running the given work, which ends up CANCELLED rather than
+ * SUCCESS if it was asked to stop while running.
+ */
+class TestOperation : public AsyncRPCOperation
+{
+public:
+    explicit TestOperation(std::function<void(TestOperation&)> work, int priority = 0) : work_(work)
+    {
+        setPriority(priority);
+    }
+
+    void main() override
+    {
+        if (isCancelled()) {
+            return;
+        }
+        set_state(OperationStatus::EXECUTING);
+        start_execution_clock();
+        fRan = true;
+        work_(*this);
+        stop_execution_clock();
+        set_state(isCancelRequested() ? OperationStatus::CANCELLED : OperationStatus::SUCCESS);
+    }
+
+    std::atomic<bool> fRan{false};
+
+private:
+    std::function<void(TestOperation&)> work_;
+};
+
+/** Wait until pred() holds, for up to ten seconds. */
+static bool WaitFor(std::function<bool()> pred)
+{
+    for (int i = 0; i < 10000 && !pred(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return pred();
+}
+
+BOOST_AUTO_TEST_CASE(priority_order)
+{
+    // Queue the operations before there is a worker to take them
+    AsyncRPCQueue queue;
+    std::mutex cs;
+    std::vector<int> order;
+    const std::vector<int> priorities{0, 2, 1, 2, 0, -1, 1};
+    for (size_t i = 0; i < priorities.size(); i++) {
+        std::shared_ptr<AsyncRPCOperation> operation(new TestOperation([&, i](TestOperation&) {
+            std::lock_guard<std::mutex> guard(cs);
+            order.push_back(i);
+        }, priorities[i]));
+        queue.addOperation(operation);
+    }
+    queue.addWorker();
+    queue.finishAndWait();
+
+    // Highest priority first, then in the order they were added
+    BOOST_CHECK(order == std::vector<int>({1, 3, 2, 6, 0, 4, 5}));
+}
+
+BOOST_AUTO_TEST_CASE(proof_cores_budget)
+{
+    // More workers than cores: each proof gets one, and only two run at once
+    AsyncRPCQueue queue;
+    queue.setProofCores(2);
+    BOOST_CHECK_EQUAL(queue.getProofCores(), 2U);
+
+    std::atomic<size_t> nInUse{0};
+    std::atomic<size_t> nMaxInUse{0};
+    std::atomic<size_t> nMaxReported{0};
+    std::atomic<int> nProofs{0};
+    std::vector<std::shared_ptr<AsyncRPCOperation>> operations;
+    for (int i = 0; i < 16; i++) {
+        operations.emplace_back(new TestOperation([&](TestOperation& op) {
+            for (int j = 0; j < 3; j++) {
+                AsyncRPCProofCores cores(queue, op);
+                if (!cores) {
+                    return;
+                }
+                const size_t n = (nInUse += cores.size());
+                size_t nMax = nMaxInUse;
+                while (n > nMax && !nMaxInUse.compare_exchange_weak(nMax, n)) { }
+                const size_t nReported = queue.getProofCoresInUse();
+                nMax = nMaxReported;
+                while (nReported > nMax && !nMaxReported.compare_exchange_weak(nMax, nReported)) { }
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                nInUse -= cores.size();
+                nProofs++;
+            }
+        }, i % 3));
+        queue.addOperation(operations.back());
+    }
+    for (int i = 0; i < 5; i++) {
+        queue.addWorker();
+    }
+    queue.finishAndWait();
+
+    BOOST_CHECK_EQUAL(nProofs, 16 * 3);
+    BOOST_CHECK(nMaxInUse <= 2U);
+    BOOST_CHECK(nMaxReported <= 2U);
+    BOOST_CHECK_EQUAL(queue.getProofCoresInUse(), 0U);
+    for (const auto& operation : operations) {
+        BOOST_CHECK(operation->isSuccess());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(proof_cores_by_priority)
+{
+    // Without workers, a proof may have the whole budget
+    AsyncRPCQueue queue;
+    queue.setProofCores(3);
+    TestOperation holder([](TestOperation&) {});
+    TestOperation low([](TestOperation&) {}, 0);
+    TestOperation high([](TestOperation&) {}, 1);
+
+    std::unique_ptr<AsyncRPCProofCores> held(new AsyncRPCProofCores(queue, holder));
+    BOOST_CHECK_EQUAL(held->size(), 3U);
+    BOOST_CHECK_EQUAL(queue.getProofCoresInUse(), 3U);
+
+    // The higher priority proof goes first, although it started waiting last
+    std::mutex cs;
+    std::vector<int> order;
+    auto Prove = [&](TestOperation& op, int id) {
+        AsyncRPCProofCores cores(queue, op);
+        std::lock_guard<std::mutex> guard(cs);
+        order.push_back(cores ? id : -1);
+    };
+    std::thread lowThread(Prove, std::ref(low), 0);
+    BOOST_CHECK(WaitFor([&] { return queue.getNumberOfProofWaiters() == 1; }));
+    std::thread highThread(Prove, std::ref(high), 1);
+    BOOST_CHECK(WaitFor([&] { return queue.getNumberOfProofWaiters() == 2; }));
+    {
+        std::lock_guard<std::mutex> guard(cs);
+        BOOST_CHECK(order.empty());
+    }
+
+    held.reset();
+    lowThread.join();
+    highThread.join();
+    BOOST_CHECK(order == std::vector<int>({1, 0}));
+    BOOST_CHECK_EQUAL(queue.getProofCoresInUse(), 0U);
+    BOOST_CHECK_EQUAL(queue.getNumberOfProofWaiters(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(cancel_operations)
+{
+    AsyncRPCQueue queue;
+    queue.setProofCores(1);
+
+    // A queued operation is cancelled without running
+    std::shared_ptr<TestOperation> queued(new TestOperation([](TestOperation&) {}));
+    queue.addOperation(queued);
+    queued->cancel();
+    BOOST_CHECK(queued->isCancelled());
+
+    // A running operation waiting for cores stops waiting
+    std::unique_ptr<AsyncRPCProofCores> held(new AsyncRPCProofCores(queue, *queued));
+    BOOST_CHECK_EQUAL(held->size(), 0U);
+    TestOperation holder([](TestOperation&) {});
+    held.reset(new AsyncRPCProofCores(queue, holder));
+    BOOST_CHECK_EQUAL(held->size(), 1U);
+    std::atomic<bool> fGotCores{false};
+    std::shared_ptr<TestOperation> waiting(new TestOperation([&](TestOperation& op) {
+        AsyncRPCProofCores cores(queue, op);
+        fGotCores = bool(cores);
+    }));
+    queue.addOperation(waiting);
+
+    // A running operation in the middle of its proofs stops between two
+    std::atomic<int> nSteps{0};
+    std::shared_ptr<TestOperation> proving(new TestOperation([&](TestOperation& op) {
+        while (!op.isCancelRequested()) {
+            nSteps++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }));
+    queue.addOperation(proving);
+
+    queue.addWorker();
+    queue.addWorker();
+    BOOST_CHECK(WaitFor([&] { return waiting->isExecuting() && queue.getNumberOfProofWaiters() == 1; }));
+    BOOST_CHECK(WaitFor([&] { return nSteps > 0; }));
+    BOOST_CHECK(proving->isExecuting());
+
+    waiting->cancel();
+    queue.cancelAllOperations();
+    queue.finishAndWait();
+
+    BOOST_CHECK(!queued->fRan);
+    BOOST_CHECK(queued->isCancelled());
+    BOOST_CHECK(waiting->fRan);
+    BOOST_CHECK(!fGotCores);
+    BOOST_CHECK(waiting->isCancelled());
+    BOOST_CHECK(proving->isCancelled());
+    BOOST_CHECK_EQUAL(queue.getProofCoresInUse(), 1U);
+    held.reset();
+    BOOST_CHECK_EQUAL(queue.getProofCoresInUse(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
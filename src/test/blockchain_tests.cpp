@@ -2,8 +2,11 @@
 
 #include <stdlib.h>
 
+#include <chainparams.h>
 #include <rpc/blockchain.h>
 #include <test/test_bitcoin.h>
+#include <txdb.h>
+#include <validation.h>
 
 /* Equality between doubles is imprecise. Comparison should be done
  * with a small threshold of tolerance, rather than exact equality.
@@ -75,4 +78,20 @@ BOOST_AUTO_TEST_CASE(get_difficulty_for_null_tip)
     RejectDifficultyMismatch(difficulty, 1.0);
 }
 
+// Verify that a trimmed Equihash solution is read back from the block tree DB.
+BOOST_FIXTURE_TEST_CASE(get_block_header_with_trimmed_solution, TestingSetup)
+{
+    const CBlockHeader header = Params().GenesisBlock().GetBlockHeader();
+    const uint256 hash = header.GetHash();
+    CBlockIndex index(header);
+    index.phashBlock = &hash;
+    BOOST_CHECK(pblocktree->WriteBatchSync({}, 0, {&index}));
+
+    index.TrimSolution();
+    BOOST_CHECK(index.nSolution.empty());
+    BOOST_CHECK(index.GetBlockSolution() == header.nSolution);
+    BOOST_CHECK_EQUAL(index.GetBlockHeader().GetHash(), hash);
+    BOOST_CHECK_EQUAL(CDiskBlockIndex(&index).GetBlockHash(), hash);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -210,6 +210,32 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Random)
 }
 
 
+/** Test that checks added before the workers start, and spread over more
+ * workers than there are queues, are all done
+ */
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Many_Workers)
+{
+    auto queue = MakeUnique<Correct_Queue>(QUEUE_BATCH_SIZE);
+    FakeCheckCheckCompletion::n_calls = 0;
+    CCheckQueueControl<FakeCheckCheckCompletion> control(queue.get());
+    std::vector<FakeCheckCheckCompletion> vChecks(1000);
+    control.Add(vChecks);
+    boost::thread_group tg;
+    for (auto x = 0; x < 100; ++x) {
+       tg.create_thread([&]{queue->Thread();});
+    }
+    size_t total = vChecks.size();
+    for (size_t i = 0; i < 1000; ++i) {
+        vChecks.resize(InsecureRandRange(10));
+        total += vChecks.size();
+        control.Add(vChecks);
+    }
+    BOOST_REQUIRE(control.Wait());
+    BOOST_REQUIRE_EQUAL(FakeCheckCheckCompletion::n_calls, total);
+    tg.interrupt_all();
+    tg.join_all();
+}
+
 /** Test that failing checks are caught */
 BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure)
 {
@@ -4,6 +4,7 @@
 
 #include <coins.h>
 #include <script/standard.h>
+#include <txdb.h>
 #include <uint256.h>
 #include <undo.h>
 #include <utilstrencodings.h>
@@ -928,4 +929,220 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_prefetch)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+
+    // A prefetched coin is clean, and does not replace the entry the cache
+    // already has
+    COutPoint outpoint(InsecureRand256(), 0);
+    Coin coin(CTxOut(VALUE1, CScript()), 1, false);
+    cache.AddPrefetchedCoin(outpoint, Coin(coin));
+    BOOST_CHECK(cache.HaveCoinInCache(outpoint));
+    BOOST_CHECK(cache.map().at(outpoint).flags == 0);
+    cache.SelfTest();
+    BOOST_CHECK(cache.SpendCoin(outpoint));
+    cache.AddPrefetchedCoin(outpoint, Coin(coin));
+    BOOST_CHECK(!cache.HaveCoinInCache(outpoint));
+    cache.SelfTest();
+
+    // The base view knows neither, so only the prefetched entries answer
+    uint256 nullifier = InsecureRand256();
+    cache.AddPrefetchedNullifier(nullifier, true);
+    BOOST_CHECK(cache.GetNullifier(nullifier));
+    cache.SetNullifier(nullifier, false);
+    cache.AddPrefetchedNullifier(nullifier, true);
+    BOOST_CHECK(!cache.GetNullifier(nullifier));
+
+    ZCIncrementalMerkleTree tree;
+    tree.append(InsecureRand256());
+    cache.AddPrefetchedAnchor(tree.root(), tree);
+    ZCIncrementalMerkleTree result;
+    BOOST_CHECK(cache.GetAnchorAt(tree.root(), result));
+    BOOST_CHECK(result.root() == tree.root());
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_sync_trim)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 1000; i++) {
+        outpoints.emplace_back(InsecureRand256(), 0);
+        cache.AddCoin(outpoints.back(), Coin(CTxOut(VALUE1, CScript()), 1, false), false);
+    }
+    BOOST_CHECK(cache.SpendCoin(outpoints[0]));
+
+    // Sync writes the coins but keeps them, unmodified, and drops the spent one
+    BOOST_CHECK(cache.Sync());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), outpoints.size() - 1);
+    for (const auto& entry : cache.map()) {
+        BOOST_CHECK(entry.second.flags == 0);
+    }
+    Coin coin;
+    BOOST_CHECK(base.GetCoin(outpoints[1], coin));
+    BOOST_CHECK(!base.GetCoin(outpoints[0], coin));
+    BOOST_CHECK_EQUAL(cache.GetCounters().nSyncs, 1U);
+    cache.SelfTest();
+
+    // Trim evicts clean coins only, and the evicted ones are read back
+    // from the base. The memory they took is released.
+    cache.AddCoin(COutPoint(InsecureRand256(), 0), Coin(CTxOut(VALUE2, CScript()), 1, false), false);
+    cache.Trim(0);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 1U);
+    BOOST_CHECK_EQUAL(cache.map().allocated_chunks(), 1U);
+    BOOST_CHECK_EQUAL(cache.GetCounters().nEvicted, outpoints.size() - 1);
+    cache.SelfTest();
+    const uint64_t nMisses = cache.GetCounters().nMisses;
+    BOOST_CHECK(cache.HaveCoin(outpoints[1]));
+    BOOST_CHECK_EQUAL(cache.GetCounters().nMisses, nMisses + 1);
+    BOOST_CHECK(cache.HaveCoin(outpoints[1]));
+    BOOST_CHECK_EQUAL(cache.GetCounters().nMisses, nMisses + 1);
+
+    // A coin looked up since the previous pass outlives the others
+    BOOST_CHECK(cache.Sync());
+    for (size_t i = 1; i < outpoints.size(); i++) {
+        BOOST_CHECK(cache.HaveCoin(outpoints[i]));
+    }
+    for (auto& entry : cache.map()) {
+        entry.second.used = false;
+    }
+    BOOST_CHECK(cache.HaveCoin(outpoints[2]));
+    const size_t nCoins = cache.GetCacheSize();
+    const size_t nTarget = cache.DynamicMemoryUsage() - 1;
+    cache.Trim(nTarget);
+    BOOST_CHECK(cache.GetCacheSize() < nCoins);
+    BOOST_CHECK(cache.DynamicMemoryUsage() <= nTarget);
+    BOOST_CHECK(cache.HaveCoinInCache(outpoints[2]));
+    cache.Trim(0);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    cache.SelfTest();
+}
+
+BOOST_FIXTURE_TEST_CASE(anchor_delta_storage, TestingSetup)
+{
+    CCoinsViewDB db(1 << 20, true, true);
+    std::vector<uint256> roots;
+    ZCIncrementalMerkleTree tree;
+    roots.push_back(tree.root());
+
+    // Push anchors appending between 1 and 7 commitments each, flushing now
+    // and then so that some of their predecessors are only in the database
+    {
+        CCoinsViewCache cache(&db);
+        for (int i = 0; i < 100; i++) {
+            std::vector<uint256> commitments(1 + InsecureRandRange(7));
+            for (uint256& commitment : commitments) {
+                commitment = InsecureRand256();
+                tree.append(commitment);
+            }
+            cache.PushAnchor(tree, commitments);
+            roots.push_back(tree.root());
+            if (InsecureRandRange(10) == 0) {
+                cache.SetBestBlock(InsecureRand256());
+                BOOST_CHECK(cache.Flush());
+            }
+        }
+        // Disconnect the last few anchors
+        for (int i = 0; i < 5; i++) {
+            roots.pop_back();
+            cache.PopAnchor(roots.back());
+        }
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(db.GetBestAnchor() == roots.back());
+
+    // Every anchor can be rebuilt, and popped ones are gone
+    for (const uint256& root : roots) {
+        ZCIncrementalMerkleTree stored;
+        BOOST_CHECK(db.GetAnchorAt(root, stored));
+        BOOST_CHECK(stored.root() == root);
+    }
+    ZCIncrementalMerkleTree popped;
+    BOOST_CHECK(!db.GetAnchorAt(tree.root(), popped));
+
+    // Reading more anchors than the cache keeps evicts the older ones, which
+    // can still be read again
+    CCoinsViewCache cache(&db);
+    for (const uint256& root : roots) {
+        ZCIncrementalMerkleTree cached;
+        BOOST_CHECK(cache.GetAnchorAt(root, cached));
+    }
+    const size_t usage = cache.DynamicMemoryUsage();
+    for (const uint256& root : roots) {
+        ZCIncrementalMerkleTree cached;
+        BOOST_CHECK(cache.GetAnchorAt(root, cached));
+        BOOST_CHECK(cached.root() == root);
+    }
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), usage);
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_db_version, TestingSetup)
+{
+    // An empty database is given the current version, and keeps it once
+    // written to
+    {
+        CCoinsViewDB db(1 << 20, true, true);
+        BOOST_CHECK(db.CheckVersion());
+        CCoinsViewCache cache(&db);
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK(db.CheckVersion());
+    }
+
+    // A database written without a version has to be rebuilt
+    {
+        CCoinsViewDB db(1 << 20, true, true);
+        CCoinsViewCache cache(&db);
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK(!db.CheckVersion());
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(ccoins_background_flush, TestingSetup)
+{
+    CCoinsViewDB db(1 << 20, true, true);
+    CCoinsViewBackgroundFlush flush(&db);
+    const COutPoint spent(InsecureRand256(), 0);
+    const COutPoint unspent(InsecureRand256(), 1);
+    const uint256 nullifier = InsecureRand256();
+    {
+        CCoinsViewCache cache(&flush);
+        cache.AddCoin(spent, Coin(CTxOut(1, CScript() << OP_TRUE), 1, false), false);
+        cache.AddCoin(unspent, Coin(CTxOut(2, CScript() << OP_TRUE), 1, false), false);
+        cache.SetNullifier(nullifier, true);
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+
+    // The flushed state reads the same whether or not it is written yet
+    const uint256 hashBlock = InsecureRand256();
+    {
+        CCoinsViewCache cache(&flush);
+        BOOST_CHECK(cache.HaveCoin(spent));
+        BOOST_CHECK(cache.GetNullifier(nullifier));
+        BOOST_CHECK(cache.SpendCoin(spent));
+        cache.SetNullifier(nullifier, false);
+        cache.SetBestBlock(hashBlock);
+        BOOST_CHECK(cache.Flush());
+    }
+    Coin coin;
+    BOOST_CHECK(!flush.GetCoin(spent, coin));
+    BOOST_CHECK(flush.GetCoin(unspent, coin) && coin.out.nValue == 2);
+    BOOST_CHECK(!flush.GetNullifier(nullifier));
+    BOOST_CHECK(flush.GetBestBlock() == hashBlock);
+
+    // Once written, the database is consistent with the last flush
+    BOOST_CHECK(flush.WaitForFlush());
+    BOOST_CHECK(!db.HaveCoin(spent));
+    BOOST_CHECK(db.HaveCoin(unspent));
+    BOOST_CHECK(!db.GetNullifier(nullifier));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,7 @@
 #endif
 
 #include <arith_uint256.h>
+#include <crypto/common.h>
 #include <crypto/sha256.h>
 #include <crypto/equihash.h>
 #include <test/test_bitcoin.h>
@@ -47,12 +48,12 @@ void PrintSolutions(std::stringstream &strm, std::set<std::vector<uint32_t>> sol
 #ifdef ENABLE_MINING
 void TestEquihashSolvers(unsigned int n, unsigned int k, const std::string &I, const arith_uint256 &nonce, const std::set<std::vector<uint32_t>> &solns) {
     size_t cBitLen { n/(k+1) };
-    crypto_generichash_blake2b_state state;
+    eh_HashState state;
     EhInitialiseState(n, k, state);
     uint256 V = ArithToUint256(nonce);
     BOOST_TEST_MESSAGE("Running solver: n = " << n << ", k = " << k << ", I = " << I << ", V = " << V.GetHex());
-    crypto_generichash_blake2b_update(&state, (unsigned char*)&I[0], I.size());
-    crypto_generichash_blake2b_update(&state, V.begin(), V.size());
+    state.Update((unsigned char*)&I[0], I.size());
+    state.Update(V.begin(), V.size());
 
     // First test the basic solver
     std::set<std::vector<uint32_t>> ret;
@@ -87,11 +88,11 @@ void TestEquihashSolvers(unsigned int n, unsigned int k, const std::string &I, c
 
 void TestEquihashValidator(unsigned int n, unsigned int k, const std::string &I, const arith_uint256 &nonce, std::vector<uint32_t> soln, bool expected) {
     size_t cBitLen { n/(k+1) };
-    crypto_generichash_blake2b_state state;
+    eh_HashState state;
     EhInitialiseState(n, k, state);
     uint256 V = ArithToUint256(nonce);
-    crypto_generichash_blake2b_update(&state, (unsigned char*)&I[0], I.size());
-    crypto_generichash_blake2b_update(&state, V.begin(), V.size());
+    state.Update((unsigned char*)&I[0], I.size());
+    state.Update(V.begin(), V.size());
     BOOST_TEST_MESSAGE("Running validator: n = " << n << ", k = " << k << ", I = " << I << ", V = " << V.GetHex() << ", expected = " << expected << ", soln =");
     std::stringstream strm;
     PrintSolution(strm, soln);
@@ -199,4 +200,44 @@ BOOST_AUTO_TEST_CASE(validator_testvectors) {
                 false);
 }
 
+BOOST_AUTO_TEST_CASE(generate_hashes) {
+    const unsigned char personalization[16] = {'Z', 'c', 'a', 's', 'h', 'P', 'o', 'W', 200, 0, 0, 0, 9, 0, 0, 0};
+
+    // Cover prefixes ending anywhere in the first two blocks, including
+    // those after which the index straddles a block boundary, and index
+    // counts that aren't a multiple of the number of lanes.
+    for (size_t len = 0; len <= 300; len++) {
+        eh_HashState state;
+        EhInitialiseState(200, 9, state);
+        std::vector<unsigned char> prefix(len);
+        for (size_t i = 0; i < len; i++) {
+            prefix[i] = i;
+        }
+        state.Update(prefix.data(), prefix.size());
+
+        std::vector<eh_index> indices;
+        for (eh_index i = 0; i < 1 + len % 11; i++) {
+            indices.push_back(i * 0x9e3779b9);
+        }
+        std::vector<unsigned char> hashes(indices.size() * 50);
+        GenerateHashes(state, indices.data(), indices.size(), hashes.data(), 50);
+        for (size_t i = 0; i < indices.size(); i++) {
+            // Compare with libsodium's BLAKE2b of prefix||index
+            crypto_generichash_blake2b_state sodium_state;
+            crypto_generichash_blake2b_init_salt_personal(&sodium_state, nullptr, 0, 50, nullptr, personalization);
+            crypto_generichash_blake2b_update(&sodium_state, prefix.data(), prefix.size());
+            unsigned char le_index[4];
+            WriteLE32(le_index, indices[i]);
+            crypto_generichash_blake2b_update(&sodium_state, le_index, sizeof(le_index));
+            unsigned char expected[50];
+            crypto_generichash_blake2b_final(&sodium_state, expected, 50);
+            BOOST_CHECK(std::equal(expected, expected + 50, hashes.begin() + i * 50));
+
+            unsigned char hash[50];
+            GenerateHash(state, indices[i], hash, 50);
+            BOOST_CHECK(std::equal(expected, expected + 50, hash));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,161 @@
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/common.h>
+#include <fork.h>
+#include <fs.h>
+#include <primitives/transaction.h>
+#include <test/test_bitcoin.h>
+#include <util.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(fork_tests, TestingSetup)
+
+/** Append the record of txout to data, followed by a separator if fSeparator. */
+static void AppendRecord(std::vector<unsigned char>& data, const CTxOut& txout, bool fSeparator)
+{
+    unsigned char buf[8];
+    WriteLE64(buf, txout.nValue);
+    data.insert(data.end(), buf, buf + 8);
+    WriteLE64(buf, txout.scriptPubKey.size());
+    data.insert(data.end(), buf, buf + 8);
+    data.insert(data.end(), txout.scriptPubKey.begin(), txout.scriptPubKey.end());
+    if (fSeparator) {
+        data.push_back('\n');
+    }
+}
+
+static std::string WriteUTXOFile(const std::string& name, const std::vector<unsigned char>& data)
+{
+    fs::path path = GetDataDir() / name;
+    FILE* file = fsbridge::fopen(path, "wb");
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fwrite(data.data(), 1, data.size(), file), data.size());
+    fclose(file);
+    return path.string();
+}
+
+static CTxOut RandomTxOut()
+{
+    CTxOut txout;
+    txout.nValue = InsecureRandRange(21000000 * COIN);
+    // A record without a separator can't be followed by one whose amount
+    // starts with one
+    if ((txout.nValue & 0xff) == '\n') {
+        txout.nValue++;
+    }
+    txout.scriptPubKey = CScript() << ToByteVector(InsecureRand256()) << OP_CHECKSIG;
+    return txout;
+}
+
+BOOST_AUTO_TEST_CASE(utxo_file_records)
+{
+    std::vector<CTxOut> txouts;
+    for (int i = 0; i < 6; i++) {
+        txouts.push_back(RandomTxOut());
+    }
+    // An empty scriptPubKey is only warned about
+    txouts[4].scriptPubKey.clear();
+
+    // Records with and without separators
+    std::vector<unsigned char> data;
+    for (size_t i = 0; i < txouts.size(); i++) {
+        AppendRecord(data, txouts[i], i % 2 == 0);
+    }
+    // The last record needs a byte after it, which a missing separator
+    // leaves to the end of the file
+    data.push_back('\n');
+
+    CForkUTXOFile file(WriteUTXOFile("utxo-records.bin", data));
+    BOOST_REQUIRE(file.IsOpen());
+    file.BuildIndex(FORK_CB_PER_BLOCK);
+    BOOST_REQUIRE_EQUAL(file.GetRecordCount(), txouts.size());
+    for (size_t i = 0; i < txouts.size(); i++) {
+        BOOST_CHECK(file.MatchesRecord(i, txouts[i]));
+        BOOST_CHECK(!file.MatchesRecord(i, txouts[(i + 1) % txouts.size()]));
+
+        CTxOut wrongValue = txouts[i];
+        wrongValue.nValue++;
+        BOOST_CHECK(!file.MatchesRecord(i, wrongValue));
+
+        CTxOut longerScript = txouts[i];
+        longerScript.scriptPubKey << OP_NOP;
+        BOOST_CHECK(!file.MatchesRecord(i, longerScript));
+    }
+
+    // The index stops at nMaxRecords
+    file.BuildIndex(3);
+    BOOST_CHECK_EQUAL(file.GetRecordCount(), 3U);
+    BOOST_CHECK(file.MatchesRecord(2, txouts[2]));
+
+    BOOST_CHECK(!CForkUTXOFile((GetDataDir() / "utxo-missing.bin").string()).IsOpen());
+}
+
+BOOST_AUTO_TEST_CASE(utxo_file_truncated)
+{
+    std::vector<CTxOut> txouts{RandomTxOut(), RandomTxOut()};
+    std::vector<unsigned char> data;
+    AppendRecord(data, txouts[0], true);
+    const size_t nFirst = data.size();
+    AppendRecord(data, txouts[1], true);
+
+    // Cutting the second record anywhere, from inside its amount to just
+    // before its separator, leaves only the first one
+    for (size_t nCut = nFirst + 1; nCut < data.size(); nCut++) {
+        std::vector<unsigned char> truncated(data.begin(), data.begin() + nCut);
+        CForkUTXOFile file(WriteUTXOFile(strprintf("utxo-truncated-%d.bin", nCut), truncated));
+        BOOST_REQUIRE(file.IsOpen());
+        file.BuildIndex(FORK_CB_PER_BLOCK);
+        BOOST_CHECK_EQUAL(file.GetRecordCount(), 1U);
+        BOOST_CHECK(file.MatchesRecord(0, txouts[0]));
+    }
+
+    // A scriptPubKey size running past the end of the file
+    std::vector<unsigned char> oversized;
+    AppendRecord(oversized, txouts[0], true);
+    WriteLE64(oversized.data() + 8, oversized.size());
+    CForkUTXOFile file(WriteUTXOFile("utxo-oversized.bin", oversized));
+    BOOST_REQUIRE(file.IsOpen());
+    file.BuildIndex(FORK_CB_PER_BLOCK);
+    BOOST_CHECK_EQUAL(file.GetRecordCount(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(fork_record_mismatch)
+{
+    // Enough records for several checks
+    CBlock block;
+    std::vector<unsigned char> data;
+    for (int i = 0; i < 1000; i++) {
+        CMutableTransaction mtx;
+        mtx.vout.push_back(RandomTxOut());
+        AppendRecord(data, mtx.vout[0], i % 3 != 0);
+        block.vtx.push_back(MakeTransactionRef(mtx));
+    }
+    data.push_back('\n');
+    CForkUTXOFile file(WriteUTXOFile("utxo-block.bin", data));
+    BOOST_REQUIRE(file.IsOpen());
+    file.BuildIndex(FORK_CB_PER_BLOCK);
+    BOOST_REQUIRE_EQUAL(file.GetRecordCount(), block.vtx.size());
+
+    // On the check queue, then inline
+    for (int nThreads : {nScriptCheckThreads, 0}) {
+        const int nScriptCheckThreadsOld = nScriptCheckThreads;
+        nScriptCheckThreads = nThreads;
+        BOOST_CHECK_EQUAL(FindForkRecordMismatch(file, block), block.vtx.size());
+
+        // The first of several mismatching transactions is found
+        CBlock badBlock = block;
+        for (size_t i : {950, 420, 421, 150}) {
+            CMutableTransaction mtx(*badBlock.vtx[i]);
+            mtx.vout[0].nValue++;
+            badBlock.vtx[i] = MakeTransactionRef(mtx);
+        }
+        BOOST_CHECK_EQUAL(FindForkRecordMismatch(file, badBlock), 150U);
+        nScriptCheckThreads = nScriptCheckThreadsOld;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,225 @@
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <streams.h>
+#include <test/test_bitcoin.h>
+#include <version.h>
+#include <zcash/IncrementalMerkleTree.hpp>
+#include <zcash/IncrementalWitnessCache.hpp>
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(incrementalmerkletree_tests, BasicTestingSetup)
+
+template<typename T>
+static std::string Serialized(const T& obj)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << obj;
+    return ss.str();
+}
+
+template<typename Tree>
+static void CheckSameTree(const Tree& batchTree, const Tree& seqTree)
+{
+    BOOST_CHECK(batchTree.root() == seqTree.root());
+    BOOST_CHECK_EQUAL(batchTree.size(), seqTree.size());
+    BOOST_CHECK(batchTree.last() == seqTree.last());
+    BOOST_CHECK(Serialized(batchTree) == Serialized(seqTree));
+}
+
+BOOST_AUTO_TEST_CASE(append_batch_matches_append)
+{
+    // Start from every size the testing tree can have, and append batches of
+    // every size that still fits
+    for (size_t start = 0; start <= 16; start++) {
+        for (size_t batch = 0; start + batch <= 16; batch++) {
+            ZCTestingIncrementalMerkleTree seqTree;
+            for (size_t i = 0; i < start; i++) {
+                seqTree.append(InsecureRand256());
+            }
+            ZCTestingIncrementalMerkleTree batchTree = seqTree;
+
+            std::vector<libzcash::SHA256Compress> commitments;
+            for (size_t i = 0; i < batch; i++) {
+                commitments.push_back(InsecureRand256());
+                seqTree.append(commitments.back());
+            }
+            batchTree.append_batch(commitments);
+            if (start + batch > 0) {
+                CheckSameTree(batchTree, seqTree);
+            } else {
+                BOOST_CHECK(Serialized(batchTree) == Serialized(seqTree));
+            }
+
+            // The trees keep matching when they are appended to one by one
+            if (start + batch < 16) {
+                libzcash::SHA256Compress cm = InsecureRand256();
+                seqTree.append(cm);
+                batchTree.append(cm);
+                CheckSameTree(batchTree, seqTree);
+            }
+        }
+    }
+
+    // Batches of varying sizes, some spanning several levels, in the
+    // full-depth tree
+    ZCIncrementalMerkleTree seqTree;
+    ZCIncrementalMerkleTree batchTree;
+    for (int i = 0; i < 20; i++) {
+        std::vector<libzcash::SHA256Compress> commitments(InsecureRandRange(70));
+        for (libzcash::SHA256Compress& cm : commitments) {
+            cm = InsecureRand256();
+            seqTree.append(cm);
+        }
+        batchTree.append_batch(commitments);
+        if (seqTree.size() > 0) {
+            CheckSameTree(batchTree, seqTree);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(append_batch_full_tree)
+{
+    for (size_t start = 0; start <= 16; start++) {
+        ZCTestingIncrementalMerkleTree tree;
+        for (size_t i = 0; i < start; i++) {
+            tree.append(InsecureRand256());
+        }
+
+        // A batch overflowing the tree throws, like append() does once the
+        // tree is full, and leaves the tree as it was
+        const std::string before = Serialized(tree);
+        std::vector<libzcash::SHA256Compress> overflow(16 - start + 1, InsecureRand256());
+        BOOST_CHECK_THROW(tree.append_batch(overflow), std::runtime_error);
+        BOOST_CHECK(Serialized(tree) == before);
+
+        // A batch filling the tree doesn't
+        ZCTestingIncrementalMerkleTree seqTree = tree;
+        std::vector<libzcash::SHA256Compress> fill(16 - start, InsecureRand256());
+        tree.append_batch(fill);
+        for (const libzcash::SHA256Compress& cm : fill) {
+            seqTree.append(cm);
+        }
+        CheckSameTree(tree, seqTree);
+        BOOST_CHECK_THROW(seqTree.append(InsecureRand256()), std::runtime_error);
+        BOOST_CHECK_THROW(tree.append_batch({InsecureRand256()}), std::runtime_error);
+    }
+}
+
+template<typename Tree, typename Witness, typename Cache>
+static void CheckWitnessCache(const Cache& cache, int height, const Tree& tree,
+                              const std::map<uint64_t, Witness>& witnesses)
+{
+    BOOST_CHECK_EQUAL(cache.height(), height);
+    BOOST_CHECK(Serialized(cache.tree()) == Serialized(tree));
+    BOOST_CHECK_EQUAL(cache.size(), witnesses.size());
+    for (const auto& w : witnesses) {
+        auto cached = cache.witness(w.first);
+        BOOST_REQUIRE(cached);
+        BOOST_CHECK(Serialized(*cached) == Serialized(w.second));
+        BOOST_CHECK(cached->root() == tree.root());
+    }
+}
+
+template<typename Tree, typename Witness, typename Cache>
+static void TestWitnessCache(size_t nCommitments, size_t nMaxBlockSize)
+{
+    // Witness every third commitment, appended in blocks of varying size,
+    // both in the cache and in witnesses appended to one by one
+    Tree tree;
+    Cache cache(tree, 0, 5);
+    std::map<uint64_t, Witness> witnesses;
+    std::vector<Tree> trees;
+    std::vector<std::map<uint64_t, Witness>> history;
+
+    size_t appended = 0;
+    for (size_t block = 0; appended < nCommitments; block++) {
+        trees.push_back(tree);
+        history.push_back(witnesses);
+
+        const size_t count = std::min(block % (nMaxBlockSize + 1), nCommitments - appended);
+        std::vector<libzcash::SHA256Compress> commitments;
+        std::vector<size_t> track;
+        for (size_t i = 0; i < count; i++) {
+            libzcash::SHA256Compress cm = InsecureRand256();
+            commitments.push_back(cm);
+            tree.append(cm);
+            for (auto& w : witnesses) {
+                w.second.append(cm);
+            }
+            if ((appended + i) % 3 == 0) {
+                track.push_back(i);
+                witnesses.emplace(appended + i, tree.witness());
+            }
+        }
+        cache.append_block(commitments, track, 1 + block % 3);
+        appended += count;
+
+        CheckWitnessCache(cache, block + 1, tree, witnesses);
+    }
+    trees.push_back(tree);
+    history.push_back(witnesses);
+    const int height = cache.height();
+
+    // Forgetting a note lasts until the block it was forgotten in is undone
+    const uint64_t position = witnesses.begin()->first;
+    cache.forget(position);
+    BOOST_CHECK(!cache.witness(position));
+    BOOST_CHECK_EQUAL(cache.size(), witnesses.size() - 1);
+    cache.forget(position);
+    BOOST_CHECK_EQUAL(cache.size(), witnesses.size() - 1);
+    BOOST_CHECK(!cache.witness(nCommitments));
+
+    // Only the last five blocks can be undone, and a failed rewind leaves
+    // the cache as it was
+    const std::string before = Serialized(cache);
+    BOOST_CHECK(!cache.rewind(height + 1));
+    BOOST_CHECK(!cache.rewind(height - 6));
+    BOOST_CHECK(Serialized(cache) == before);
+
+    BOOST_CHECK(cache.rewind(height));
+    BOOST_CHECK(Serialized(cache) == before);
+    BOOST_CHECK(cache.rewind(height - 2));
+    CheckWitnessCache(cache, height - 2, trees[height - 2], history[height - 2]);
+
+    // Blocks appended after a rewind are witnessed like the ones undone
+    cache.append_block({InsecureRand256()}, {0});
+    BOOST_CHECK_EQUAL(cache.height(), height - 1);
+    BOOST_CHECK(cache.witness(trees[height - 2].size()));
+
+    // A restored cache carries on from its checkpoints
+    Cache restored;
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << cache;
+    ss >> restored;
+    BOOST_CHECK(Serialized(restored) == Serialized(cache));
+    BOOST_CHECK(restored.rewind(height - 5));
+    CheckWitnessCache(restored, height - 5, trees[height - 5], history[height - 5]);
+    BOOST_CHECK(!restored.rewind(height - 6));
+}
+
+BOOST_AUTO_TEST_CASE(witness_cache_matches_witness)
+{
+    TestWitnessCache<ZCTestingIncrementalMerkleTree, ZCTestingIncrementalWitness, ZCTestingIncrementalWitnessCache>(16, 3);
+    TestWitnessCache<ZCIncrementalMerkleTree, ZCIncrementalWitness, ZCIncrementalWitnessCache>(300, 9);
+}
+
+BOOST_AUTO_TEST_CASE(witness_cache_full_tree)
+{
+    ZCTestingIncrementalWitnessCache cache;
+    std::vector<libzcash::SHA256Compress> commitments(16, InsecureRand256());
+    BOOST_CHECK_THROW(cache.append_block(commitments, {16}), std::out_of_range);
+    cache.append_block(commitments, {15});
+    BOOST_CHECK_EQUAL(cache.height(), 1);
+    BOOST_CHECK(cache.witness(15));
+    BOOST_CHECK_THROW(cache.append_block({InsecureRand256()}), std::runtime_error);
+    BOOST_CHECK_EQUAL(cache.height(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
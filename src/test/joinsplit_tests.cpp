@@ -0,0 +1,365 @@
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <checkqueue.h>
+#include <consensus/joinsplit.h>
+#include <consensus/validation.h>
+#include <init.h>
+#include <key.h>
+#include <miner.h>
+#include <policy/policy.h>
+#include <primitives/transaction.h>
+#include <script/interpreter.h>
+#include <test/test_bitcoin.h>
+#include <txmempool.h>
+#include <validation.h>
+#include <zcash/IncrementalMerkleTree.hpp>
+#include <zcash/JoinSplit.hpp>
+
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+
+#include <sodium.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(joinsplit_tests, JoinSplitTestingSetup)
+
+/**
+ * Spend coinbase through a transaction carrying a JoinSplit signed with a
+ * fresh joinSplitPubKey. The JoinSplit is left unproven, so its proof never
+ * verifies.
+ */
+static CMutableTransaction CreateJoinSplitSpend(const CTransaction& coinbase, const CKey& key, bool fValidSig)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
+
+    CMutableTransaction mtx;
+    mtx.nVersion = 2;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(coinbase.GetHash(), 0);
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = 11*CENT;
+    mtx.vout[0].scriptPubKey = scriptPubKey;
+
+    JSDescription jsdesc;
+    jsdesc.anchor = ZCIncrementalMerkleTree::empty_root();
+    for (uint256& nf : jsdesc.nullifiers)
+        nf = InsecureRand256();
+    for (uint256& cm : jsdesc.commitments)
+        cm = InsecureRand256();
+    jsdesc.randomSeed = InsecureRand256();
+    mtx.vjoinsplit.push_back(jsdesc);
+
+    unsigned char joinSplitPrivKey[crypto_sign_SECRETKEYBYTES];
+    crypto_sign_keypair(mtx.joinSplitPubKey.begin(), joinSplitPrivKey);
+    uint256 dataToBeSigned = SignatureHash(CScript(), mtx, NOT_AN_INPUT, SIGHASH_ALL | SIGHASH_FORKID, FORKID_IN_USE, 0, SigVersion::BASE);
+    BOOST_CHECK(crypto_sign_detached(&mtx.joinSplitSig[0], nullptr, dataToBeSigned.begin(), 32, joinSplitPrivKey) == 0);
+    if (!fValidSig)
+        mtx.joinSplitSig[0] ^= 1;
+
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, mtx, 0, SIGHASH_ALL | SIGHASH_FORKID, FORKID_IN_USE, 0, SigVersion::BASE);
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)(SIGHASH_ALL | SIGHASH_FORKID));
+    mtx.vin[0].scriptSig << vchSig;
+    return mtx;
+}
+
+/** Check that tx is rejected by every JoinSplit verification path with strReason. */
+static void CheckJoinSplitRejected(TestChain100Setup& setup, const CMutableTransaction& mtx, const std::string& strReason)
+{
+    CTransaction tx(mtx);
+    int nDoS = 0;
+
+    // Run inline
+    {
+        CValidationState state;
+        BOOST_CHECK(!CheckTransactionJoinsplits(tx, state, STANDARD_SCRIPT_VERIFY_FLAGS, false));
+        BOOST_CHECK(state.IsInvalid(nDoS) && nDoS == 100);
+        BOOST_CHECK_EQUAL(state.GetRejectReason(), strReason);
+    }
+
+    // Handed to a check queue
+    {
+        CCheckQueue<CJoinSplitCheck> queue(1);
+        boost::thread_group threads;
+        for (int i = 0; i < 2; i++)
+            threads.create_thread([&]{queue.Thread();});
+
+        CValidationState state;
+        std::vector<CJoinSplitCheck> vChecks;
+        BOOST_CHECK(CheckTransactionJoinsplits(tx, state, STANDARD_SCRIPT_VERIFY_FLAGS, false, &vChecks));
+        BOOST_CHECK(state.IsValid());
+        BOOST_CHECK_EQUAL(vChecks.size(), tx.vjoinsplit.size() + 1);
+        CJoinSplitCheck::Batch(vChecks, 2);
+
+        CCheckQueueControl<CJoinSplitCheck> control(&queue);
+        control.Add(vChecks);
+        BOOST_CHECK(!control.Wait());
+
+        threads.interrupt_all();
+        threads.join_all();
+    }
+
+    // In the memory pool
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(!AcceptToMemoryPool(mempool, state, MakeTransactionRef(mtx), nullptr /* pfMissingInputs */,
+                                        nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */));
+        BOOST_CHECK(state.IsInvalid(nDoS) && nDoS == 100);
+        BOOST_CHECK_EQUAL(state.GetRejectReason(), strReason);
+        BOOST_CHECK(!mempool.exists(tx.GetHash()));
+    }
+
+    // In a block, from the JoinSplit check queue threads and then inline
+    CScript scriptPubKey = CScript() << ToByteVector(setup.coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CBlock block = setup.CreateAndProcessBlock({mtx}, scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() != block.GetHash());
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(!TestBlockValidity(state, Params(), block, chainActive.Tip(), false, true));
+        BOOST_CHECK(state.IsInvalid(nDoS) && nDoS == 100);
+        BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-txns-joinsplit-verification-failed");
+
+        int nThreads = nScriptCheckThreads;
+        nScriptCheckThreads = 0;
+        CValidationState stateInline;
+        BOOST_CHECK(!TestBlockValidity(stateInline, Params(), block, chainActive.Tip(), false, true));
+        nScriptCheckThreads = nThreads;
+        BOOST_CHECK(stateInline.IsInvalid(nDoS) && nDoS == 100);
+        BOOST_CHECK_EQUAL(stateInline.GetRejectReason(), strReason);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(joinsplit_bad_signature)
+{
+    CMutableTransaction mtx = CreateJoinSplitSpend(*m_coinbase_txns[0], coinbaseKey, false);
+    CheckJoinSplitRejected(*this, mtx, "bad-txns-invalid-joinsplit-signature");
+}
+
+BOOST_AUTO_TEST_CASE(joinsplit_bad_proof)
+{
+    CMutableTransaction mtx = CreateJoinSplitSpend(*m_coinbase_txns[0], coinbaseKey, true);
+    CheckJoinSplitRejected(*this, mtx, "bad-txns-joinsplit-verification-failed");
+}
+
+/**
+ * Stands in for the Sprout parameters, so that unproven JoinSplits can be
+ * verified: it counts the proofs it is asked to verify, and accepts them
+ * unless fRejectAll is set or their randomSeed is rejectSeed.
+ */
+class CountingJoinSplit : public ZCJoinSplit
+{
+public:
+    std::atomic<int> nVerified{0};
+    bool fRejectAll{false};
+    uint256 rejectSeed;
+
+    void loadProvingKey() override {}
+
+    libzcash::ZCProof prove(
+        const std::array<libzcash::JSInput, ZC_NUM_JS_INPUTS>& inputs,
+        const std::array<libzcash::JSOutput, ZC_NUM_JS_OUTPUTS>& outputs,
+        std::array<libzcash::Note, ZC_NUM_JS_OUTPUTS>& out_notes,
+        std::array<ZCNoteEncryption::Ciphertext, ZC_NUM_JS_OUTPUTS>& out_ciphertexts,
+        uint256& out_ephemeralKey,
+        const uint256& pubKeyHash,
+        uint256& out_randomSeed,
+        std::array<uint256, ZC_NUM_JS_INPUTS>& out_hmacs,
+        std::array<uint256, ZC_NUM_JS_INPUTS>& out_nullifiers,
+        std::array<uint256, ZC_NUM_JS_OUTPUTS>& out_commitments,
+        uint64_t vpub_old,
+        uint64_t vpub_new,
+        const uint256& rt,
+        bool computeProof,
+        uint256 *out_esk,
+        ProofWitness *out_witness) override
+    {
+        throw std::logic_error("CountingJoinSplit can't prove");
+    }
+
+    std::vector<libzcash::ZCProof> proveBatch(const std::vector<ProofWitness>& witnesses,
+                                              int nThreads,
+                                              const std::function<bool()>& interrupted) override
+    {
+        throw std::logic_error("CountingJoinSplit can't prove");
+    }
+
+    bool verify(
+        const libzcash::ZCProof& proof,
+        libzcash::ProofVerifier& verifier,
+        const uint256& pubKeyHash,
+        const uint256& randomSeed,
+        const std::array<uint256, ZC_NUM_JS_INPUTS>& hmacs,
+        const std::array<uint256, ZC_NUM_JS_INPUTS>& nullifiers,
+        const std::array<uint256, ZC_NUM_JS_OUTPUTS>& commitments,
+        uint64_t vpub_old,
+        uint64_t vpub_new,
+        const uint256& rt) override
+    {
+        nVerified++;
+        return !fRejectAll && randomSeed != rejectSeed;
+    }
+};
+
+/** The number of JoinSplit proofs of tx that are not in the proof cache. */
+static size_t CountUncachedProofs(const CTransaction& tx)
+{
+    // Looking entries up to store them doesn't erase them
+    CValidationState state;
+    std::vector<CJoinSplitCheck> vChecks;
+    BOOST_CHECK(CheckTransactionJoinsplits(tx, state, STANDARD_SCRIPT_VERIFY_FLAGS, true, &vChecks));
+    return vChecks.size() - 1;
+}
+
+/** Create a block on the tip with just the given transactions, without solving or processing it. */
+static CBlock CreateBlock(const std::vector<CMutableTransaction>& txns, const CScript& scriptPubKey)
+{
+    std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptPubKey);
+    CBlock block = pblocktemplate->block;
+    block.vtx.resize(1);
+    for (const CMutableTransaction& tx : txns)
+        block.vtx.push_back(MakeTransactionRef(tx));
+    LOCK(cs_main);
+    unsigned int extraNonce = 0;
+    IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(joinsplit_cache)
+{
+    CountingJoinSplit* params = new CountingJoinSplit();
+    std::unique_ptr<ZCJoinSplit> realParams(params);
+    pzcashParams.swap(realParams);
+
+    // A chain of spends, each from the output of the previous one
+    CMutableTransaction mtxA = CreateJoinSplitSpend(*m_coinbase_txns[0], coinbaseKey, true);
+    CMutableTransaction mtxB = CreateJoinSplitSpend(CTransaction(mtxA), coinbaseKey, true);
+    CMutableTransaction mtxC = CreateJoinSplitSpend(CTransaction(mtxB), coinbaseKey, true);
+    CTransaction txA(mtxA), txB(mtxB), txC(mtxC);
+    BOOST_CHECK_EQUAL(CountUncachedProofs(txA), 1U);
+    BOOST_CHECK_EQUAL(CountUncachedProofs(txB), 1U);
+
+    // A failed batch stores nothing, not even the proofs that verified
+    {
+        params->rejectSeed = txB.vjoinsplit[0].randomSeed;
+        CValidationState state;
+        std::vector<CJoinSplitCheck> vChecks;
+        BOOST_CHECK(CheckTransactionJoinsplits(txA, state, STANDARD_SCRIPT_VERIFY_FLAGS, true, &vChecks));
+        BOOST_CHECK(CheckTransactionJoinsplits(txB, state, STANDARD_SCRIPT_VERIFY_FLAGS, true, &vChecks));
+        CJoinSplitCheck::Batch(vChecks, 1);
+        bool fValid = true;
+        for (CJoinSplitCheck& check : vChecks)
+            fValid &= check();
+        BOOST_CHECK(!fValid);
+        BOOST_CHECK_EQUAL(params->nVerified, 2);
+
+        CValidationState stateInline;
+        BOOST_CHECK(!CheckTransactionJoinsplits(txB, stateInline, STANDARD_SCRIPT_VERIFY_FLAGS, true));
+        BOOST_CHECK_EQUAL(params->nVerified, 3);
+        BOOST_CHECK_EQUAL(CountUncachedProofs(txA), 1U);
+        BOOST_CHECK_EQUAL(CountUncachedProofs(txB), 1U);
+        params->rejectSeed.SetNull();
+    }
+
+    // The memory pool caches the proofs it verifies
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(AcceptToMemoryPool(mempool, state, MakeTransactionRef(mtxA), nullptr /* pfMissingInputs */,
+                                       nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */));
+        BOOST_CHECK_EQUAL(params->nVerified, 4);
+        BOOST_CHECK_EQUAL(CountUncachedProofs(txA), 0U);
+        BOOST_CHECK_EQUAL(CountUncachedProofs(txB), 1U);
+    }
+
+    // Testing a block skips the cached proofs and keeps them, and caches
+    // the others
+    {
+        LOCK(cs_main);
+        params->fRejectAll = true;
+        CValidationState state;
+        BOOST_CHECK(TestBlockValidity(state, Params(), CreateBlock({mtxA}, CScript() << OP_TRUE), chainActive.Tip(), false, true));
+        BOOST_CHECK_EQUAL(params->nVerified, 4);
+        BOOST_CHECK_EQUAL(CountUncachedProofs(txA), 0U);
+
+        params->fRejectAll = false;
+        BOOST_CHECK(TestBlockValidity(state, Params(), CreateBlock({mtxA, mtxB}, CScript() << OP_TRUE), chainActive.Tip(), false, true));
+        BOOST_CHECK_EQUAL(params->nVerified, 5);
+        BOOST_CHECK_EQUAL(CountUncachedProofs(txA), 0U);
+        BOOST_CHECK_EQUAL(CountUncachedProofs(txB), 0U);
+    }
+
+    // Connecting a block skips the cached proofs, letting the cache evict
+    // them, and doesn't cache the others, which aren't needed again
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    params->fRejectAll = true;
+    CBlock block = CreateAndProcessBlock({mtxA, mtxB}, scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    BOOST_CHECK_EQUAL(params->nVerified, 5);
+
+    params->fRejectAll = false;
+    block = CreateAndProcessBlock({mtxC}, scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    BOOST_CHECK_EQUAL(params->nVerified, 6);
+    BOOST_CHECK_EQUAL(CountUncachedProofs(txC), 1U);
+
+    pzcashParams.swap(realParams);
+}
+
+BOOST_AUTO_TEST_CASE(joinsplit_prove_batch)
+{
+    const uint256 joinSplitPubKey = InsecureRand256();
+    const uint256 rt = ZCIncrementalMerkleTree::empty_root();
+    std::array<libzcash::JSInput, ZC_NUM_JS_INPUTS> inputs = {libzcash::JSInput(), libzcash::JSInput()};
+    std::array<libzcash::JSOutput, ZC_NUM_JS_OUTPUTS> outputs = {libzcash::JSOutput(), libzcash::JSOutput()};
+
+    auto Verify = [&](const JSDescription& jsdesc) {
+        auto verifier = libzcash::ProofVerifier::Strict();
+        return jsdesc.Verify(*pzcashParams, verifier, joinSplitPubKey);
+    };
+
+    // Unproven JoinSplits, with the witnesses to prove them later: more
+    // than fit in one batch
+    std::vector<JSDescription> jsdescs;
+    std::vector<ZCJoinSplit::ProofWitness> witnesses;
+    for (int i = 0; i < 5; i++) {
+        ZCJoinSplit::ProofWitness witness;
+        jsdescs.emplace_back(*pzcashParams, joinSplitPubKey, rt, inputs, outputs, 0, 0, false, nullptr, &witness);
+        witnesses.push_back(std::move(witness));
+        BOOST_CHECK(!Verify(jsdescs.back()));
+    }
+
+    // What prove() does for a single JoinSplit
+    JSDescription proven(*pzcashParams, joinSplitPubKey, rt, inputs, outputs, 0, 0);
+    BOOST_CHECK(Verify(proven));
+
+    // Streaming the proving key, and with the key preloaded, every proof of
+    // a batch verifies for its own JoinSplit only
+    for (bool fPreload : {false, true}) {
+        if (fPreload) {
+            pzcashParams->loadProvingKey();
+        }
+        std::vector<libzcash::ZCProof> proofs = pzcashParams->proveBatch(witnesses, fPreload ? 2 : 0);
+        BOOST_REQUIRE_EQUAL(proofs.size(), witnesses.size());
+        for (size_t i = 0; i < jsdescs.size(); i++) {
+            JSDescription jsdesc = jsdescs[i];
+            jsdesc.proof = proofs[i];
+            BOOST_CHECK(Verify(jsdesc));
+            jsdesc.proof = proofs[(i + 1) % proofs.size()];
+            BOOST_CHECK(!Verify(jsdesc));
+        }
+    }
+
+    // An interrupted batch returns the proofs done so far
+    BOOST_CHECK(pzcashParams->proveBatch(witnesses, 0, [] { return true; }).empty());
+    BOOST_CHECK(pzcashParams->proveBatch({}).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
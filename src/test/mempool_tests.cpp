@@ -106,6 +106,54 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     BOOST_CHECK_EQUAL(testPool.size(), 0U);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolNullifierTest)
+{
+    TestMemPoolEntryHelper entry;
+    // Two unrelated transactions revealing the same nullifier
+    uint256 nf = InsecureRand256();
+    CMutableTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    tx1.vjoinsplit.resize(1);
+    tx1.vjoinsplit[0].nullifiers[0] = nf;
+    tx1.vjoinsplit[0].nullifiers[1] = InsecureRand256();
+
+    CMutableTransaction tx2 = tx1;
+    tx2.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+    tx2.vjoinsplit[0].nullifiers[1] = InsecureRand256();
+
+    // A child of tx1
+    CMutableTransaction tx3;
+    tx3.vin.resize(1);
+    tx3.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx3.vout[0].nValue = 10 * COIN;
+
+    CTxMemPool testPool;
+    LOCK(testPool.cs);
+
+    testPool.addUnchecked(entry.FromTx(tx1));
+    testPool.addUnchecked(entry.FromTx(tx3));
+    BOOST_CHECK(*testPool.GetNullifierConflictTx(nf) == CTransaction(tx1));
+    BOOST_CHECK(*testPool.GetNullifierConflictTx(tx1.vjoinsplit[0].nullifiers[1]) == CTransaction(tx1));
+    BOOST_CHECK(testPool.GetNullifierConflictTx(tx2.vjoinsplit[0].nullifiers[1]) == nullptr);
+
+    // tx2 being mined removes tx1 and its child
+    testPool.removeConflicts(CTransaction(tx2));
+    BOOST_CHECK_EQUAL(testPool.size(), 0U);
+    BOOST_CHECK(testPool.mapNullifiers.empty());
+
+    // Removing a transaction unmarks its nullifiers
+    testPool.addUnchecked(entry.FromTx(tx1));
+    testPool.removeRecursive(CTransaction(tx1));
+    BOOST_CHECK(testPool.GetNullifierConflictTx(nf) == nullptr);
+    BOOST_CHECK(testPool.mapNullifiers.empty());
+}
+
 template<typename name>
 static void CheckSort(CTxMemPool &pool, std::vector<std::string> &sortedOrder) EXCLUSIVE_LOCKS_REQUIRED(pool.cs)
 {
@@ -0,0 +1,120 @@
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/test_bitcoin.h>
+#include <uint256.h>
+#include <zcash/NoteEncryption.hpp>
+
+#include <stdexcept>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(noteencryption_tests, BasicTestingSetup)
+
+/** A decryptor whose pk_enc doesn't belong to its sk_enc, which only the KDF notices. */
+class WrongPkNoteDecryption : public ZCNoteDecryption
+{
+public:
+    WrongPkNoteDecryption(const uint256& sk_enc, const uint256& pk_enc) : ZCNoteDecryption(sk_enc)
+    {
+        this->pk_enc = pk_enc;
+    }
+};
+
+struct QueuedCiphertext {
+    ZCNoteDecryption::Ciphertext ciphertext;
+    uint256 epk;
+    uint256 hSig;
+    unsigned char nonce;
+};
+
+BOOST_AUTO_TEST_CASE(decryption_batch_matches_decrypt)
+{
+    std::vector<uint256> sk_encs;
+    std::vector<ZCNoteDecryption> decryptors;
+    for (size_t k = 0; k < 4; k++) {
+        sk_encs.push_back(ZCNoteEncryption::generate_privkey(libzcash::random_uint252()));
+        decryptors.emplace_back(sk_encs.back());
+    }
+    // The same sk_enc as decryptors[0], with another pk_enc
+    decryptors.push_back(WrongPkNoteDecryption(sk_encs[0], ZCNoteEncryption::generate_pubkey(sk_encs[1])));
+    // A key nothing is sent to
+    decryptors.emplace_back(ZCNoteEncryption::generate_privkey(libzcash::random_uint252()));
+
+    ZCNoteEncryption::Plaintext message;
+    for (size_t i = 0; i < ZC_NOTEPLAINTEXT_SIZE; i++) {
+        message[i] = (unsigned char) i;
+    }
+
+    // JoinSplits with two outputs each, sent to the keys in turn and to
+    // a key outside the batch
+    std::vector<QueuedCiphertext> queued;
+    size_t nSent = 0;
+    for (size_t js = 0; js < 8; js++) {
+        uint256 hSig = libzcash::random_uint256();
+        ZCNoteEncryption enc(hSig);
+        for (unsigned char nonce = 0; nonce < 2; nonce++) {
+            const size_t k = (2 * js + nonce) % (sk_encs.size() + 1);
+            if (k < sk_encs.size()) {
+                nSent++;
+            }
+            const uint256 pk_enc = ZCNoteEncryption::generate_pubkey(
+                k < sk_encs.size() ? sk_encs[k] : libzcash::random_uint256());
+            message[0] = queued.size();
+            queued.push_back({enc.encrypt(pk_enc, message), enc.get_epk(), hSig, nonce});
+        }
+    }
+
+    // Copies that don't decrypt: a tampered ciphertext, another hSig and
+    // another nonce
+    queued.push_back(queued[0]);
+    queued.back().ciphertext[5] ^= 1;
+    queued.push_back(queued[1]);
+    queued.back().hSig = libzcash::random_uint256();
+    queued.push_back(queued[2]);
+    queued.back().nonce = 1;
+
+    // An epk without a DH secret, which decrypt() throws on
+    queued.push_back(queued[3]);
+    queued.back().epk = uint256();
+
+    ZCNoteDecryptionBatch batch;
+    for (const QueuedCiphertext& q : queued) {
+        batch.add(q.ciphertext, q.epk, q.hSig, q.nonce);
+    }
+    BOOST_CHECK_EQUAL(batch.size(), queued.size());
+
+    // Decrypt every pair one by one
+    std::vector<ZCNoteDecryptionBatch::Match> expected;
+    for (size_t i = 0; i < queued.size(); i++) {
+        for (size_t k = 0; k < decryptors.size(); k++) {
+            try {
+                ZCNoteDecryption::Plaintext plaintext = decryptors[k].decrypt(queued[i].ciphertext, queued[i].epk, queued[i].hSig, queued[i].nonce);
+                expected.push_back({i, k, plaintext});
+            } catch (const std::exception&) {
+            }
+        }
+    }
+    // Every note sent to one of the keys, and nothing else
+    BOOST_CHECK_EQUAL(expected.size(), nSent);
+    for (const ZCNoteDecryptionBatch::Match& match : expected) {
+        BOOST_CHECK(match.decryptor < sk_encs.size());
+        BOOST_CHECK_EQUAL(match.plaintext[0], match.ciphertext);
+    }
+
+    for (int nThreads : {1, 3, 0}) {
+        std::vector<ZCNoteDecryptionBatch::Match> matches = batch.decrypt(decryptors, nThreads);
+        BOOST_REQUIRE_EQUAL(matches.size(), expected.size());
+        for (size_t i = 0; i < matches.size(); i++) {
+            BOOST_CHECK_EQUAL(matches[i].ciphertext, expected[i].ciphertext);
+            BOOST_CHECK_EQUAL(matches[i].decryptor, expected[i].decryptor);
+            BOOST_CHECK(matches[i].plaintext == expected[i].plaintext);
+        }
+    }
+
+    BOOST_CHECK(batch.decrypt({}).empty());
+    BOOST_CHECK_THROW(decryptors[0].decrypt(queued.back().ciphertext, queued.back().epk, queued.back().hSig, queued.back().nonce), std::logic_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,178 @@
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <memusage.h>
+#include <pooledmap.h>
+
+#include <test/test_bitcoin.h>
+
+#include <map>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(pooledmap_tests, BasicTestingSetup)
+
+namespace {
+
+// Few distinct hashes, so that probes run through collisions and tombstones
+struct WeakHasher {
+    size_t operator()(uint64_t key) const { return (key % 13) * 0x9e3779b9; }
+};
+
+typedef pooled_hash_map<uint64_t, std::string, WeakHasher> TestMap;
+
+void CheckEqual(const TestMap& map, const std::map<uint64_t, std::string>& expected)
+{
+    BOOST_CHECK_EQUAL(map.size(), expected.size());
+    BOOST_CHECK_EQUAL(map.empty(), expected.empty());
+    size_t n = 0;
+    for (const auto& entry : map) {
+        auto it = expected.find(entry.first);
+        BOOST_CHECK(it != expected.end() && it->second == entry.second);
+        n++;
+    }
+    BOOST_CHECK_EQUAL(n, expected.size());
+    for (const auto& entry : expected) {
+        BOOST_CHECK_EQUAL(map.at(entry.first), entry.second);
+        BOOST_CHECK_EQUAL(map.count(entry.first), 1U);
+    }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(pooledmap_random)
+{
+    TestMap map;
+    std::map<uint64_t, std::string> expected;
+    for (int i = 0; i < 20000; i++) {
+        const uint64_t key = InsecureRandRange(500);
+        const std::string value = std::to_string(InsecureRand32());
+        switch (InsecureRandRange(8)) {
+        case 0:
+        case 1: {
+            auto inserted = map.emplace(key, value);
+            BOOST_CHECK_EQUAL(inserted.second, expected.emplace(key, value).second);
+            BOOST_CHECK_EQUAL(inserted.first->second, expected[key]);
+            break;
+        }
+        case 2:
+            map[key] = value;
+            expected[key] = value;
+            break;
+        case 3:
+            BOOST_CHECK_EQUAL(map.erase(key), expected.erase(key));
+            break;
+        case 4:
+            BOOST_CHECK_EQUAL(map.find(key) == map.end(), expected.count(key) == 0);
+            break;
+        case 5: {
+            // Erase some entries while iterating
+            for (auto it = map.begin(); it != map.end(); ) {
+                if (InsecureRandRange(16) == 0) {
+                    expected.erase(it->first);
+                    it = map.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            break;
+        }
+        case 6:
+            if (InsecureRandRange(100) == 0) {
+                map.clear();
+                expected.clear();
+            }
+            break;
+        case 7:
+            CheckEqual(map, expected);
+            break;
+        }
+    }
+    CheckEqual(map, expected);
+
+    TestMap moved(std::move(map));
+    CheckEqual(moved, expected);
+    BOOST_CHECK(map.empty());
+}
+
+BOOST_AUTO_TEST_CASE(pooledmap_stable_references)
+{
+    TestMap map;
+    std::string* first = &map[0];
+    *first = "first";
+    // Rehashes many times over, without moving the entry
+    for (uint64_t key = 1; key < 5000; key++) {
+        map.emplace(key, std::to_string(key));
+    }
+    BOOST_CHECK_EQUAL(first, &map.at(0));
+    BOOST_CHECK_EQUAL(*first, "first");
+
+    // Erasing everything keeps the chunks for the next entries
+    const size_t chunks = map.allocated_chunks();
+    for (auto it = map.begin(); it != map.end(); ) {
+        map.erase(it++);
+    }
+    BOOST_CHECK(map.empty());
+    for (uint64_t key = 0; key < 5000; key++) {
+        map.emplace(key, std::to_string(key));
+    }
+    BOOST_CHECK_EQUAL(map.size(), 5000U);
+    BOOST_CHECK_EQUAL(map.allocated_chunks(), chunks);
+
+    map.clear();
+    BOOST_CHECK_EQUAL(map.allocated_chunks(), 0U);
+    BOOST_CHECK_EQUAL(map.bucket_count(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(pooledmap_shrink_to_fit)
+{
+    TestMap map;
+    std::map<uint64_t, std::string> expected;
+    for (uint64_t key = 0; key < 5000; key++) {
+        map.emplace(key, std::to_string(key));
+        expected.emplace(key, std::to_string(key));
+    }
+    map.shrink_to_fit();
+    CheckEqual(map, expected);
+
+    // Erasing most entries frees nothing until the map is shrunk
+    const size_t chunks = map.allocated_chunks();
+    const size_t buckets = map.bucket_count();
+    for (uint64_t key = 0; key < 5000; key++) {
+        if (key % 10 != 0) {
+            map.erase(key);
+            expected.erase(key);
+        }
+    }
+    BOOST_CHECK_EQUAL(map.allocated_chunks(), chunks);
+    BOOST_CHECK_EQUAL(map.bucket_count(), buckets);
+    BOOST_CHECK(memusage::ShrunkDynamicUsage(map) < memusage::DynamicUsage(map));
+
+    const size_t usage = memusage::ShrunkDynamicUsage(map);
+    map.shrink_to_fit();
+    CheckEqual(map, expected);
+    BOOST_CHECK_EQUAL(map.allocated_chunks(), TestMap::chunks_for(500));
+    BOOST_CHECK_EQUAL(map.bucket_count(), TestMap::table_size_for(500));
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), usage);
+
+    // The shrunk map carries on as usual
+    for (uint64_t key = 5000; key < 6000; key++) {
+        map.emplace(key, std::to_string(key));
+        expected.emplace(key, std::to_string(key));
+    }
+    map.erase(10);
+    expected.erase(10);
+    CheckEqual(map, expected);
+
+    while (!map.empty()) {
+        map.erase(map.begin());
+    }
+    map.shrink_to_fit();
+    BOOST_CHECK_EQUAL(map.allocated_chunks(), 0U);
+    BOOST_CHECK_EQUAL(map.bucket_count(), 0U);
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
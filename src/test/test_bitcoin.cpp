@@ -6,9 +6,13 @@
 
 #include <chainparams.h>
 #include <consensus/consensus.h>
+#include <consensus/joinsplit.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
+#include <crypto/blake2b.h>
+#include <crypto/equihash.h>
 #include <crypto/sha256.h>
+#include <init.h>
 #include <miner.h>
 #include <net_processing.h>
 #include <pow.h>
@@ -54,12 +58,14 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     assert(init_and_check_sodium() != -1);
 
     SHA256AutoDetect();
+    Blake2bAutoDetect();
     RandomInit();
     ECC_Start();
     SetupEnvironment();
     SetupNetworking();
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitJoinSplitCache();
     fCheckBlockIndex = true;
     // CreateAndProcessBlock() does not support building SegWit blocks, so don't activate in these tests.
     // TODO: fix the code to support SegWit blocks.
@@ -100,7 +106,8 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         mempool.setSanityCheck(1.0);
         pblocktree.reset(new CBlockTreeDB(1 << 20, true));
         pcoinsdbview.reset(new CCoinsViewDB(1 << 23, true));
-        pcoinsTip.reset(new CCoinsViewCache(pcoinsdbview.get()));
+        pcoinsflush.reset(new CCoinsViewBackgroundFlush(pcoinsdbview.get()));
+        pcoinsTip.reset(new CCoinsViewCache(pcoinsflush.get()));
         if (!LoadGenesisBlock(chainparams)) {
             throw std::runtime_error("LoadGenesisBlock failed.");
         }
@@ -113,6 +120,10 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         nScriptCheckThreads = 3;
         for (int i=0; i < nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i=0; i < nScriptCheckThreads/2; i++)
+            threadGroup.create_thread(&ThreadJoinSplitCheck);
+        for (int i=0; i < nScriptCheckThreads/2; i++)
+            threadGroup.create_thread(&ThreadHeaderCheck);
         g_connman = MakeUnique<CConnman>(0x1337, 0x1337); // Deterministic randomness for tests.
         connman = g_connman.get();
         peerLogic.reset(new PeerLogicValidation(connman, scheduler, /*enable_bip61=*/true));
@@ -128,10 +139,34 @@ TestingSetup::~TestingSetup()
         peerLogic.reset();
         UnloadBlockIndex();
         pcoinsTip.reset();
+        pcoinsflush.reset();
         pcoinsdbview.reset();
         pblocktree.reset();
 }
 
+void SolveEquihash(CBlockHeader& block, const CChainParams& chainparams)
+{
+    const unsigned int n = chainparams.EquihashN();
+    const unsigned int k = chainparams.EquihashK();
+    bool fFound = false;
+    std::function<bool(std::vector<unsigned char>)> validBlock =
+        [&](std::vector<unsigned char> soln) {
+        block.nSolution = soln;
+        fFound = CheckProofOfWork(block.GetHash(), block.nBits, chainparams.GetConsensus());
+        return fFound;
+    };
+    while (!fFound) {
+        block.nNonce = ArithToUint256(UintToArith256(block.nNonce) + 1);
+
+        eh_HashState eh_state;
+        EhInitialiseState(n, k, eh_state);
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << CEquihashInput{block} << block.nNonce;
+        eh_state.Update((unsigned char*)&ss[0], ss.size());
+        EhBasicSolveUncancellable(n, k, eh_state, validBlock);
+    }
+}
+
 TestChain100Setup::TestChain100Setup() : TestingSetup(CBaseChainParams::REGTEST)
 {
     // Generate a 100-block chain:
@@ -167,9 +202,7 @@ TestChain100Setup::CreateAndProcessBlock(const std::vector<CMutableTransaction>&
         IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
     }
 
-    while (!CheckProofOfWork(block.GetHash(), block.nBits, chainparams.GetConsensus())) {
-        block.nNonce = ArithToUint256(UintToArith256(block.nNonce) + 1);
-    }
+    SolveEquihash(block, chainparams);
 
     std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(block);
     ProcessNewBlock(chainparams, shared_pblock, true, nullptr);
@@ -182,6 +215,18 @@ TestChain100Setup::~TestChain100Setup()
 {
 }
 
+JoinSplitTestingSetup::JoinSplitTestingSetup()
+{
+    fs::path pk_path = ZC_GetParamsDir() / "sprout-proving.key";
+    fs::path vk_path = ZC_GetParamsDir() / "sprout-verifying.key";
+    pzcashParams.reset(ZCJoinSplit::Prepared(vk_path.string(), pk_path.string()));
+}
+
+JoinSplitTestingSetup::~JoinSplitTestingSetup()
+{
+    pzcashParams.reset();
+}
+
 
 CTxMemPoolEntry TestMemPoolEntryHelper::FromTx(const CMutableTransaction &tx) {
     return FromTx(MakeTransactionRef(tx));
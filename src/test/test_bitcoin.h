@@ -76,9 +76,17 @@ struct TestingSetup: public BasicTestingSetup {
 };
 
 class CBlock;
+class CBlockHeader;
+class CChainParams;
 struct CMutableTransaction;
 class CScript;
 
+/**
+ * Try the nonces after block.nNonce until one has an Equihash solution
+ * meeting block's target, and set block's nNonce and nSolution to them.
+ */
+void SolveEquihash(CBlockHeader& block, const CChainParams& chainparams);
+
 //
 // Testing fixture that pre-creates a
 // 100-block REGTEST-mode block chain
@@ -97,6 +105,15 @@ struct TestChain100Setup : public TestingSetup {
     CKey coinbaseKey; // private/public key needed to spend coinbase transactions
 };
 
+/**
+ * Testing fixture that also loads the Sprout JoinSplit parameters into
+ * pzcashParams, for the tests creating or verifying JoinSplits.
+ */
+struct JoinSplitTestingSetup : public TestChain100Setup {
+    JoinSplitTestingSetup();
+    ~JoinSplitTestingSetup();
+};
+
 class CTxMemPoolEntry;
 
 struct TestMemPoolEntryHelper
@@ -71,9 +71,7 @@ std::shared_ptr<CBlock> FinalizeBlock(std::shared_ptr<CBlock> pblock)
 {
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 
-    while (!CheckProofOfWork(pblock->GetHash(), pblock->nBits, Params().GetConsensus())) {
-        pblock->nNonce = ArithToUint256(UintToArith256(pblock->nNonce) + 1);
-    }
+    SolveEquihash(*pblock, Params());
 
     return pblock;
 }
@@ -181,4 +179,33 @@ BOOST_AUTO_TEST_CASE(processnewblock_signals_ordering)
     BOOST_CHECK_EQUAL(sub.m_expected_tip, chainActive.Tip()->GetBlockHash());
 }
 
+BOOST_AUTO_TEST_CASE(processnewblockheaders_invalid_solution)
+{
+    // The solutions of a batch of new headers are checked on the header check
+    // queue, in rounds. One bad solution, in the first round or a later one,
+    // must still get the batch rejected at that header.
+    for (size_t nBad : {0, 150}) {
+        std::vector<CBlockHeader> headers;
+        uint256 prev_hash = Params().GenesisBlock().GetHash();
+        for (size_t i = 0; i < 160; i++) {
+            headers.push_back(GoodBlock(prev_hash)->GetBlockHeader());
+            prev_hash = headers.back().GetHash();
+        }
+        headers[nBad].nSolution[0] ^= 1;
+
+        CValidationState state;
+        CBlockHeader first_invalid;
+        BOOST_CHECK(!ProcessNewBlockHeaders(headers, state, Params(), nullptr, &first_invalid));
+        int nDoS = 0;
+        BOOST_CHECK(state.IsInvalid(nDoS) && nDoS == 100);
+        BOOST_CHECK_EQUAL(state.GetRejectReason(), "invalid-solution");
+        BOOST_CHECK_EQUAL(first_invalid.GetHash(), headers[nBad].GetHash());
+
+        LOCK(cs_main);
+        BOOST_CHECK(LookupBlockIndex(headers[nBad].GetHash()) == nullptr);
+        if (nBad > 0)
+            BOOST_CHECK(LookupBlockIndex(headers[nBad - 1].GetHash()) != nullptr);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -21,6 +21,7 @@
 static const char DB_COIN = 'C';
 static const char DB_NULLIFIER = 's';
 static const char DB_ANCHOR = 'A';
+static const char DB_ANCHOR_DELTA = 'D';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_BLOCK_INDEX = 'b';
@@ -31,6 +32,7 @@ static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_VERSION = 'V';
 
 namespace {
 
@@ -54,12 +56,60 @@ struct CoinEntry {
     }
 };
 
+/** An anchor stored as the commitments appended to the tree of an earlier one */
+struct AnchorDelta {
+    uint256 prevRoot;
+    std::vector<uint256> commitments;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(prevRoot);
+        READWRITE(commitments);
+    }
+};
+
+/**
+ * Whether to store the full tree of an anchor rather than a delta: when it
+ * isn't known how it was derived, or it starts a new checkpoint interval. This
+ * bounds the number of commitments to replay to ANCHOR_CHECKPOINT_INTERVAL.
+ */
+bool IsAnchorCheckpoint(const CAnchorsCacheEntry& entry)
+{
+    const uint64_t nSize = entry.tree.size();
+    if (entry.prevRoot.IsNull() || entry.commitments.empty() || entry.commitments.size() > nSize) {
+        return true;
+    }
+    return nSize / ANCHOR_CHECKPOINT_INTERVAL != (nSize - entry.commitments.size()) / ANCHOR_CHECKPOINT_INTERVAL;
+}
+
 }
 
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true)
 {
 }
 
+bool CCoinsViewDB::CheckVersion()
+{
+    int nVersion = 0;
+    if (db.Read(DB_VERSION, nVersion)) {
+        if (nVersion != COINS_DB_VERSION) {
+            LogPrintf("%s: chainstate database version %d, expected %d\n", __func__, nVersion, COINS_DB_VERSION);
+            return false;
+        }
+        return true;
+    }
+    // A non-empty database without a version was written by an earlier
+    // release. Rather than mixing in anchor deltas that it can't read, have
+    // the database rebuilt.
+    if (!GetBestBlock().IsNull() || !GetHeadBlocks().empty()) {
+        LogPrintf("%s: chainstate database has no version, expected %d\n", __func__, COINS_DB_VERSION);
+        return false;
+    }
+    return db.Write(DB_VERSION, COINS_DB_VERSION, true);
+}
+
 bool CCoinsViewDB::GetAnchorAt(const uint256 &rt, ZCIncrementalMerkleTree &tree) const {
     if (rt == ZCIncrementalMerkleTree::empty_root()) {
         ZCIncrementalMerkleTree new_tree;
@@ -67,9 +117,22 @@ bool CCoinsViewDB::GetAnchorAt(const uint256 &rt, ZCIncrementalMerkleTree &tree)
         return true;
     }
 
-    bool read = db.Read(std::make_pair(DB_ANCHOR, rt), tree);
+    if (db.Read(std::make_pair(DB_ANCHOR, rt), tree)) {
+        return true;
+    }
 
-    return read;
+    // Rebuild the tree from the last checkpoint
+    AnchorDelta delta;
+    if (!db.Read(std::make_pair(DB_ANCHOR_DELTA, rt), delta) || !GetAnchorAt(delta.prevRoot, tree)) {
+        return false;
+    }
+    for (const uint256& commitment : delta.commitments) {
+        tree.append(commitment);
+    }
+    if (tree.root() != rt) {
+        return error("%s: anchor %s does not match its stored delta", __func__, rt.ToString());
+    }
+    return true;
 }
 
 bool CCoinsViewDB::GetNullifier(const uint256 &nf) const {
@@ -114,6 +177,18 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
                               const uint256 &hashAnchor,
                               CAnchorsMap &mapAnchors,
                               CNullifiersMap &mapNullifiers) {
+    bool ret = WriteChanges(mapCoins, hashBlock, hashAnchor, mapAnchors, mapNullifiers);
+    mapCoins.clear();
+    mapAnchors.clear();
+    mapNullifiers.clear();
+    return ret;
+}
+
+bool CCoinsViewDB::WriteChanges(const CCoinsMap &mapCoins,
+                                const uint256 &hashBlock,
+                                const uint256 &hashAnchor,
+                                const CAnchorsMap &mapAnchors,
+                                const CNullifiersMap &mapNullifiers) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -138,7 +213,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); ++it) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             CoinEntry entry(&it->first);
             if (it->second.coin.IsSpent())
@@ -148,8 +223,6 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -164,27 +237,28 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
         }
     }
 
-    for (CAnchorsMap::iterator it = mapAnchors.begin(); it != mapAnchors.end();) {
+    for (CAnchorsMap::const_iterator it = mapAnchors.begin(); it != mapAnchors.end(); ++it) {
         if (it->second.flags & CAnchorsCacheEntry::DIRTY) {
-            if (!it->second.entered)
+            if (!it->second.entered) {
                 batch.Erase(std::make_pair(DB_ANCHOR, it->first));
-            else {
+                batch.Erase(std::make_pair(DB_ANCHOR_DELTA, it->first));
+            } else if (IsAnchorCheckpoint(it->second)) {
                 batch.Write(std::make_pair(DB_ANCHOR, it->first), it->second.tree);
+                batch.Erase(std::make_pair(DB_ANCHOR_DELTA, it->first));
+            } else {
+                batch.Write(std::make_pair(DB_ANCHOR_DELTA, it->first), AnchorDelta{it->second.prevRoot, it->second.commitments});
+                batch.Erase(std::make_pair(DB_ANCHOR, it->first));
             }
         }
-        CAnchorsMap::iterator itOld = it++;
-        mapAnchors.erase(itOld);
     }
 
-    for (CNullifiersMap::iterator it = mapNullifiers.begin(); it != mapNullifiers.end();) {
+    for (CNullifiersMap::const_iterator it = mapNullifiers.begin(); it != mapNullifiers.end(); ++it) {
         if (it->second.flags & CNullifiersCacheEntry::DIRTY) {
             if (!it->second.entered)
                 batch.Erase(std::make_pair(DB_NULLIFIER, it->first));
             else
                 batch.Write(std::make_pair(DB_NULLIFIER, it->first), true);
         }
-        CNullifiersMap::iterator itOld = it++;
-        mapNullifiers.erase(itOld);
     }
 
     // In the last batch, mark the database as consistent with hashBlock again.
@@ -204,6 +278,156 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsViewDB* dbIn) : CCoinsViewBacked(dbIn), db(dbIn), fFailed(false), fStop(false)
+{
+    threadFlush = std::thread(&TraceThread<std::function<void()>>, "dbflush",
+                              std::function<void()>(std::bind(&CCoinsViewBackgroundFlush::ThreadFlush, this)));
+}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush()
+{
+    {
+        boost::unique_lock<boost::shared_mutex> lock(mutex);
+        fStop = true;
+    }
+    condFlushed.notify_all();
+    // The thread writes the last snapshot out before it stops
+    threadFlush.join();
+}
+
+bool CCoinsViewBackgroundFlush::GetAnchorAt(const uint256 &rt, ZCIncrementalMerkleTree &tree) const {
+    {
+        boost::shared_lock<boost::shared_mutex> lock(mutex);
+        if (snapshot) {
+            CAnchorsMap::const_iterator it = snapshot->mapAnchors.find(rt);
+            if (it != snapshot->mapAnchors.end()) {
+                if (!it->second.entered)
+                    return false;
+                tree = it->second.tree;
+                return true;
+            }
+        }
+    }
+    return base->GetAnchorAt(rt, tree);
+}
+
+bool CCoinsViewBackgroundFlush::GetNullifier(const uint256 &nf) const {
+    {
+        boost::shared_lock<boost::shared_mutex> lock(mutex);
+        if (snapshot) {
+            CNullifiersMap::const_iterator it = snapshot->mapNullifiers.find(nf);
+            if (it != snapshot->mapNullifiers.end())
+                return it->second.entered;
+        }
+    }
+    return base->GetNullifier(nf);
+}
+
+bool CCoinsViewBackgroundFlush::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    {
+        boost::shared_lock<boost::shared_mutex> lock(mutex);
+        if (snapshot) {
+            CCoinsMap::const_iterator it = snapshot->mapCoins.find(outpoint);
+            if (it != snapshot->mapCoins.end()) {
+                coin = it->second.coin;
+                return !coin.IsSpent();
+            }
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoin(const COutPoint &outpoint) const {
+    {
+        boost::shared_lock<boost::shared_mutex> lock(mutex);
+        if (snapshot) {
+            CCoinsMap::const_iterator it = snapshot->mapCoins.find(outpoint);
+            if (it != snapshot->mapCoins.end())
+                return !it->second.coin.IsSpent();
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const {
+    // The database has no best block while a snapshot is being written
+    boost::shared_lock<boost::shared_mutex> lock(mutex);
+    if (snapshot)
+        return snapshot->hashBlock;
+    return base->GetBestBlock();
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestAnchor() const {
+    boost::shared_lock<boost::shared_mutex> lock(mutex);
+    if (snapshot && !snapshot->hashAnchor.IsNull())
+        return snapshot->hashAnchor;
+    return base->GetBestAnchor();
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap &mapCoins,
+                                           const uint256 &hashBlock,
+                                           const uint256 &hashAnchor,
+                                           CAnchorsMap &mapAnchors,
+                                           CNullifiersMap &mapNullifiers) {
+    std::unique_ptr<const Snapshot> next(new Snapshot{std::move(mapCoins), std::move(mapAnchors), std::move(mapNullifiers), hashBlock, hashAnchor});
+
+    boost::unique_lock<boost::shared_mutex> lock(mutex);
+    while (snapshot && !fFailed)
+        condFlushed.wait(lock);
+    if (fFailed)
+        return false;
+    snapshot = std::move(next);
+    condFlushed.notify_all();
+    return true;
+}
+
+bool CCoinsViewBackgroundFlush::WaitForFlush() {
+    boost::unique_lock<boost::shared_mutex> lock(mutex);
+    while (snapshot && !fFailed)
+        condFlushed.wait(lock);
+    return !fFailed;
+}
+
+void CCoinsViewBackgroundFlush::ThreadFlush()
+{
+    boost::unique_lock<boost::shared_mutex> lock(mutex);
+    while (true) {
+        while (!fStop && (!snapshot || fFailed))
+            condFlushed.wait(lock);
+        if (!snapshot || fFailed)
+            return;
+
+        // Nothing changes the snapshot until it is released below, and
+        // readers only look into it.
+        const Snapshot& flush = *snapshot;
+        lock.unlock();
+        int64_t nStart = GetTimeMicros();
+        bool fOk = false;
+        try {
+            fOk = db->WriteChanges(flush.mapCoins, flush.hashBlock, flush.hashAnchor, flush.mapAnchors, flush.mapNullifiers);
+        } catch (const std::runtime_error& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        LogPrint(BCLog::COINDB, "Wrote the coins snapshot of block %s in the background: %.2fms\n", flush.hashBlock.ToString(), (GetTimeMicros() - nStart) * 0.001);
+        lock.lock();
+
+        std::unique_ptr<const Snapshot> done;
+        if (fOk) {
+            done = std::move(snapshot);
+        } else {
+            // Keep serving reads from the snapshot, and fail the next flush
+            LogPrintf("%s: failed to write to coin database\n", __func__);
+            fFailed = true;
+        }
+        condFlushed.notify_all();
+
+        // Free the entries without holding up readers
+        lock.unlock();
+        done.reset();
+        lock.lock();
+    }
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe) {
 }
 
@@ -211,6 +435,10 @@ bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
     return Read(std::make_pair(DB_BLOCK_FILES, nFile), info);
 }
 
+bool CBlockTreeDB::ReadDiskBlockIndex(const uint256 &blockhash, CDiskBlockIndex &diskindex) {
+    return Read(std::make_pair(DB_BLOCK_INDEX, blockhash), diskindex);
+}
+
 bool CBlockTreeDB::WriteReindexing(bool fReindexing) {
     if (fReindexing)
         return Write(DB_REINDEX_FLAG, '1');
@@ -331,9 +559,10 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
                 pindexNew->nTime          = diskindex.nTime;
                 pindexNew->nBits          = diskindex.nBits;
                 pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nSolution      = diskindex.nSolution;
                 pindexNew->nStatus        = diskindex.nStatus;
                 pindexNew->nTx            = diskindex.nTx;
+                // The Equihash solution is only read back on demand
+                pindexNew->TrimSolution();
 
                 if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, consensusParams))
                     return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
@@ -14,9 +14,13 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
 class CBlockIndex;
 class CCoinsViewDBCursor;
 class uint256;
@@ -39,6 +43,14 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Store a full anchor tree whenever the note commitment tree size crosses a
+//! multiple of this; the anchors in between are stored as the commitments
+//! appended since the previous anchor.
+static const uint64_t ANCHOR_CHECKPOINT_INTERVAL = 64;
+//! Format version of the coin database, to be bumped whenever earlier versions
+//! can't read what this one writes.
+//! 1: anchors stored as deltas (DB_ANCHOR_DELTA) between checkpoints
+static const int COINS_DB_VERSION = 1;
 
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB final : public CCoinsView
@@ -60,13 +72,80 @@ public:
                     const uint256 &hashAnchor,
                     CAnchorsMap &mapAnchors,
                     CNullifiersMap &mapNullifiers);
+    //! Write the changes in the maps, like BatchWrite, but leave them as they are.
+    bool WriteChanges(const CCoinsMap &mapCoins,
+                      const uint256 &hashBlock,
+                      const uint256 &hashAnchor,
+                      const CAnchorsMap &mapAnchors,
+                      const CNullifiersMap &mapNullifiers);
     CCoinsViewCursor *Cursor() const override;
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
+    //! Check that the database is in the COINS_DB_VERSION format, marking an
+    //! empty one as such. Returns false if it has to be rebuilt.
+    bool CheckVersion();
     size_t EstimateSize() const override;
 };
 
+/**
+ * CCoinsView between the coins cache and the coin database, which writes
+ * flushes in the background.
+ *
+ * BatchWrite takes the flushed entries over as a snapshot, which a thread
+ * writes to the database while validation goes on against the emptied cache
+ * above; reads look in the snapshot before the database. One snapshot is
+ * written at a time, so a flush first waits for the previous one. Until the
+ * snapshot is written in full, DB_HEAD_BLOCKS marks the database as being
+ * between the two blocks, so that a crash meanwhile is recovered from by
+ * replaying blocks, as after an interrupted synchronous flush.
+ *
+ * Cursor() reads the database alone: call WaitForFlush first.
+ */
+class CCoinsViewBackgroundFlush final : public CCoinsViewBacked
+{
+public:
+    explicit CCoinsViewBackgroundFlush(CCoinsViewDB* dbIn);
+    ~CCoinsViewBackgroundFlush();
+
+    bool GetAnchorAt(const uint256 &rt, ZCIncrementalMerkleTree &tree) const override;
+    bool GetNullifier(const uint256 &nf) const override;
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    uint256 GetBestAnchor() const override;
+    bool BatchWrite(CCoinsMap &mapCoins,
+                    const uint256 &hashBlock,
+                    const uint256 &hashAnchor,
+                    CAnchorsMap &mapAnchors,
+                    CNullifiersMap &mapNullifiers) override;
+
+    //! Wait until the snapshot being written, if any, is in the database.
+    //! Returns false if writing it failed.
+    bool WaitForFlush();
+
+private:
+    struct Snapshot {
+        CCoinsMap mapCoins;
+        CAnchorsMap mapAnchors;
+        CNullifiersMap mapNullifiers;
+        uint256 hashBlock;
+        uint256 hashAnchor;
+    };
+
+    CCoinsViewDB* db;
+    //! Guards the members below. Readers of the snapshot share it.
+    mutable boost::shared_mutex mutex;
+    boost::condition_variable_any condFlushed;
+    //! The flush being written, until it is in the database
+    std::unique_ptr<const Snapshot> snapshot;
+    bool fFailed;
+    bool fStop;
+    std::thread threadFlush;
+
+    void ThreadFlush();
+};
+
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
 class CCoinsViewDBCursor: public CCoinsViewCursor
 {
@@ -97,6 +176,7 @@ public:
 
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &info);
+    bool ReadDiskBlockIndex(const uint256 &blockhash, CDiskBlockIndex &diskindex);
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindexing);
     void ReadReindexing(bool &fReindexing);
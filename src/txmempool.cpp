@@ -381,6 +381,11 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
         mapNextTx.insert(std::make_pair(&tx.vin[i].prevout, &tx));
         setParentTransactions.insert(tx.vin[i].prevout.hash);
     }
+    for (const JSDescription& joinsplit : tx.vjoinsplit) {
+        for (const uint256& nf : joinsplit.nullifiers) {
+            mapNullifiers.insert(std::make_pair(nf, &tx));
+        }
+    }
     // Don't bother worrying about child transactions of this one.
     // Normal case of a new transaction arriving is that there can't be any
     // children, because such children would be orphans.
@@ -409,6 +414,11 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     const uint256 hash = it->GetTx().GetHash();
     for (const CTxIn& txin : it->GetTx().vin)
         mapNextTx.erase(txin.prevout);
+    for (const JSDescription& joinsplit : it->GetTx().vjoinsplit) {
+        for (const uint256& nf : joinsplit.nullifiers) {
+            mapNullifiers.erase(nf);
+        }
+    }
 
     if (vTxHashes.size() > 1) {
         vTxHashes[it->vTxHashesIdx] = std::move(vTxHashes.back());
@@ -541,6 +551,21 @@ void CTxMemPool::removeConflicts(const CTransaction &tx)
             }
         }
     }
+
+    // Remove transactions which reveal the same nullifiers as tx, recursively
+    for (const JSDescription& joinsplit : tx.vjoinsplit) {
+        for (const uint256& nf : joinsplit.nullifiers) {
+            auto it = mapNullifiers.find(nf);
+            if (it != mapNullifiers.end()) {
+                const CTransaction &txConflict = *it->second;
+                if (txConflict != tx)
+                {
+                    ClearPrioritisation(txConflict.GetHash());
+                    removeRecursive(txConflict, MemPoolRemovalReason::CONFLICT);
+                }
+            }
+        }
+    }
 }
 
 /**
@@ -580,6 +605,7 @@ void CTxMemPool::_clear()
     mapLinks.clear();
     mapTx.clear();
     mapNextTx.clear();
+    mapNullifiers.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
     lastRollingFeeUpdate = GetTime();
@@ -622,6 +648,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins, const CChainParams& chainp
     CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(pcoins));
     const int64_t spendheight = GetSpendHeight(mempoolDuplicate);
 
+    uint64_t nNullifiersCheck = 0;
     std::list<const CTxMemPoolEntry*> waitingOnDependants;
     for (indexed_transaction_set::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
         unsigned int i = 0;
@@ -652,6 +679,17 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins, const CChainParams& chainp
             assert(it3->second == &tx);
             i++;
         }
+        for (const JSDescription& joinsplit : tx.vjoinsplit) {
+            for (const uint256& nf : joinsplit.nullifiers) {
+                // Check that the nullifier isn't spent in the chain, and is
+                // marked in mapNullifiers.
+                assert(!pcoins->GetNullifier(nf));
+                auto it3 = mapNullifiers.find(nf);
+                assert(it3 != mapNullifiers.end());
+                assert(it3->second == &tx);
+                nNullifiersCheck++;
+            }
+        }
         assert(setParentCheck == GetMemPoolParents(it));
         // Verify ancestor state is correct.
         setEntries setAncestors;
@@ -716,6 +754,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins, const CChainParams& chainp
         assert(it2 != mapTx.end());
         assert(&tx == it->second);
     }
+    assert(mapNullifiers.size() == nNullifiersCheck);
 
     assert(totalTxSize == checkTotal);
     assert(innerUsage == cachedInnerUsage);
@@ -867,6 +906,12 @@ const CTransaction* CTxMemPool::GetConflictTx(const COutPoint& prevout) const
     return it == mapNextTx.end() ? nullptr : it->second;
 }
 
+const CTransaction* CTxMemPool::GetNullifierConflictTx(const uint256& nullifier) const
+{
+    const auto it = mapNullifiers.find(nullifier);
+    return it == mapNullifiers.end() ? nullptr : it->second;
+}
+
 boost::optional<CTxMemPool::txiter> CTxMemPool::GetIter(const uint256& txid) const
 {
     auto it = mapTx.find(txid);
@@ -913,7 +958,7 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapNullifiers) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) {
@@ -9,6 +9,7 @@
 #include <memory>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 #include <string>
@@ -520,6 +521,8 @@ private:
 
 public:
     indirectmap<COutPoint, const CTransaction*> mapNextTx GUARDED_BY(cs);
+    /** The in-mempool transaction revealing each JoinSplit nullifier */
+    std::unordered_map<uint256, const CTransaction*, SaltedTxidHasher> mapNullifiers GUARDED_BY(cs);
     std::map<uint256, CAmount> mapDeltas;
 
     /** Create a new CTxMemPool.
@@ -528,8 +531,9 @@ public:
 
     /**
      * If sanity-checking is turned on, check makes sure the pool is
-     * consistent (does not contain two transactions that spend the same inputs,
-     * all inputs are in the mapNextTx array). If sanity-checking is turned off,
+     * consistent (does not contain two transactions that spend the same inputs
+     * or nullifiers, all inputs are in the mapNextTx array and all nullifiers
+     * in the mapNullifiers array). If sanity-checking is turned off,
      * check does nothing.
      */
     void check(const CCoinsViewCache *pcoins, const CChainParams& chainparams) const;
@@ -571,6 +575,9 @@ public:
     /** Get the transaction in the pool that spends the same prevout */
     const CTransaction* GetConflictTx(const COutPoint& prevout) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    /** Get the transaction in the pool that reveals the same JoinSplit nullifier */
+    const CTransaction* GetNullifierConflictTx(const uint256& nullifier) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     /** Returns an iterator to the given hash, if found */
     boost::optional<txiter> GetIter(const uint256& txid) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -11,6 +11,7 @@
 #include <checkpoints.h>
 #include <checkqueue.h>
 #include <consensus/consensus.h>
+#include <consensus/joinsplit.h>
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
@@ -165,7 +166,7 @@ public:
      * If a block header hasn't already been seen, call CheckBlockHeader on it, ensure
      * that it doesn't descend from an invalid block, and then add it to mapBlockIndex.
      */
-    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckEquihash = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Block (dis)connection on a given view:
@@ -222,6 +223,7 @@ Mutex g_best_block_mutex;
 std::condition_variable g_best_block_cv;
 uint256 g_best_block;
 int nScriptCheckThreads = 0;
+int nPrefetchThreads = 0;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fHavePruned = false;
@@ -231,6 +233,7 @@ bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 size_t nCoinCacheUsage = 5000 * 300;
+bool fCoinCacheEvict = DEFAULT_DBCACHE_EVICT;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 bool fEnableReplacement = DEFAULT_ENABLE_REPLACEMENT;
@@ -295,6 +298,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 std::unique_ptr<CCoinsViewDB> pcoinsdbview;
+std::unique_ptr<CCoinsViewBackgroundFlush> pcoinsflush;
 std::unique_ptr<CCoinsViewCache> pcoinsTip;
 std::unique_ptr<CBlockTreeDB> pblocktree;
 
@@ -640,6 +644,16 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         }
     }
 
+    // Shielded spends can't be replaced: reject any transaction revealing a
+    // nullifier that an in-mempool transaction already reveals
+    for (const JSDescription &joinsplit : tx.vjoinsplit) {
+        for (const uint256 &nf : joinsplit.nullifiers) {
+            if (pool.GetNullifierConflictTx(nf)) {
+                return state.Invalid(false, REJECT_DUPLICATE, "txn-mempool-conflict");
+            }
+        }
+    }
+
     {
         CCoinsView dummy;
         CCoinsViewCache view(&dummy);
@@ -669,6 +683,11 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             }
         }
 
+        // are the joinsplit's requirements met? This caches their anchors
+        // in view, which CheckTxInputs needs once the backend is gone
+        if (!view.HaveJoinSplitRequirements(tx))
+            return state.Invalid(false, REJECT_DUPLICATE, "bad-txns-joinsplit-requirements-not-met");
+
         // Bring the best block into scope
         view.GetBestBlock();
 
@@ -904,6 +923,11 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             return false; // state filled in by CheckInputs
         }
 
+        // JoinSplit proofs are by far the most expensive check, so they go last.
+        if (!CheckTransactionJoinsplits(tx, state, scriptVerifyFlags, true)) {
+            return false; // state filled in by CheckTransactionJoinsplits
+        }
+
         // Check again against the current block tip's script verification
         // flags to cache our script execution flags. This is, of course,
         // useless if the next block has different script flags from the
@@ -1707,12 +1731,220 @@ static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, CValidationState&
 }
 
 static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+// A single proof takes milliseconds to verify, so hand them out one at a time.
+static CCheckQueue<CJoinSplitCheck> joinsplitcheckqueue(1);
 
 void ThreadScriptCheck() {
     RenameThread("bitcoin-scriptch");
     scriptcheckqueue.Thread();
 }
 
+void ThreadJoinSplitCheck() {
+    RenameThread("bitcoin-jscheck");
+    joinsplitcheckqueue.Thread();
+}
+
+namespace {
+
+/**
+ * Closure representing the Equihash solution check of one block header.
+ * The result is stored through pfValid rather than returned, so that one
+ * invalid header doesn't abort the checks of the others.
+ */
+class CEquihashCheck
+{
+private:
+    const CBlockHeader* pheader;
+    const CChainParams* pchainparams;
+    char* pfValid;
+
+public:
+    CEquihashCheck(): pheader(nullptr), pchainparams(nullptr), pfValid(nullptr) {}
+    CEquihashCheck(const CBlockHeader& headerIn, const CChainParams& chainparamsIn, char& fValidIn) :
+        pheader(&headerIn), pchainparams(&chainparamsIn), pfValid(&fValidIn) { }
+
+    bool operator()() {
+        *pfValid = CheckEquihashSolution(pheader, *pchainparams);
+        return true;
+    }
+
+    void swap(CEquihashCheck &check) {
+        std::swap(pheader, check.pheader);
+        std::swap(pchainparams, check.pchainparams);
+        std::swap(pfValid, check.pfValid);
+    }
+};
+
+} // namespace
+
+static CCheckQueue<CEquihashCheck> headercheckqueue(16);
+
+void ThreadHeaderCheck() {
+    RenameThread("bitcoin-hdrcheck");
+    headercheckqueue.Thread();
+}
+
+namespace {
+
+/**
+ * The coins spent by a block, and the nullifiers and anchors of its
+ * JoinSplits, as read from the coins database.
+ */
+struct CBlockPrefetch
+{
+    std::vector<COutPoint> vOutpoints;
+    std::vector<Coin> vCoins;
+    std::vector<uint256> vNullifiers;
+    std::vector<char> vSpent;
+    std::vector<uint256> vAnchors;
+    std::vector<ZCIncrementalMerkleTree> vTrees;
+    std::vector<char> vHaveTree;
+
+    size_t size() const { return vOutpoints.size() + vNullifiers.size() + vAnchors.size(); }
+
+    //! Make room for the results of the lookups
+    void Resize() {
+        vCoins.resize(vOutpoints.size());
+        vSpent.resize(vNullifiers.size());
+        vTrees.resize(vAnchors.size());
+        vHaveTree.resize(vAnchors.size());
+    }
+
+    //! Do the i-th lookup, counting coins, then nullifiers, then anchors
+    void Read(const CCoinsView& view, size_t i) {
+        if (i < vOutpoints.size()) {
+            // A coin that is not found is left spent
+            view.GetCoin(vOutpoints[i], vCoins[i]);
+            return;
+        }
+        i -= vOutpoints.size();
+        if (i < vNullifiers.size()) {
+            vSpent[i] = view.GetNullifier(vNullifiers[i]);
+            return;
+        }
+        i -= vNullifiers.size();
+        vHaveTree[i] = view.GetAnchorAt(vAnchors[i], vTrees[i]);
+    }
+};
+
+/**
+ * Closure representing a few of the lookups of a CBlockPrefetch. They are
+ * database reads, which are safe to run concurrently.
+ */
+class CPrefetchCheck
+{
+private:
+    const CCoinsView* pview;
+    CBlockPrefetch* pprefetch;
+    size_t nBegin;
+    size_t nEnd;
+
+public:
+    CPrefetchCheck(): pview(nullptr), pprefetch(nullptr), nBegin(0), nEnd(0) {}
+    CPrefetchCheck(const CCoinsView& viewIn, CBlockPrefetch& prefetchIn, size_t nBeginIn, size_t nEndIn) :
+        pview(&viewIn), pprefetch(&prefetchIn), nBegin(nBeginIn), nEnd(nEndIn) { }
+
+    bool operator()() {
+        for (size_t i = nBegin; i < nEnd; i++) {
+            pprefetch->Read(*pview, i);
+        }
+        return true;
+    }
+
+    void swap(CPrefetchCheck &check) {
+        std::swap(pview, check.pview);
+        std::swap(pprefetch, check.pprefetch);
+        std::swap(nBegin, check.nBegin);
+        std::swap(nEnd, check.nEnd);
+    }
+};
+
+} // namespace
+
+// Each check is a handful of lookups; hand them out one at a time so that
+// every thread keeps a read outstanding.
+static CCheckQueue<CPrefetchCheck> prefetchqueue(1);
+
+void ThreadPrefetch() {
+    RenameThread("bitcoin-prefetch");
+    prefetchqueue.Thread();
+}
+
+//! The number of lookups of one CPrefetchCheck
+static const size_t PREFETCH_CHECK_SIZE = 8;
+
+/**
+ * Read the coins a block spends, and the nullifiers and anchors of its
+ * JoinSplits, into pcoinsTip ahead of ConnectBlock. On a cold cache,
+ * ConnectBlock would read each of them from the database in turn; here
+ * they are read by the prefetch threads in parallel, without cs_main.
+ */
+static void PrefetchBlockInputs(const CBlock& block) LOCKS_EXCLUDED(cs_main)
+{
+    if (!nPrefetchThreads)
+        return;
+
+    // The block's own outputs are not in the database yet
+    std::set<uint256> setTxids;
+    for (const auto& tx : block.vtx) {
+        setTxids.insert(tx->GetHash());
+    }
+
+    CBlockPrefetch prefetch;
+    std::set<uint256> setAnchors;
+    const CCoinsView* pview;
+    uint256 hashBestBlock;
+    {
+        LOCK(cs_main);
+        if (!pcoinsTip || !pcoinsflush)
+            return;
+        pview = pcoinsflush.get();
+        for (const auto& tx : block.vtx) {
+            if (!tx->IsCoinBase()) {
+                for (const CTxIn& txin : tx->vin) {
+                    if (!setTxids.count(txin.prevout.hash) && !pcoinsTip->HaveCoinInCache(txin.prevout))
+                        prefetch.vOutpoints.push_back(txin.prevout);
+                }
+            }
+            for (const JSDescription& joinsplit : tx->vjoinsplit) {
+                prefetch.vNullifiers.insert(prefetch.vNullifiers.end(), joinsplit.nullifiers.begin(), joinsplit.nullifiers.end());
+                if (setAnchors.insert(joinsplit.anchor).second)
+                    prefetch.vAnchors.push_back(joinsplit.anchor);
+            }
+        }
+        hashBestBlock = pcoinsflush->GetBestBlock();
+    }
+    if (prefetch.size() == 0)
+        return;
+    prefetch.Resize();
+
+    std::vector<CPrefetchCheck> vChecks;
+    vChecks.reserve(prefetch.size() / PREFETCH_CHECK_SIZE + 1);
+    for (size_t i = 0; i < prefetch.size(); i += PREFETCH_CHECK_SIZE) {
+        vChecks.emplace_back(*pview, prefetch, i, std::min(prefetch.size(), i + PREFETCH_CHECK_SIZE));
+    }
+    CCheckQueueControl<CPrefetchCheck> control(&prefetchqueue);
+    control.Add(vChecks);
+    control.Wait();
+
+    LOCK(cs_main);
+    // If the cache was flushed meanwhile, what was read may be stale. The
+    // flushed state holds the same coins for the same best block.
+    if (!pcoinsTip || pcoinsflush.get() != pview || pcoinsflush->GetBestBlock() != hashBestBlock)
+        return;
+    for (size_t i = 0; i < prefetch.vOutpoints.size(); i++) {
+        if (!prefetch.vCoins[i].IsSpent())
+            pcoinsTip->AddPrefetchedCoin(prefetch.vOutpoints[i], std::move(prefetch.vCoins[i]));
+    }
+    for (size_t i = 0; i < prefetch.vNullifiers.size(); i++) {
+        pcoinsTip->AddPrefetchedNullifier(prefetch.vNullifiers[i], prefetch.vSpent[i]);
+    }
+    for (size_t i = 0; i < prefetch.vAnchors.size(); i++) {
+        if (prefetch.vHaveTree[i])
+            pcoinsTip->AddPrefetchedAnchor(prefetch.vAnchors[i], prefetch.vTrees[i]);
+    }
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1929,6 +2161,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     CBlockUndo blockundo;
 
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
+    CCheckQueueControl<CJoinSplitCheck> jscontrol(fScriptChecks && nScriptCheckThreads ? &joinsplitcheckqueue : nullptr);
 
     std::vector<int> prevheights;
     CAmount nFees = 0;
@@ -1947,6 +2180,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     // This should never fail: we should always be able to get the root
     // that is on the tip of our chain
     assert(view.GetAnchorAt(old_tree_root, tree));
+    // The commitments appended to it by this block
+    std::vector<uint256> vCommitments;
 
     {
         // Consistency check: the root of the tree we're given should
@@ -1956,6 +2191,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
+    std::vector<CJoinSplitCheck> vJoinSplitChecks;
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
@@ -2006,6 +2242,10 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
+
+            // Only collects the JoinSplit checks, they are run below
+            if (fScriptChecks)
+                CheckTransactionJoinsplits(tx, state, flags, fCacheResults, &vJoinSplitChecks);
         }
 
         CTxUndo undoDummy;
@@ -2015,17 +2255,27 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
 
         for(const JSDescription &joinsplit : tx.vjoinsplit) {
-            for(const uint256 &note_commitment : joinsplit.commitments) {
-                // Insert the note commitments into our temporary tree.
+            vCommitments.insert(vCommitments.end(), joinsplit.commitments.begin(), joinsplit.commitments.end());
+        }
+    }
 
-                tree.append(note_commitment);
-            }
+    // Batch verify the block's JoinSplit proofs, one batch per verification thread
+    CJoinSplitCheck::Batch(vJoinSplitChecks, std::max(nScriptCheckThreads, 1));
+    if (nScriptCheckThreads) {
+        jscontrol.Add(vJoinSplitChecks);
+    } else {
+        for (CJoinSplitCheck& check : vJoinSplitChecks) {
+            if (!check())
+                return state.DoS(100, error("ConnectBlock(): JoinSplit verification failed"),
+                                 REJECT_INVALID, check.IsSignatureCheck() ? "bad-txns-invalid-joinsplit-signature" : "bad-txns-joinsplit-verification-failed");
         }
     }
 
-    view.PushAnchor(tree);
+    // Insert the block's note commitments into our temporary tree.
+    tree.append_batch(std::vector<libzcash::SHA256Compress>(vCommitments.begin(), vCommitments.end()));
+    view.PushAnchor(tree, vCommitments);
     if (!fJustCheck) {
-        pindex->hashAnchorEnd = tree.root();
+        pindex->hashAnchorEnd = view.GetBestAnchor();
     }
     blockundo.old_tree_root = old_tree_root;
 
@@ -2043,6 +2293,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     if (!control.Wait())
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
+    if (!jscontrol.Wait())
+        return state.DoS(100, error("%s: JoinSplit CheckQueue failed", __func__), REJECT_INVALID, "bad-txns-joinsplit-verification-failed");
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
 
@@ -2078,6 +2330,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
  *
  * If FlushStateMode::NONE is used, then FlushStateToDisk(...) won't do anything
  * besides checking if we need to prune.
+ *
+ * The chainstate is written in the background by pcoinsflush, except with
+ * FlushStateMode::ALWAYS, which returns once it is on disk.
  */
 bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &state, FlushStateMode mode, int nManualPruneHeight) {
     int64_t nMempoolUsage = mempool.DynamicMemoryUsage();
@@ -2142,19 +2397,23 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                     vFiles.push_back(std::make_pair(*it, &vinfoBlockFile[*it]));
                     setDirtyFileInfo.erase(it++);
                 }
-                std::vector<const CBlockIndex*> vBlocks;
-                vBlocks.reserve(setDirtyBlockIndex.size());
-                for (std::set<CBlockIndex*>::iterator it = setDirtyBlockIndex.begin(); it != setDirtyBlockIndex.end(); ) {
-                    vBlocks.push_back(*it);
-                    setDirtyBlockIndex.erase(it++);
-                }
+                std::vector<const CBlockIndex*> vBlocks(setDirtyBlockIndex.begin(), setDirtyBlockIndex.end());
                 if (!pblocktree->WriteBatchSync(vFiles, nLastBlockFile, vBlocks)) {
                     return AbortNode(state, "Failed to write to block index database");
                 }
+                // The headers are on disk now, no need to keep their Equihash solutions in memory.
+                for (CBlockIndex* pindex : setDirtyBlockIndex) {
+                    pindex->TrimSolution();
+                }
+                setDirtyBlockIndex.clear();
             }
-            // Finally remove any pruned files
-            if (fFlushForPrune)
+            // Finally remove any pruned files, once the chainstate being
+            // written in the background no longer needs them to recover.
+            if (fFlushForPrune) {
+                if (pcoinsflush && !pcoinsflush->WaitForFlush())
+                    return AbortNode(state, "Failed to write to coin database");
                 UnlinkPrunedFiles(setFilesToPrune);
+            }
             nLastWrite = nNow;
         }
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
@@ -2167,11 +2426,24 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
             // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            if (fCoinCacheEvict) {
+                // Keep the cache warm, and only make room in it when it is
+                // too large. Evict down to 80% of the limit, so that the next
+                // blocks do not have to write and evict again.
+                if (!pcoinsTip->Sync())
+                    return AbortNode(state, "Failed to write to coin database");
+                if (fCacheLarge || fCacheCritical) {
+                    pcoinsTip->Trim(nTotalSpace / 10 * 8);
+                    LogPrint(BCLog::COINDB, "Evicted coins down to %.1fMiB, %u in the cache\n", pcoinsTip->DynamicMemoryUsage() * (1.0 / 1048576.0), pcoinsTip->GetCacheSize());
+                }
+            } else if (!pcoinsTip->Flush()) {
                 return AbortNode(state, "Failed to write to coin database");
+            }
             nLastFlush = nNow;
             full_flush_completed = true;
         }
+        if (mode == FlushStateMode::ALWAYS && pcoinsflush && !pcoinsflush->WaitForFlush())
+            return AbortNode(state, "Failed to write to coin database");
     }
     if (full_flush_completed) {
         // Update best block in wallet (so we can detect restored wallets).
@@ -3073,7 +3345,7 @@ static bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos,
     return true;
 }
 
-static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, bool fCheckPOW = true)
+static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, bool fCheckPOW = true, bool fCheckEquihash = true)
 {
     const Consensus::Params& consensusParams = chainparams.GetConsensus();
 
@@ -3083,7 +3355,7 @@ static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state,
                          REJECT_INVALID, "version-too-low");
 
     // Check Equihash solution is valid
-    if (fCheckPOW && !CheckEquihashSolution(&block, chainparams))
+    if (fCheckPOW && fCheckEquihash && !CheckEquihashSolution(&block, chainparams))
         return state.DoS(100, error("CheckBlockHeader(): Equihash solution invalid"),
                          REJECT_INVALID, "invalid-solution");
 
@@ -3401,7 +3673,7 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckEquihash)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -3419,7 +3691,7 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams))
+        if (!CheckBlockHeader(block, state, chainparams, true, fCheckEquihash))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3462,15 +3734,72 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
     return true;
 }
 
+/** Number of headers whose Equihash solutions CheckEquihashSolutions checks per round */
+static const size_t HEADER_CHECKS_PER_ROUND = 128;
+
+/**
+ * Check the Equihash solutions of the headers we don't know yet on the header
+ * check queue, without holding cs_main. vValid[i] is set if headers[i] has a
+ * valid solution; headers left unset still need to be checked.
+ * The headers are checked in rounds, in order, and a round with an invalid
+ * solution is the last one: AcceptBlockHeader stops at that header anyway.
+ */
+static void CheckEquihashSolutions(const std::vector<CBlockHeader>& headers, const CChainParams& chainparams, std::vector<char>& vValid) LOCKS_EXCLUDED(cs_main)
+{
+    vValid.assign(headers.size(), false);
+    if (!nScriptCheckThreads || headers.size() < 2)
+        return;
+
+    std::vector<uint256> vHashes;
+    vHashes.reserve(headers.size());
+    for (const CBlockHeader& header : headers) {
+        vHashes.push_back(header.GetHash());
+    }
+
+    std::vector<size_t> vUnknown;
+    vUnknown.reserve(headers.size());
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < headers.size(); i++) {
+            if (!LookupBlockIndex(vHashes[i]))
+                vUnknown.push_back(i);
+        }
+    }
+
+    for (size_t nStart = 0; nStart < vUnknown.size(); nStart += HEADER_CHECKS_PER_ROUND) {
+        const size_t nEnd = std::min(vUnknown.size(), nStart + HEADER_CHECKS_PER_ROUND);
+        std::vector<CEquihashCheck> vChecks;
+        vChecks.reserve(nEnd - nStart);
+        for (size_t j = nStart; j < nEnd; j++) {
+            vChecks.emplace_back(headers[vUnknown[j]], chainparams, vValid[vUnknown[j]]);
+        }
+
+        CCheckQueueControl<CEquihashCheck> control(&headercheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+
+        for (size_t j = nStart; j < nEnd; j++) {
+            if (!vValid[vUnknown[j]])
+                return;
+        }
+    }
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+
+    // Only the contextual checks need cs_main. Headers whose solution failed
+    // here are checked again by AcceptBlockHeader, which rejects them.
+    std::vector<char> vEquihashValid;
+    CheckEquihashSolutions(headers, chainparams, vEquihashValid);
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex, !vEquihashValid[i])) {
                 if (first_invalid) *first_invalid = header;
                 return false;
             }
@@ -3586,6 +3915,7 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
 {
     AssertLockNotHeld(cs_main);
 
+    bool fNewBlockStored = false;
     {
         CBlockIndex *pindex = nullptr;
         if (fNewBlock) *fNewBlock = false;
@@ -3598,8 +3928,9 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
 
         if (ret) {
             // Store to disk
-            ret = g_chainstate.AcceptBlock(pblock, state, chainparams, &pindex, fForceProcessing, nullptr, fNewBlock);
+            ret = g_chainstate.AcceptBlock(pblock, state, chainparams, &pindex, fForceProcessing, nullptr, &fNewBlockStored);
         }
+        if (fNewBlock) *fNewBlock = fNewBlockStored;
         if (!ret) {
             GetMainSignals().BlockChecked(*pblock, state);
             return error("%s: AcceptBlock FAILED (%s)", __func__, FormatStateMessage(state));
@@ -3608,6 +3939,11 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
 
     NotifyHeaderTip();
 
+    // Warm the coins cache for ConnectBlock
+    if (fNewBlockStored) {
+        PrefetchBlockInputs(*pblock);
+    }
+
     CValidationState state; // Only used to report errors, not invalidity - ignore it
     if (!g_chainstate.ActivateBestChain(state, chainparams, pblock))
         return error("%s: ActivateBestChain failed (%s)", __func__, FormatStateMessage(state));
@@ -4,6 +4,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <stdexcept>
+#include <string.h>
 
 #include <boost/foreach.hpp>
 
@@ -13,18 +14,27 @@
 
 namespace libzcash {
 
+static_assert(sizeof(SHA256Compress) == 32, "SHA256Compress arrays must be contiguous hashes");
+
 SHA256Compress SHA256Compress::combine(const SHA256Compress& a, const SHA256Compress& b)
 {
     SHA256Compress res = SHA256Compress();
 
-    CSHA256 hasher;
-    hasher.Write(a.begin(), 32);
-    hasher.Write(b.begin(), 32);
-    hasher.FinalizeNoPadding(res.begin());
+    unsigned char block[64];
+    memcpy(block, a.begin(), 32);
+    memcpy(block + 32, b.begin(), 32);
+    SHA256Compress64(res.begin(), block, 1);
 
     return res;
 }
 
+void SHA256Compress::combine_pairs(const SHA256Compress* in, size_t count, SHA256Compress* out)
+{
+    if (count > 0) {
+        SHA256Compress64(out->begin(), in->begin(), count);
+    }
+}
+
 template <size_t Depth, typename Hash>
 class PathFiller {
 private:
@@ -142,6 +152,63 @@ void IncrementalMerkleTree<Depth, Hash>::append(Hash obj) {
     }
 }
 
+template<size_t Depth, typename Hash>
+void IncrementalMerkleTree<Depth, Hash>::append_batch(const std::vector<Hash>& objs) {
+    if (objs.empty()) {
+        return;
+    }
+    if (size() + objs.size() > (size_t(1) << Depth)) {
+        throw std::runtime_error("tree is full");
+    }
+
+    // The nodes of the current level that are not yet part of a parent:
+    // first the leaves still held in left and right, then the new ones.
+    std::vector<Hash> nodes;
+    nodes.reserve(2 + objs.size());
+    if (left) nodes.push_back(*left);
+    if (right) nodes.push_back(*right);
+    nodes.insert(nodes.end(), objs.begin(), objs.end());
+
+    // Like append(), keep the last one or two leaves uncombined
+    size_t held = (nodes.size() % 2 == 0) ? 2 : 1;
+    left = nodes[nodes.size() - held];
+    right = boost::none;
+    if (held == 2) {
+        right = nodes.back();
+    }
+    nodes.resize(nodes.size() - held);
+
+    std::vector<Hash> combined;
+    for (size_t i = 0; i + 1 < Depth; i++) {
+        // Pair up the nodes of this level, starting with the left sibling
+        // that the old tree was waiting on, if any.
+        combined.resize(nodes.size() / 2);
+        Hash::combine_pairs(nodes.data(), combined.size(), combined.data());
+        nodes.swap(combined);
+        if (i < parents.size() && parents[i]) {
+            nodes.insert(nodes.begin(), *parents[i]);
+        }
+        if (nodes.empty() && i >= parents.size()) {
+            break;
+        }
+
+        // An unpaired node becomes the parent at this level
+        if (i == parents.size()) {
+            parents.push_back(boost::none);
+        }
+        if (nodes.size() % 2 == 1) {
+            parents[i] = nodes.back();
+            nodes.pop_back();
+        } else {
+            parents[i] = boost::none;
+        }
+    }
+
+    while (!parents.empty() && !parents.back()) {
+        parents.pop_back();
+    }
+}
+
 // This is for allowing the witness to determine if a subtree has filled
 // to a particular depth, or for append() to ensure we're not appending
 // to a full tree.
@@ -65,10 +65,14 @@ bool operator==(const EmptyMerkleRoots<Depth, Hash>& a,
 template<size_t Depth, typename Hash>
 class IncrementalWitness;
 
+template<size_t Depth, typename Hash>
+class IncrementalWitnessCache;
+
 template<size_t Depth, typename Hash>
 class IncrementalMerkleTree {
 
 friend class IncrementalWitness<Depth, Hash>;
+friend class IncrementalWitnessCache<Depth, Hash>;
 
 public:
     BOOST_STATIC_ASSERT(Depth >= 1);
@@ -84,6 +88,9 @@ public:
     size_t size() const;
 
     void append(Hash obj);
+    // Appends objs in order, hashing each level of the tree once for the
+    // whole batch rather than once per object.
+    void append_batch(const std::vector<Hash>& objs);
     Hash root() const {
         return root(Depth, std::deque<Hash>());
     }
@@ -138,6 +145,7 @@ bool operator==(const IncrementalMerkleTree<Depth, Hash>& a,
 template <size_t Depth, typename Hash>
 class IncrementalWitness {
 friend class IncrementalMerkleTree<Depth, Hash>;
+friend class IncrementalWitnessCache<Depth, Hash>;
 
 public:
     // Required for Unserialize()
@@ -198,6 +206,8 @@ public:
     SHA256Compress(uint256 contents) : uint256(contents) { }
 
     static SHA256Compress combine(const SHA256Compress& a, const SHA256Compress& b);
+    // Sets out[i] to combine(in[2*i], in[2*i+1]) for i < count.
+    static void combine_pairs(const SHA256Compress* in, size_t count, SHA256Compress* out);
 };
 
 } // end namespace `libzcash`
@@ -0,0 +1,224 @@
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <algorithm>
+#include <assert.h>
+#include <stdexcept>
+
+#include "zcash/IncrementalWitnessCache.hpp"
+
+#ifdef MULTICORE
+#include <omp.h>
+#endif
+
+namespace libzcash {
+
+// Below this many notes, advancing them is not worth starting threads for.
+static const size_t WITNESS_CACHE_PARALLEL_NOTES = 1024;
+
+// Returns, for each level, the complete node of `tree` that is still waiting
+// for its right sibling, if any. The tree keeps its last two leaves apart,
+// so these are its parents once those are combined.
+template<size_t Depth, typename Hash>
+std::vector<boost::optional<Hash>> IncrementalWitnessCache<Depth, Hash>::pending_nodes(
+    const IncrementalMerkleTree<Depth, Hash>& tree)
+{
+    std::vector<boost::optional<Hash>> nodes(Depth + 1);
+    for (size_t i = 0; i < tree.parents.size(); i++) {
+        nodes[i + 1] = tree.parents[i];
+    }
+
+    if (tree.right) {
+        // Carry the combined leaves up, as append() would
+        Hash carry = Hash::combine(*tree.left, *tree.right);
+        size_t d = 1;
+        while (nodes[d]) {
+            carry = Hash::combine(*nodes[d], carry);
+            nodes[d] = boost::none;
+            d++;
+        }
+        nodes[d] = carry;
+    } else {
+        nodes[0] = tree.left;
+    }
+
+    return nodes;
+}
+
+template<size_t Depth, typename Hash>
+void IncrementalWitnessCache<Depth, Hash>::append_block(const std::vector<Hash>& commitments,
+                                                        const std::vector<size_t>& track,
+                                                        int nThreads)
+{
+    const uint64_t start = frontier.size();
+    if (start + commitments.size() > (uint64_t(1) << Depth)) {
+        throw std::runtime_error("tree is full");
+    }
+
+    Checkpoint checkpoint;
+    checkpoint.height = nHeight + 1;
+    checkpoint.frontier = frontier;
+
+    // The roots of the subtrees that the block completes, by level: level d
+    // holds the nodes from index first[d] on.
+    std::vector<std::vector<Hash>> levels(Depth);
+    std::vector<uint64_t> first(Depth);
+    if (!commitments.empty()) {
+        std::vector<boost::optional<Hash>> pending = pending_nodes(frontier);
+        std::vector<Hash> nodes(commitments);
+        uint64_t index = start;
+        for (size_t d = 0; d < Depth && !nodes.empty(); d++) {
+            levels[d] = nodes;
+            first[d] = index;
+            if (d + 1 == Depth) {
+                break;
+            }
+
+            // Pair the nodes up, starting with the left sibling the tree was
+            // waiting on, if any.
+            if (index % 2 == 1) {
+                assert(pending[d]);
+                nodes.insert(nodes.begin(), *pending[d]);
+                index--;
+            }
+            std::vector<Hash> parents(nodes.size() / 2);
+            Hash::combine_pairs(nodes.data(), parents.size(), parents.data());
+            nodes.swap(parents);
+            index /= 2;
+        }
+    }
+
+    // Start witnessing the new notes from the tree as of each of them
+    std::vector<size_t> added(track);
+    std::sort(added.begin(), added.end());
+    added.erase(std::unique(added.begin(), added.end()), added.end());
+    if (!added.empty() && added.back() >= commitments.size()) {
+        throw std::out_of_range("tracked commitment is not in the block");
+    }
+    size_t appended = 0;
+    for (size_t i : added) {
+        frontier.append_batch(std::vector<Hash>(commitments.begin() + appended, commitments.begin() + i + 1));
+        appended = i + 1;
+        Note& note = notes[start + i];
+        note.tree = frontier;
+        note.filled.clear();
+    }
+    frontier.append_batch(std::vector<Hash>(commitments.begin() + appended, commitments.end()));
+
+    // Hand every note the subtree roots it was waiting on
+    std::vector<std::pair<const uint64_t, Note>*> entries;
+    entries.reserve(notes.size());
+    for (auto& entry : notes) {
+        entries.push_back(&entry);
+    }
+    std::vector<uint64_t> filledBefore(entries.size());
+#ifdef MULTICORE
+    if (nThreads <= 0) {
+        nThreads = omp_get_max_threads();
+    }
+    #pragma omp parallel for schedule(static) num_threads(nThreads) if (entries.size() >= WITNESS_CACHE_PARALLEL_NOTES)
+#endif
+    for (long i = 0; i < (long)entries.size(); i++) {
+        const uint64_t position = entries[i]->first;
+        Note& note = entries[i]->second;
+        filledBefore[i] = note.filled.size();
+        for (;;) {
+            const size_t d = note.tree.next_depth(note.filled.size());
+            if (d >= Depth) {
+                break;
+            }
+            // The next subtree to the right of the note at this level
+            const uint64_t sibling = (position >> d) + 1;
+            if (sibling < first[d] || sibling - first[d] >= levels[d].size()) {
+                break;
+            }
+            note.filled.push_back(levels[d][sibling - first[d]]);
+        }
+    }
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i]->first < start && entries[i]->second.filled.size() != filledBefore[i]) {
+            checkpoint.filled.emplace_back(entries[i]->first, filledBefore[i]);
+        }
+    }
+
+    checkpoints.push_back(std::move(checkpoint));
+    if (checkpoints.size() > maxCheckpoints) {
+        checkpoints.erase(checkpoints.begin(), checkpoints.end() - maxCheckpoints);
+    }
+    nHeight++;
+}
+
+template<size_t Depth, typename Hash>
+bool IncrementalWitnessCache<Depth, Hash>::rewind(int height)
+{
+    if (height > nHeight || (size_t)(nHeight - height) > checkpoints.size()) {
+        return false;
+    }
+
+    while (nHeight > height) {
+        Checkpoint& checkpoint = checkpoints.back();
+        assert(checkpoint.height == nHeight);
+
+        notes.insert(checkpoint.forgotten.begin(), checkpoint.forgotten.end());
+        notes.erase(notes.lower_bound(checkpoint.frontier.size()), notes.end());
+        for (const auto& entry : checkpoint.filled) {
+            auto it = notes.find(entry.first);
+            if (it != notes.end()) {
+                it->second.filled.resize(entry.second);
+            }
+        }
+        frontier = checkpoint.frontier;
+
+        checkpoints.pop_back();
+        nHeight--;
+    }
+
+    return true;
+}
+
+template<size_t Depth, typename Hash>
+void IncrementalWitnessCache<Depth, Hash>::forget(uint64_t position)
+{
+    auto it = notes.find(position);
+    if (it == notes.end()) {
+        return;
+    }
+    if (!checkpoints.empty() && checkpoints.back().height == nHeight) {
+        checkpoints.back().forgotten.insert(*it);
+    }
+    notes.erase(it);
+}
+
+template<size_t Depth, typename Hash>
+boost::optional<IncrementalWitness<Depth, Hash>> IncrementalWitnessCache<Depth, Hash>::witness(uint64_t position) const
+{
+    auto it = notes.find(position);
+    if (it == notes.end()) {
+        return boost::none;
+    }
+    const Note& note = it->second;
+
+    IncrementalWitness<Depth, Hash> witness(note.tree);
+    witness.filled = note.filled;
+    witness.cursor_depth = note.tree.next_depth(note.filled.size());
+
+    // The subtree being filled holds the leaves after the last filled one.
+    // Its frontier is that of the whole tree, below the subtree's root.
+    const size_t d = witness.cursor_depth;
+    if (d > 0 && d < Depth && frontier.size() > (((position >> d) + 1) << d)) {
+        IncrementalMerkleTree<Depth, Hash> cursor = frontier;
+        cursor.parents.resize(std::min(cursor.parents.size(), d - 1));
+        while (!cursor.parents.empty() && !cursor.parents.back()) {
+            cursor.parents.pop_back();
+        }
+        witness.cursor = cursor;
+    }
+
+    return witness;
+}
+
+template class IncrementalWitnessCache<INCREMENTAL_MERKLE_TREE_DEPTH, SHA256Compress>;
+template class IncrementalWitnessCache<INCREMENTAL_MERKLE_TREE_DEPTH_TESTING, SHA256Compress>;
+
+} // end namespace `libzcash`
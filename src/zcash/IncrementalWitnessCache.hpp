@@ -0,0 +1,134 @@
+// Copyright (c) 2018 The Bitcoin Private developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ZCASH_INCREMENTALWITNESSCACHE_H
+#define BITCOIN_ZCASH_INCREMENTALWITNESSCACHE_H
+
+#include <map>
+#include <vector>
+#include <boost/optional.hpp>
+
+#include "serialize.h"
+
+#include "zcash/IncrementalMerkleTree.hpp"
+
+namespace libzcash {
+
+// The witnesses of many notes in one commitment tree, advanced a block at a
+// time.
+//
+// Appending every commitment to every IncrementalWitness costs
+// O(notes * commitments) per block. Instead the cache keeps one frontier of
+// the tree, works out once per block the subtree roots that the block
+// completes, and hands each note those it was waiting on. The partial
+// subtree a witness is filling is always a corner of the shared frontier,
+// so it is not kept per note.
+//
+// Notes are identified by their position in the tree. Each block leaves a
+// checkpoint, so that a reorg only undoes the blocks it disconnects.
+template<size_t Depth, typename Hash>
+class IncrementalWitnessCache {
+public:
+    IncrementalWitnessCache(size_t maxCheckpoints = 100)
+        : nHeight(0), maxCheckpoints(maxCheckpoints) { }
+
+    // Starts from the tree as of the block at `height`.
+    IncrementalWitnessCache(const IncrementalMerkleTree<Depth, Hash>& tree,
+                            int height,
+                            size_t maxCheckpoints = 100)
+        : frontier(tree), nHeight(height), maxCheckpoints(maxCheckpoints) { }
+
+    // Appends the commitments of the block at height() + 1, and starts
+    // witnessing those at the indices in `track`. The witnesses are
+    // advanced on up to nThreads threads (0 for the OpenMP default).
+    void append_block(const std::vector<Hash>& commitments,
+                      const std::vector<size_t>& track = std::vector<size_t>(),
+                      int nThreads = 0);
+
+    // Undoes the blocks above `height`. Returns false, leaving the cache
+    // unchanged, if the checkpoints do not go back that far.
+    bool rewind(int height);
+
+    // Stops witnessing the note at `position`, e.g. once it is spent.
+    // Rewinding past the current block witnesses it again.
+    void forget(uint64_t position);
+
+    // Returns the witness of the note at `position`, if it is tracked.
+    boost::optional<IncrementalWitness<Depth, Hash>> witness(uint64_t position) const;
+
+    const IncrementalMerkleTree<Depth, Hash>& tree() const {
+        return frontier;
+    }
+
+    int height() const {
+        return nHeight;
+    }
+
+    size_t size() const {
+        return notes.size();
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(frontier);
+        READWRITE(nHeight);
+        READWRITE(notes);
+        READWRITE(checkpoints);
+    }
+
+private:
+    struct Note {
+        // The tree up to and including the note
+        IncrementalMerkleTree<Depth, Hash> tree;
+        // The roots of the completed subtrees to its right
+        std::vector<Hash> filled;
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action) {
+            READWRITE(tree);
+            READWRITE(filled);
+        }
+    };
+
+    struct Checkpoint {
+        // The block this undoes
+        int height;
+        // The tree before the block
+        IncrementalMerkleTree<Depth, Hash> frontier;
+        // The notes the block advanced, with their previous number of
+        // filled subtrees
+        std::vector<std::pair<uint64_t, uint64_t>> filled;
+        // The notes forgotten since the block
+        std::map<uint64_t, Note> forgotten;
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action) {
+            READWRITE(height);
+            READWRITE(frontier);
+            READWRITE(filled);
+            READWRITE(forgotten);
+        }
+    };
+
+    IncrementalMerkleTree<Depth, Hash> frontier;
+    int nHeight;
+    std::map<uint64_t, Note> notes;
+    std::vector<Checkpoint> checkpoints;
+    size_t maxCheckpoints;
+
+    static std::vector<boost::optional<Hash>> pending_nodes(const IncrementalMerkleTree<Depth, Hash>& tree);
+};
+
+} // end namespace `libzcash`
+
+typedef libzcash::IncrementalWitnessCache<INCREMENTAL_MERKLE_TREE_DEPTH, libzcash::SHA256Compress> ZCIncrementalWitnessCache;
+typedef libzcash::IncrementalWitnessCache<INCREMENTAL_MERKLE_TREE_DEPTH_TESTING, libzcash::SHA256Compress> ZCTestingIncrementalWitnessCache;
+
+#endif // BITCOIN_ZCASH_INCREMENTALWITNESSCACHE_H
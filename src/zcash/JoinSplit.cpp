@@ -9,7 +9,20 @@
 
 #include "zcash/util.h"
 
+#include <algorithm>
 #include <memory>
+#include <streambuf>
+
+#ifndef WIN32
+#ifdef MULTICORE
+#include <omp.h>
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
@@ -68,19 +81,164 @@ void loadFromFile(const std::string path, T& objIn) {
     objIn = std::move(obj);
 }
 
+/**
+ * A parameter file mapped into memory once, so that every reader shares the
+ * same pages instead of reading the file again. Where the file can't be
+ * mapped it is read into memory instead.
+ */
+class MappedParamFile
+{
+private:
+    const char* pdata = nullptr;
+    size_t nSize = 0;
+    bool fMapped = false;
+    std::vector<char> vData;
+
+    /** Read-only stream buffer over the file's contents. */
+    class StreamBuf : public std::streambuf
+    {
+    public:
+        StreamBuf(const char* begin, size_t size)
+        {
+            char* p = const_cast<char*>(begin);
+            setg(p, p, p + size);
+        }
+    };
+
+public:
+    explicit MappedParamFile(const std::string& path)
+    {
+#ifndef WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            throw std::runtime_error(strprintf("could not load param file at %s", path));
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (addr != MAP_FAILED) {
+                pdata = static_cast<const char*>(addr);
+                nSize = st.st_size;
+                fMapped = true;
+            }
+        }
+        close(fd);
+        if (fMapped) {
+            return;
+        }
+#endif
+        std::ifstream fh(path, std::ios::binary);
+        if (!fh.is_open()) {
+            throw std::runtime_error(strprintf("could not load param file at %s", path));
+        }
+        vData.assign(std::istreambuf_iterator<char>(fh), std::istreambuf_iterator<char>());
+        pdata = vData.data();
+        nSize = vData.size();
+    }
+
+    ~MappedParamFile()
+    {
+#ifndef WIN32
+        if (fMapped) {
+            munmap(const_cast<char*>(pdata), nSize);
+        }
+#endif
+    }
+
+    MappedParamFile(const MappedParamFile&) = delete;
+    MappedParamFile& operator=(const MappedParamFile&) = delete;
+
+    /** Deserialize obj from the file. Returns false if it is malformed. */
+    template<typename T>
+    bool Read(T& obj) const
+    {
+        StreamBuf buf(pdata, nSize);
+        std::istream in(&buf);
+        in >> obj;
+        return !in.fail();
+    }
+
+    /** Call f with a stream over the file; concurrent calls each get their own. */
+    template<typename F>
+    auto WithStream(F f) const -> decltype(f(std::declval<std::istream&>()))
+    {
+        StreamBuf buf(pdata, nSize);
+        std::istream in(&buf);
+        return f(in);
+    }
+};
+
+/**
+ * Limits the threads of the OpenMP parallel regions started by this thread,
+ * while in scope. libsnark sizes its work by omp_get_max_threads(), which
+ * is a setting of the calling thread, so proofs running on other threads
+ * keep theirs.
+ */
+class ScopedProofThreads {
+public:
+    explicit ScopedProofThreads(int nThreads) {
+#ifdef MULTICORE
+        nPrevThreads = omp_get_max_threads();
+        if (nThreads > 0) {
+            omp_set_num_threads(nThreads);
+        }
+#endif
+    }
+
+    ~ScopedProofThreads() {
+#ifdef MULTICORE
+        omp_set_num_threads(nPrevThreads);
+#endif
+    }
+
+private:
+    int nPrevThreads;
+};
+
+/**
+ * The largest number of JoinSplit proofs computed together. The proofs of a
+ * batch share the constraint system, the evaluation domain and, without a
+ * preloaded key, the read of the proving key. But each of them keeps its
+ * witness and QAP polynomials in memory until the batch is done: around 2^21
+ * field elements each, a few hundred MB per proof for the JoinSplit circuit.
+ * Four keeps a batch near 1 GB, and cancellation is checked between batches.
+ */
+static const size_t MAX_PROOFS_PER_BATCH = 4;
+
+/**
+ * The window size, in bits, of the fixed-base tables used to accumulate the
+ * verification key's IC query.
+ */
+static const size_t IC_TABLE_WINDOW_SIZE = 8;
+
 template<size_t NumInputs, size_t NumOutputs>
 class JoinSplitCircuit : public JoinSplit<NumInputs, NumOutputs> {
 public:
     typedef default_r1cs_ppzksnark_pp ppzksnark_ppT;
     typedef Fr<ppzksnark_ppT> FieldT;
+    typedef JSProofWitness<NumInputs, NumOutputs> ProofWitness;
 
     r1cs_ppzksnark_verification_key<ppzksnark_ppT> vk;
     r1cs_ppzksnark_processed_verification_key<ppzksnark_ppT> vk_precomp;
     std::string pkPath;
 
+    //! The proving key file, mapped on first use and shared by all provers
+    std::shared_ptr<const MappedParamFile> pkFile;
+    //! The proving key, once loadProvingKey has been called
+    std::shared_ptr<const r1cs_ppzksnark_proving_key<ppzksnark_ppT>> pk;
+
     JoinSplitCircuit(const std::string vkPath, const std::string pkPath) : pkPath(pkPath) {
         loadFromFile(vkPath, vk);
         vk_precomp = r1cs_ppzksnark_verifier_process_vk(vk);
+
+        // The primary input packs the public bits into as few field
+        // elements as possible, the last one holding what is left over.
+        const size_t inputBits = joinsplit_gadget<FieldT, NumInputs, NumOutputs>::verifying_input_bit_size();
+        std::vector<size_t> elementBits;
+        for (size_t i = 0; i < inputBits; i += FieldT::capacity()) {
+            elementBits.push_back(std::min(FieldT::capacity(), inputBits - i));
+        }
+        r1cs_ppzksnark_verifier_process_IC_tables(vk_precomp, elementBits, IC_TABLE_WINDOW_SIZE);
     }
     ~JoinSplitCircuit() {}
 
@@ -103,6 +261,30 @@ public:
         saveToFile(pkPath, keypair.pk);
     }
 
+    std::shared_ptr<const MappedParamFile> getProvingKeyFile() {
+        LOCK(cs_LoadKeys);
+        if (!pkFile) {
+            pkFile = std::make_shared<const MappedParamFile>(pkPath);
+        }
+        return pkFile;
+    }
+
+    void loadProvingKey() {
+        std::shared_ptr<const MappedParamFile> file = getProvingKeyFile();
+
+        LOCK(cs_LoadKeys);
+        if (pk) {
+            return;
+        }
+        std::shared_ptr<r1cs_ppzksnark_proving_key<ppzksnark_ppT>> key = std::make_shared<r1cs_ppzksnark_proving_key<ppzksnark_ppT>>();
+        if (!file->Read(*key)) {
+            throw std::runtime_error(strprintf("invalid proving key at %s", pkPath));
+        }
+        pk = std::move(key);
+        // Provers no longer need the file
+        pkFile.reset();
+    }
+
     bool verify(
         const ZCProof& proof,
         ProofVerifier& verifier,
@@ -156,7 +338,8 @@ public:
         uint64_t vpub_new,
         const uint256& rt,
         bool computeProof,
-        uint256 *out_esk // Payment disclosure
+        uint256 *out_esk, // Payment disclosure
+        ProofWitness *out_witness
     ) {
         if (vpub_old > MAX_MONEY) {
             throw std::invalid_argument("nonsensical vpub_old value");
@@ -272,51 +455,113 @@ public:
             out_macs[i] = PRF_pk(inputs[i].key, i, h_sig);
         }
 
+        ProofWitness witness;
+        witness.phi = phi;
+        witness.rt = rt;
+        witness.h_sig = h_sig;
+        witness.inputs = inputs;
+        witness.notes = out_notes;
+        witness.vpub_old = vpub_old;
+        witness.vpub_new = vpub_new;
+
         if (!computeProof) {
+            if (out_witness != nullptr) {
+                *out_witness = std::move(witness);
+            }
             return ZCProof();
         }
 
-        protoboard<FieldT> pb;
-        {
-            joinsplit_gadget<FieldT, NumInputs, NumOutputs> g(pb);
-            g.generate_r1cs_constraints();
-            g.generate_r1cs_witness(
-                phi,
-                rt,
-                h_sig,
-                inputs,
-                out_notes,
-                vpub_old,
-                vpub_new
-            );
-        }
+        return proveBatch(std::vector<ProofWitness>(1, std::move(witness)), 0, nullptr)[0];
+    }
 
-        // The constraint system must be satisfied or there is an unimplemented
-        // or incorrect sanity check above. Or the constraint system is broken!
-        assert(pb.is_satisfied());
+    std::vector<ZCProof> proveBatch(const std::vector<ProofWitness>& witnesses,
+                                    int nThreads,
+                                    const std::function<bool()>& interrupted) {
+        ScopedProofThreads threads(nThreads);
 
-        // TODO: These are copies, which is not strictly necessary.
-        std::vector<FieldT> primary_input = pb.primary_input();
-        std::vector<FieldT> aux_input = pb.auxiliary_input();
+        std::vector<ZCProof> proofs;
+        proofs.reserve(witnesses.size());
 
-        // Swap A and B if it's beneficial (less arithmetic in G2)
-        // In our circuit, we already know that it's beneficial
-        // to swap, but it takes so little time to perform this
-        // estimate that it doesn't matter if we check every time.
-        pb.constraint_system.swap_AB_if_beneficial();
+        for (size_t start = 0; start < witnesses.size(); start += MAX_PROOFS_PER_BATCH) {
+            if (interrupted && interrupted()) {
+                break;
+            }
 
-        std::ifstream fh(pkPath, std::ios::binary);
+            const size_t end = std::min(witnesses.size(), start + MAX_PROOFS_PER_BATCH);
+
+            r1cs_constraint_system<FieldT> constraint_system;
+            std::vector<std::vector<FieldT>> primary_inputs;
+            std::vector<std::vector<FieldT>> aux_inputs;
+
+            for (size_t i = start; i < end; i++) {
+                const ProofWitness& witness = witnesses[i];
+
+                protoboard<FieldT> pb;
+                {
+                    joinsplit_gadget<FieldT, NumInputs, NumOutputs> g(pb);
+                    g.generate_r1cs_constraints();
+                    g.generate_r1cs_witness(
+                        witness.phi,
+                        witness.rt,
+                        witness.h_sig,
+                        witness.inputs,
+                        witness.notes,
+                        witness.vpub_old,
+                        witness.vpub_new
+                    );
+                }
 
-        if(!fh.is_open()) {
-            throw std::runtime_error(strprintf("could not load param file at %s", pkPath));
+                // The constraint system must be satisfied or there is an unimplemented
+                // or incorrect sanity check above. Or the constraint system is broken!
+                assert(pb.is_satisfied());
+
+                primary_inputs.push_back(pb.primary_input());
+                aux_inputs.push_back(pb.auxiliary_input());
+
+                // Every witness is for the same constraint system, so keep
+                // the first one.
+                if (i == start) {
+                    // Swap A and B if it's beneficial (less arithmetic in G2)
+                    // In our circuit, we already know that it's beneficial
+                    // to swap, but it takes so little time to perform this
+                    // estimate that it doesn't matter if we check every time.
+                    pb.constraint_system.swap_AB_if_beneficial();
+                    constraint_system = std::move(pb.constraint_system);
+                }
+            }
+
+            std::shared_ptr<const r1cs_ppzksnark_proving_key<ppzksnark_ppT>> key;
+            {
+                LOCK(cs_LoadKeys);
+                key = pk;
+            }
+
+            // Without a preloaded key, stream it from the shared mapping once
+            // for the whole batch
+            std::vector<r1cs_ppzksnark_proof<ppzksnark_ppT>> batch;
+            if (key) {
+                batch = r1cs_ppzksnark_batch_prover<ppzksnark_ppT>(
+                    *key,
+                    primary_inputs,
+                    aux_inputs,
+                    constraint_system
+                );
+            } else {
+                batch = getProvingKeyFile()->WithStream([&](std::istream& in) {
+                    return r1cs_ppzksnark_batch_prover_streaming<ppzksnark_ppT>(
+                        in,
+                        primary_inputs,
+                        aux_inputs,
+                        constraint_system
+                    );
+                });
+            }
+            for (const r1cs_ppzksnark_proof<ppzksnark_ppT>& proof : batch) {
+                proofs.emplace_back(proof);
+            }
         }
 
-        return ZCProof(r1cs_ppzksnark_prover_streaming<ppzksnark_ppT>(
-            fh,
-            primary_input,
-            aux_input,
-            pb.constraint_system
-        ));
+        return proofs;
     }
 };
 
@@ -17,6 +17,8 @@
 #include "uint252.h"
 
 #include <array>
+#include <functional>
+#include <vector>
 
 namespace libzcash {
 
@@ -48,9 +50,30 @@ public:
     Note note(const uint252& phi, const uint256& r, size_t i, const uint256& h_sig) const;
 };
 
+/**
+ * The private inputs of a JoinSplit statement, kept when the JoinSplit is
+ * created without a proof so that the proof can be computed later, together
+ * with the proofs of other JoinSplits.
+ */
+template<size_t NumInputs, size_t NumOutputs>
+class JSProofWitness {
+public:
+    uint252 phi;
+    uint256 rt;
+    uint256 h_sig;
+    std::array<JSInput, NumInputs> inputs;
+    std::array<Note, NumOutputs> notes;
+    uint64_t vpub_old;
+    uint64_t vpub_new;
+
+    JSProofWitness() : vpub_old(0), vpub_new(0) { }
+};
+
 template<size_t NumInputs, size_t NumOutputs>
 class JoinSplit {
 public:
+    typedef JSProofWitness<NumInputs, NumOutputs> ProofWitness;
+
     virtual ~JoinSplit() {}
 
     static void Generate(const std::string r1csPath,
@@ -59,6 +82,12 @@ public:
     static JoinSplit<NumInputs, NumOutputs>* Prepared(const std::string vkPath,
                                                       const std::string pkPath);
 
+    /**
+     * Load and check the proving key once, so that later proofs share it in
+     * memory instead of each reading it from the key file.
+     */
+    virtual void loadProvingKey() = 0;
+
     static uint256 h_sig(const uint256& randomSeed,
                          const std::array<uint256, NumInputs>& nullifiers,
                          const uint256& pubKeyHash
@@ -82,9 +111,26 @@ public:
         // For paymentdisclosure, we need to retrieve the esk.
         // Reference as non-const parameter with default value leads to compile error.
         // So use pointer for simplicity.
-        uint256 *out_esk = nullptr
+        uint256 *out_esk = nullptr,
+        // If computeProof is false, the inputs needed to compute the proof
+        // later with proveBatch.
+        ProofWitness *out_witness = nullptr
     ) = 0;
 
+    /**
+     * Compute the proofs of JoinSplits created without one. They are
+     * proven a few at a time, sharing the constraint system, the
+     * evaluation domain and, unless the proving key is preloaded, the read
+     * of the key.
+     *
+     * The proofs run on up to nThreads threads (0 for the OpenMP default).
+     * If `interrupted` returns true between two such batches, this stops
+     * and returns only the proofs computed so far.
+     */
+    virtual std::vector<ZCProof> proveBatch(const std::vector<ProofWitness>& witnesses,
+                                            int nThreads = 0,
+                                            const std::function<bool()>& interrupted = nullptr) = 0;
+
     virtual bool verify(
         const ZCProof& proof,
         ProofVerifier& verifier,
@@ -3,13 +3,22 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "NoteEncryption.hpp"
+#include <algorithm>
 #include <stdexcept>
 #include "sodium.h"
 #include <boost/static_assert.hpp>
 #include "prf.h"
+#include "crypto/blake2b.h"
+
+#ifdef MULTICORE
+#include <omp.h>
+#endif
 
 #define NOTEENCRYPTION_CIPHER_KEYSIZE 32
 
+// The number of KDF hashes computed together by NoteDecryptionBatch
+#define NOTEDECRYPTION_KDF_CHUNK 64
+
 void clamp_curve25519(unsigned char key[crypto_scalarmult_SCALARBYTES])
 {
     key[0] &= 248;
@@ -139,6 +148,132 @@ typename NoteDecryption<MLEN>::Plaintext NoteDecryption<MLEN>::decrypt
     return plaintext;
 }
 
+template<size_t MLEN>
+void NoteDecryptionBatch<MLEN>::add(const NoteDecryptionBatch<MLEN>::Ciphertext &ciphertext,
+                                    const uint256 &epk,
+                                    const uint256 &hSig,
+                                    unsigned char nonce
+                                   )
+{
+    if (nonce == 0xff) {
+        throw std::logic_error("no additional nonce space for KDF");
+    }
+
+    auto it = epkIndex.find(epk);
+    if (it == epkIndex.end()) {
+        it = epkIndex.emplace(epk, epks.size()).first;
+        epks.push_back(epk);
+    }
+    entries.push_back(Entry{ciphertext, it->second, hSig, nonce});
+}
+
+template<size_t MLEN>
+std::vector<typename NoteDecryptionBatch<MLEN>::Match> NoteDecryptionBatch<MLEN>::decrypt
+                                         (const std::vector<NoteDecryption<MLEN>> &decryptors,
+                                          int nThreads
+                                         ) const
+{
+    const size_t nKeys = decryptors.size();
+    if (entries.empty() || nKeys == 0) {
+        return {};
+    }
+#ifdef MULTICORE
+    if (nThreads <= 0) {
+        nThreads = omp_get_max_threads();
+    }
+#endif
+
+    // One DH secret per distinct ephemeral key and decryptor
+    std::vector<uint256> dhsecrets(epks.size() * nKeys);
+    std::vector<unsigned char> dhvalid(dhsecrets.size());
+#ifdef MULTICORE
+    #pragma omp parallel for schedule(dynamic, 16) num_threads(nThreads)
+#endif
+    for (long p = 0; p < (long)dhsecrets.size(); ++p) {
+        const uint256 &epk = epks[p / nKeys];
+        const uint256 &sk_enc = decryptors[p % nKeys].sk_enc;
+        dhvalid[p] = crypto_scalarmult(dhsecrets[p].begin(), sk_enc.begin(), epk.begin()) == 0;
+    }
+
+    // Every (ciphertext, decryptor) pair, grouped by nonce since the KDF
+    // personalization depends on it, then cut into chunks of one nonce.
+    std::vector<size_t> order(entries.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return entries[a].nonce < entries[b].nonce;
+    });
+    const size_t nPairs = order.size() * nKeys;
+    std::vector<size_t> chunks;
+    for (size_t p = 0; p < nPairs; ) {
+        chunks.push_back(p);
+        const unsigned char nonce = entries[order[p / nKeys]].nonce;
+        const size_t end = std::min(p + NOTEDECRYPTION_KDF_CHUNK, nPairs);
+        while (++p < end && entries[order[p / nKeys]].nonce == nonce) { }
+    }
+    chunks.push_back(nPairs);
+
+    std::vector<std::vector<Match>> chunkMatches(chunks.size() - 1);
+#ifdef MULTICORE
+    #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+#endif
+    for (long c = 0; c < (long)chunkMatches.size(); ++c) {
+        const size_t begin = chunks[c];
+        const size_t count = chunks[c + 1] - begin;
+
+        unsigned char personalization[crypto_generichash_blake2b_PERSONALBYTES] = {};
+        memcpy(personalization, "ZcashKDF", 8);
+        personalization[8] = entries[order[begin / nKeys]].nonce;
+        uint64_t h[8];
+        Blake2bInitPersonal(h, NOTEENCRYPTION_CIPHER_KEYSIZE, personalization);
+
+        // The same block as KDF hashes
+        unsigned char blocks[NOTEDECRYPTION_KDF_CHUNK * 128];
+        for (size_t j = 0; j < count; ++j) {
+            const Entry &entry = entries[order[(begin + j) / nKeys]];
+            const size_t k = (begin + j) % nKeys;
+            unsigned char *block = blocks + 128 * j;
+            memcpy(block+0, entry.hSig.begin(), 32);
+            memcpy(block+32, dhsecrets[entry.epk * nKeys + k].begin(), 32);
+            memcpy(block+64, epks[entry.epk].begin(), 32);
+            memcpy(block+96, decryptors[k].pk_enc.begin(), 32);
+        }
+        unsigned char K[NOTEDECRYPTION_KDF_CHUNK * NOTEENCRYPTION_CIPHER_KEYSIZE];
+        Blake2bFinalizeBlocks(h, 128, blocks, count, K, NOTEENCRYPTION_CIPHER_KEYSIZE);
+
+        // The nonce is zero because we never reuse keys
+        unsigned char cipher_nonce[crypto_aead_chacha20poly1305_IETF_NPUBBYTES] = {};
+
+        for (size_t j = 0; j < count; ++j) {
+            const size_t i = order[(begin + j) / nKeys];
+            const size_t k = (begin + j) % nKeys;
+            if (!dhvalid[entries[i].epk * nKeys + k]) {
+                continue;
+            }
+
+            Plaintext plaintext;
+            if (crypto_aead_chacha20poly1305_ietf_decrypt(plaintext.begin(), NULL,
+                                                     NULL,
+                                                     entries[i].ciphertext.begin(), CLEN,
+                                                     NULL,
+                                                     0,
+                                                     cipher_nonce, K + NOTEENCRYPTION_CIPHER_KEYSIZE * j) == 0) {
+                chunkMatches[c].push_back(Match{i, k, plaintext});
+            }
+        }
+    }
+
+    std::vector<Match> matches;
+    for (const auto &m : chunkMatches) {
+        matches.insert(matches.end(), m.begin(), m.end());
+    }
+    std::sort(matches.begin(), matches.end(), [](const Match &a, const Match &b) {
+        return a.ciphertext < b.ciphertext || (a.ciphertext == b.ciphertext && a.decryptor < b.decryptor);
+    });
+    return matches;
+}
+
 //
 // Payment disclosure - decrypt with esk
 //
@@ -225,6 +360,7 @@ uint252 random_uint252()
 
 template class NoteEncryption<ZC_NOTEPLAINTEXT_SIZE>;
 template class NoteDecryption<ZC_NOTEPLAINTEXT_SIZE>;
+template class NoteDecryptionBatch<ZC_NOTEPLAINTEXT_SIZE>;
 
 template class PaymentDisclosureNoteDecryption<ZC_NOTEPLAINTEXT_SIZE>;
 
@@ -7,6 +7,8 @@
 #define BITCOIN_ZCASH_NOTEENCRYPTION_H
 
 #include <array>
+#include <map>
+#include <vector>
 #include "uint256.h"
 #include "uint252.h"
 
@@ -55,8 +57,13 @@ public:
     static uint256 generate_pubkey(const uint256 &sk_enc);
 };
 
+template<size_t MLEN>
+class NoteDecryptionBatch;
+
 template<size_t MLEN>
 class NoteDecryption {
+    friend class NoteDecryptionBatch<MLEN>;
+
 protected:
     enum { CLEN=MLEN+NOTEENCRYPTION_AUTH_BYTES };
     uint256 sk_enc;
@@ -84,6 +91,56 @@ public:
     }
 };
 
+// Trial decryption of many ciphertexts with many decryption keys, as when
+// scanning the JoinSplits of a block for notes sent to any of a wallet's
+// addresses. Ciphertexts that share an ephemeral key (the outputs of one
+// JoinSplit) share their DH secrets, the KDF hashes many keys at once on the
+// multi-lane BLAKE2b implementation, and the work is spread over threads.
+template<size_t MLEN>
+class NoteDecryptionBatch {
+public:
+    enum { CLEN=MLEN+NOTEENCRYPTION_AUTH_BYTES };
+    typedef std::array<unsigned char, CLEN> Ciphertext;
+    typedef std::array<unsigned char, MLEN> Plaintext;
+
+    struct Match {
+        size_t ciphertext; // index in the order ciphertexts were added
+        size_t decryptor;  // index in the decryptors passed to decrypt()
+        Plaintext plaintext;
+    };
+
+    // Queues a ciphertext, with the arguments NoteDecryption::decrypt takes.
+    void add(const Ciphertext &ciphertext,
+             const uint256 &epk,
+             const uint256 &hSig,
+             unsigned char nonce
+            );
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    // Tries every queued ciphertext with every decryptor, using up to
+    // nThreads threads (0 for the OpenMP default). Returns the pairs that
+    // decrypt, ordered by ciphertext and then by decryptor. Unlike decrypt,
+    // an ephemeral key that yields no DH secret just fails to match.
+    std::vector<Match> decrypt(const std::vector<NoteDecryption<MLEN>> &decryptors,
+                               int nThreads = 0
+                              ) const;
+
+private:
+    struct Entry {
+        Ciphertext ciphertext;
+        size_t epk; // index into epks
+        uint256 hSig;
+        unsigned char nonce;
+    };
+
+    std::vector<uint256> epks;
+    std::map<uint256, size_t> epkIndex;
+    std::vector<Entry> entries;
+};
+
 uint256 random_uint256();
 uint252 random_uint252();
 
@@ -119,6 +176,7 @@ public:
 
 typedef libzcash::NoteEncryption<ZC_NOTEPLAINTEXT_SIZE> ZCNoteEncryption;
 typedef libzcash::NoteDecryption<ZC_NOTEPLAINTEXT_SIZE> ZCNoteDecryption;
+typedef libzcash::NoteDecryptionBatch<ZC_NOTEPLAINTEXT_SIZE> ZCNoteDecryptionBatch;
 
 typedef libzcash::PaymentDisclosureNoteDecryption<ZC_NOTEPLAINTEXT_SIZE> ZCPaymentDisclosureNoteDecryption;
 
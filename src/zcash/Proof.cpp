@@ -227,6 +227,22 @@ void initialize_curve_params()
     std::call_once (init_public_params_once_flag, curve_pp::init_public_params);
 }
 
+class ProofBatch {
+public:
+    const r1cs_ppzksnark_verification_key<curve_pp>* vk = nullptr;
+    const r1cs_ppzksnark_processed_verification_key<curve_pp>* pvk = nullptr;
+    std::vector<r1cs_primary_input<curve_Fr>> primary_inputs;
+    std::vector<r1cs_ppzksnark_proof<curve_pp>> proofs;
+};
+
+ProofVerifier::ProofVerifier(bool perform_verification, bool batched) :
+    perform_verification(perform_verification),
+    batch(batched ? new ProofBatch() : nullptr) { }
+
+ProofVerifier::ProofVerifier(ProofVerifier&&) = default;
+ProofVerifier& ProofVerifier::operator=(ProofVerifier&&) = default;
+ProofVerifier::~ProofVerifier() = default;
+
 ProofVerifier ProofVerifier::Strict() {
     initialize_curve_params();
     return ProofVerifier(true);
@@ -237,6 +253,24 @@ ProofVerifier ProofVerifier::Disabled() {
     return ProofVerifier(false);
 }
 
+ProofVerifier ProofVerifier::Batch() {
+    initialize_curve_params();
+    return ProofVerifier(true, true);
+}
+
+bool ProofVerifier::verify_batch()
+{
+    if (!perform_verification || !batch || batch->proofs.empty()) {
+        return true;
+    }
+
+    bool result = r1cs_ppzksnark_online_batch_verifier_strong_IC<curve_pp>(*batch->vk, *batch->pvk, batch->primary_inputs, batch->proofs);
+
+    batch->primary_inputs.clear();
+    batch->proofs.clear();
+    return result;
+}
+
 template<>
 bool ProofVerifier::check(
     const r1cs_ppzksnark_verification_key<curve_pp>& vk,
@@ -245,7 +279,15 @@ bool ProofVerifier::check(
     const r1cs_ppzksnark_proof<curve_pp>& proof
 )
 {
-    if (perform_verification) {
+    if (perform_verification && batch) {
+        // All the proofs of a batch must be checked against the same key.
+        assert(batch->pvk == nullptr || batch->pvk == &pvk);
+        batch->vk = &vk;
+        batch->pvk = &pvk;
+        batch->primary_inputs.push_back(primary_input);
+        batch->proofs.push_back(proof);
+        return true;
+    } else if (perform_verification) {
         return r1cs_ppzksnark_online_verifier_strong_IC<curve_pp>(pvk, primary_input, proof);
     } else {
         return true;
@@ -9,6 +9,8 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <memory>
+
 namespace libzcash {
 
 const unsigned char G1_PREFIX_MASK = 0x02;
@@ -242,11 +244,16 @@ public:
 
 void initialize_curve_params();
 
+class ProofBatch;
+
 class ProofVerifier {
 private:
     bool perform_verification;
 
-    ProofVerifier(bool perform_verification) : perform_verification(perform_verification) { }
+    // Proofs queued by check() when batching, nullptr otherwise.
+    std::unique_ptr<ProofBatch> batch;
+
+    ProofVerifier(bool perform_verification, bool batched = false);
 
 public:
     // ProofVerifier should never be copied
@@ -254,6 +261,7 @@ public:
     ProofVerifier& operator=(const ProofVerifier&) = delete;
     ProofVerifier(ProofVerifier&&);
     ProofVerifier& operator=(ProofVerifier&&);
+    ~ProofVerifier();
 
     // Creates a verification context that strictly verifies
     // all proofs using libsnark's API.
@@ -264,6 +272,16 @@ public:
     // such as during reindexing.
     static ProofVerifier Disabled();
 
+    // Creates a verification context in which check() only
+    // queues the proofs; they are all verified at once, sharing
+    // a single final exponentiation, by verify_batch().
+    static ProofVerifier Batch();
+
+    // Verifies every proof queued since the last call, and
+    // returns true if they are all valid. Always true outside
+    // of batch mode.
+    bool verify_batch();
+
     template <typename VerificationKey,
               typename ProcessedVerificationKey,
               typename PrimaryInput,
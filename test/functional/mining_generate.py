@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Bitcoin Private developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the generate RPCs with several Equihash solver threads.
+
+- node0 solves with -genproclimit=4 and node1 with one thread per core
+- every block they generate is accepted by the other node"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, connect_nodes_bi, sync_blocks
+
+
+class GenerateTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-genproclimit=4"], ["-genproclimit=0"]]
+
+    def setup_network(self):
+        self.setup_nodes()
+        connect_nodes_bi(self.nodes, 0, 1)
+
+    def run_test(self):
+        for i, node in enumerate(self.nodes):
+            self.log.info("generatetoaddress on node%d" % i)
+            height = node.getblockcount()
+            hashes = node.generatetoaddress(10, node.get_deterministic_priv_key().address)
+            assert_equal(len(hashes), 10)
+            assert_equal(len(set(hashes)), 10)
+            assert_equal(node.getblockcount(), height + 10)
+            assert_equal(node.getbestblockhash(), hashes[-1])
+
+            sync_blocks(self.nodes)
+            for other in self.nodes:
+                assert_equal(other.getbestblockhash(), hashes[-1])
+                for block_hash in hashes:
+                    assert other.getblockheader(block_hash)['confirmations'] > 0
+
+        if self.is_wallet_compiled():
+            self.log.info("generate on node0")
+            hashes = self.nodes[0].generate(5)
+            assert_equal(len(hashes), 5)
+            sync_blocks(self.nodes)
+            assert_equal(self.nodes[1].getbestblockhash(), hashes[-1])
+
+
+if __name__ == '__main__':
+    GenerateTest().main()